@@ -0,0 +1,113 @@
+/*
+ * arena.c - Bump allocator for AST nodes, released all at once.
+ *
+ * Author: Philip R. Simonson
+ * Date: 10/17/2026
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "js2bas.h"
+#include "arena.h"
+
+// Allocate through the caller's hooks, or malloc() without any
+void *allocator_alloc(const Js2basAllocator *allocator, size_t size) {
+    if (allocator != NULL && allocator->alloc != NULL) {
+        return allocator->alloc(allocator->user, size);
+    }
+    return malloc(size);
+}
+
+// Resize through the caller's hooks, or realloc() without any
+void *allocator_resize(const Js2basAllocator *allocator, void *ptr, size_t size) {
+    if (allocator != NULL && allocator->resize != NULL) {
+        return allocator->resize(allocator->user, ptr, size);
+    }
+    return realloc(ptr, size);
+}
+
+// Free through the caller's hooks, or free() without any
+void allocator_free(const Js2basAllocator *allocator, void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+    if (allocator != NULL && allocator->release != NULL) {
+        allocator->release(allocator->user, ptr);
+    } else {
+        free(ptr);
+    }
+}
+
+// Initialize an empty arena (allocating with malloc() until told otherwise)
+void arena_init(Arena *arena) {
+    arena->first = NULL;
+    arena->current = NULL;
+    arena->allocator = NULL;
+}
+
+// Allocate a new block able to hold at least size bytes
+static ArenaBlock *new_block(Arena *arena, size_t size) {
+    ArenaBlock *block;
+
+    if (size < ARENA_BLOCK_SIZE) {
+        size = ARENA_BLOCK_SIZE;
+    }
+    if ((block = allocator_alloc(arena->allocator, sizeof(ArenaBlock) + size)) == NULL) {
+        return NULL;
+    }
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+// Allocate size bytes, aligned for any type
+void *arena_alloc(Arena *arena, size_t size) {
+    ArenaBlock *block = arena->current;
+
+    size = (size + sizeof(max_align_t) - 1) & ~(sizeof(max_align_t) - 1);
+    if (block == NULL || block->size - block->used < size) {
+        // Reuse the blocks of a previous round before allocating new ones
+        ArenaBlock *next = block ? block->next : arena->first;
+        while (next != NULL && next->size < size) {
+            next = next->next;
+        }
+        if (next == NULL) {
+            if ((next = new_block(arena, size)) == NULL) {
+                return NULL;
+            }
+            if (block == NULL) {
+                next->next = arena->first;
+                arena->first = next;
+            } else {
+                next->next = block->next;
+                block->next = next;
+            }
+        }
+        next->used = 0;
+        arena->current = block = next;
+    }
+
+    void *ptr = (char*)block->data + block->used;
+    block->used += size;
+    return ptr;
+}
+
+// Release everything allocated so far (blocks are kept for reuse)
+void arena_reset(Arena *arena) {
+    arena->current = NULL;
+}
+
+// Free all blocks of the arena
+void arena_free(Arena *arena) {
+    ArenaBlock *block = arena->first;
+    while (block != NULL) {
+        ArenaBlock *next = block->next;
+        allocator_free(arena->allocator, block);
+        block = next;
+    }
+    arena->first = NULL;
+    arena->current = NULL;
+}
+
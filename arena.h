@@ -0,0 +1,36 @@
+/*
+ * arena.h - Bump allocator for AST nodes, released all at once.
+ *
+ * Author: Philip R. Simonson
+ * Date: 10/17/2026
+ *
+ */
+
+#include <stddef.h>
+
+// Size of a regular arena block
+#define ARENA_BLOCK_SIZE 65536
+
+// Arena Block Structure
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t size;
+    size_t used;
+    max_align_t data[];
+} ArenaBlock;
+
+// Arena Structure (blocks are kept and reused after a reset)
+typedef struct Arena {
+    ArenaBlock *first;
+    ArenaBlock *current;
+    const struct Js2basAllocator *allocator;  // NULL for malloc()
+} Arena;
+
+void *allocator_alloc(const struct Js2basAllocator *allocator, size_t size);
+void *allocator_resize(const struct Js2basAllocator *allocator, void *ptr, size_t size);
+void allocator_free(const struct Js2basAllocator *allocator, void *ptr);
+void arena_init(Arena *arena);
+void *arena_alloc(Arena *arena, size_t size);
+void arena_reset(Arena *arena);
+void arena_free(Arena *arena);
+
@@ -0,0 +1,562 @@
+/*
+ * bench.c - Benchmark driver timing each phase of the translator.
+ *
+ * Author: Philip R. Simonson
+ * Date: 10/17/2026
+ *
+ * Usage: bench [-r runs] [-o results.json] [-b baseline.json] [-t tolerance] file.js ...
+ * Every phase is run 'runs' times on each file and the fastest run is
+ * kept; small inputs are repeated within a run until it takes long enough
+ * to time. With a baseline, a phase whose MB/s dropped by more than the
+ * tolerance (a fraction, 0.10 by default) makes the driver fail.
+ * Cache misses per phase are reported where the kernel gives access to
+ * the hardware counters, and null elsewhere. The output sizes of
+ * --lines=1,1, --compact and --tokenize --lines=1,1 are reported too,
+ * null when the file does not fit in GW-BASIC line numbers (or in its
+ * 64 KB, tokenized). The tokenized program is listed and crunched again,
+ * which has to give the same bytes.
+ *
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+#include "js2bas.h"
+#include "arena.h"
+#include "input.h"
+#include "sink.h"
+#include "symbols.h"
+#include "token.h"
+#include "parse.h"
+#include "translate.h"
+#include "crunch.h"
+
+// Shortest time a single measurement may take
+#define BENCH_MIN_SECONDS 0.05
+
+// Phases (generate is timed around the generator calls of a full translation)
+enum { PHASE_TOKENIZE, PHASE_PARSE, PHASE_GENERATE, PHASE_END_TO_END, PHASES };
+
+static const char *phase_names[PHASES] = { "tokenize", "parse", "generate", "end_to_end" };
+
+// Result Structure (one input file)
+typedef struct {
+    const char *path;
+    const char *name;
+    size_t bytes;
+    size_t tokens;
+    size_t nodes;
+    size_t statements;
+    size_t ast_bytes;       // syntax tree store, summed over statements
+    size_t output;
+    size_t lines_output;    // --lines=1,1, 0 when it fails
+    size_t compact_output;  // --compact, 0 when it fails
+    size_t tokenized_output;  // --tokenize --lines=1,1, 0 when it fails
+    double seconds[PHASES];
+    double misses[PHASES];  // cache misses per run, -1 without counters
+    size_t allocations;     // end-to-end, cold arena and sinks
+    size_t allocated;
+} Result;
+
+// Allocation counters behind the allocator hooks
+static size_t allocations, allocated;
+
+// Counting allocator
+static void *count_alloc(void *user, size_t size) {
+    allocations++;
+    allocated += size;
+    return malloc(size);
+}
+
+// Counting reallocator
+static void *count_resize(void *user, void *ptr, size_t size) {
+    allocations++;
+    allocated += size;
+    return realloc(ptr, size);
+}
+
+static const Js2basAllocator counting = { count_alloc, count_resize, NULL, NULL };
+
+// Seconds since some fixed point
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Hardware cache miss counter of this thread, -1 if there is none
+static int cache_counter = -1;
+
+// Open the cache miss counter
+static void open_cache_counter(void) {
+#ifdef __linux__
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    cache_counter = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+}
+
+// Cache misses so far, -1 without a counter
+static double cache_misses(void) {
+    long long count;
+
+    if (cache_counter < 0 || read(cache_counter, &count, sizeof(count)) != sizeof(count)) {
+        return -1;
+    }
+    return (double)count;
+}
+
+// Bytes the syntax tree store of a statement takes
+static size_t ast_bytes(const Ast *ast) {
+    return ast->count * (sizeof(*ast->type) + sizeof(*ast->op) + sizeof(*ast->first) + sizeof(*ast->second))
+        + ast->texts * (sizeof(*ast->text) + sizeof(*ast->length))
+        + ast->children_count * sizeof(*ast->children)
+        + ast->ranges_count * sizeof(*ast->ranges);
+}
+
+// Output sink that only counts
+static int discard(void *user, const char *data, size_t length) {
+    *(size_t *)user += length;
+    return 0;
+}
+
+// Count one node
+static void count_node(const Ast *ast, AstIndex node, size_t depth, void *user) {
+    (*(size_t *)user)++;
+}
+
+// Lex the whole input
+static double run_tokenize(const char *source, size_t length, Result *result) {
+    double start = now();
+    size_t tokens = 0;
+    Lexer lex;
+
+    lexer_init(&lex, source, length);
+    while (peek_token(&lex, 0)->type != TOKEN_EOF) {
+        next_token(&lex);
+        tokens++;
+    }
+    result->tokens = tokens;
+    return now() - start;
+}
+
+// Lex and parse the whole input (nodes are counted before each reset);
+// with an output sink every statement is also generated and only the
+// generator calls are timed
+static double run_parse(const char *source, size_t length, Sink *out, Result *result) {
+    size_t nodes = 0, statements = 0, bytes = 0;
+    double start = now(), generating = 0;
+    Arena arena;
+    Parser parser;
+    SymbolTable symbols;
+    Lexer lex;
+    Sink diag;
+    int failed = 0;
+
+    lexer_init(&lex, source, length);
+    symbols_init(&symbols, NULL);
+    lex.symbols = &symbols;
+    arena_init(&arena);
+    sink_init_memory(&diag);
+    parser_init(&parser, &lex, &arena, &diag);
+    while (peek_token(&lex, 0)->type != TOKEN_EOF) {
+        AstIndex ast = parse_statement(&parser);
+        if (ast == AST_NONE) {
+            failed = 1;
+            break;
+        }
+        if (out != NULL) {
+            double begin = now();
+            generate_gwbasic_code(out, &parser.ast, ast, 0);
+            sink_putc(out, '\n');
+            if (out->length > out->batch) {
+                sink_flush(out);
+            }
+            generating += now() - begin;
+        } else {
+            ast_walk(&parser.ast, ast, &arena, count_node, &nodes);
+            bytes += ast_bytes(&parser.ast);
+            statements++;
+        }
+        arena_reset(&arena);
+    }
+    parser_free(&parser);
+    symbols_free(&symbols);
+    arena_free(&arena);
+    sink_free(&diag);
+
+    if (out != NULL) {
+        sink_flush(out);
+        return failed ? -1 : generating;
+    }
+    result->nodes = nodes;
+    result->statements = statements;
+    result->ast_bytes = bytes;
+    return failed ? -1 : now() - start;
+}
+
+// Generate every statement, timing only the generator
+static double run_generate(const char *source, size_t length, Result *result) {
+    size_t output = 0;
+    double seconds;
+    Sink out;
+
+    sink_init_callback(&out, discard, &output);
+    out.batch = 4 * SINK_CHUNK;
+    seconds = run_parse(source, length, &out, result);
+    sink_free(&out);
+    return seconds;
+}
+
+// Translate the whole input with cold buffers, as one CLI run would
+static double run_end_to_end(const char *source, size_t length, Result *result) {
+    size_t output = 0;
+    double start;
+    Arena arena;
+    Sink out, diag;
+    int status;
+
+    allocations = allocated = 0;
+    start = now();
+    arena_init(&arena);
+    arena.allocator = &counting;
+    sink_init_callback(&out, discard, &output);
+    sink_init_memory(&diag);
+    out.allocator = diag.allocator = &counting;
+    out.batch = 4 * SINK_CHUNK;
+    status = translate_buffer(source, length, &arena, &out, &diag, NULL, NULL);
+    arena_free(&arena);
+    sink_free(&out);
+    sink_free(&diag);
+
+    result->output = output;
+    result->allocations = allocations;
+    result->allocated = allocated;
+    return status != TRANSLATE_OK ? -1 : now() - start;
+}
+
+// Bytes of one translation with options, 0 when it fails
+static size_t output_size(const char *source, size_t length, const Js2basOptions *options) {
+    size_t output = 0;
+    Arena arena;
+    Sink out, diag;
+    int status;
+
+    arena_init(&arena);
+    sink_init_callback(&out, discard, &output);
+    sink_init_memory(&diag);
+    out.batch = 4 * SINK_CHUNK;
+    status = translate_buffer(source, length, &arena, &out, &diag, options, NULL);
+    arena_free(&arena);
+    sink_free(&out);
+    sink_free(&diag);
+    return status != TRANSLATE_OK ? 0 : output;
+}
+
+// Bytes of the tokenized program, 0 when it fails or its listing does
+// not crunch back to the same program
+static size_t tokenized_size(const char *source, size_t length) {
+    Js2basOptions options = { .line_start = 1, .line_step = 1, .tokenize = 1 };
+    char *program = NULL, *again = NULL;
+    size_t size = 0, relisted = 0;
+    Arena arena;
+    Sink out, listing, text, diag;
+    Cruncher cruncher;
+
+    arena_init(&arena);
+    sink_init_memory(&out);
+    sink_init_memory(&listing);
+    sink_init_memory(&diag);
+    cruncher_init(&cruncher, &listing, NULL);
+    sink_init_callback(&text, crunch_write, &cruncher);
+    if (translate_buffer(source, length, &arena, &out, &diag, &options, NULL) != TRANSLATE_OK
+            || (program = sink_contents(&out, &size)) == NULL
+            || detokenize((const unsigned char *)program, size, &text) < 0
+            || sink_flush(&text) < 0 || cruncher_finish(&cruncher) < 0
+            || (again = sink_contents(&listing, &relisted)) == NULL) {
+        size = 0;
+    } else if (relisted != size || memcmp(program, again, size) != 0) {
+        fprintf(stderr, "Error: The listing of the tokenized program does not crunch back to it.\n");
+        size = 0;
+    }
+    allocator_free(out.allocator, program);
+    allocator_free(listing.allocator, again);
+    cruncher_free(&cruncher);
+    arena_free(&arena);
+    sink_free(&out);
+    sink_free(&listing);
+    sink_free(&text);
+    sink_free(&diag);
+    return size;
+}
+
+// Time one phase, repeating it until the measurement is long enough;
+// the cache misses of one run go to misses
+static double measure(double (*phase)(const char *, size_t, Result *), const char *source, size_t length, Result *result, double *misses) {
+    double total = 0, before = cache_misses();
+    int iterations = 0;
+
+    do {
+        double seconds = phase(source, length, result);
+        if (seconds < 0) {
+            return -1;
+        }
+        total += seconds;
+        iterations++;
+    } while (total < BENCH_MIN_SECONDS);
+    *misses = before < 0 ? -1 : (cache_misses() - before) / iterations;
+    return total / iterations;
+}
+
+// Lex and parse only
+static double run_parse_only(const char *source, size_t length, Result *result) {
+    return run_parse(source, length, NULL, result);
+}
+
+// Benchmark one file, returns -1 when it cannot be read or translated
+static int bench_file(const char *path, int runs, Result *result) {
+    Sink diag;
+    Input in;
+
+    memset(result, 0, sizeof(Result));
+    result->path = path;
+    result->name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+
+    sink_init_fd(&diag, 2);
+    if (input_open(&in, path, &diag) < 0 || input_read_all(&in) < 0) {
+        sink_flush(&diag);
+        sink_free(&diag);
+        return -1;
+    }
+    result->bytes = in.length;
+    result->lines_output = output_size(in.buffer, in.length, &(Js2basOptions){ .line_start = 1, .line_step = 1 });
+    result->compact_output = output_size(in.buffer, in.length, &(Js2basOptions){ .compact = 1 });
+    result->tokenized_output = tokenized_size(in.buffer, in.length);
+
+    for (int phase = 0; phase < PHASES; ++phase) {
+        result->seconds[phase] = -1;
+    }
+    for (int run = 0; run < runs; ++run) {
+        double t[PHASES], misses[PHASES];
+        t[PHASE_TOKENIZE] = measure(run_tokenize, in.buffer, in.length, result, &misses[PHASE_TOKENIZE]);
+        t[PHASE_PARSE] = measure(run_parse_only, in.buffer, in.length, result, &misses[PHASE_PARSE]);
+        t[PHASE_GENERATE] = measure(run_generate, in.buffer, in.length, result, &misses[PHASE_GENERATE]);
+        t[PHASE_END_TO_END] = measure(run_end_to_end, in.buffer, in.length, result, &misses[PHASE_END_TO_END]);
+        if (t[PHASE_PARSE] < 0 || t[PHASE_GENERATE] < 0 || t[PHASE_END_TO_END] < 0) {
+            sink_printf(&diag, "Error: '%s' does not translate.\n", path);
+            sink_flush(&diag);
+            sink_free(&diag);
+            input_close(&in);
+            return -1;
+        }
+        for (int phase = 0; phase < PHASES; ++phase) {
+            if (result->seconds[phase] < 0 || t[phase] < result->seconds[phase]) {
+                result->seconds[phase] = t[phase];
+                result->misses[phase] = misses[phase];
+            }
+        }
+    }
+
+    sink_free(&diag);
+    input_close(&in);
+    return 0;
+}
+
+// Throughput of a phase in MB/s
+static double mb_per_s(const Result *result, int phase) {
+    return result->bytes / (1024.0 * 1024.0) / result->seconds[phase];
+}
+
+// Write all results as JSON
+static void write_json(FILE *fp, const Result *results, int count, long peak_rss) {
+    fprintf(fp, "{\n  \"peak_rss_kb\": %ld,\n  \"files\": [\n", peak_rss);
+    for (int i = 0; i < count; ++i) {
+        const Result *r = &results[i];
+        fprintf(fp, "    {\n      \"name\": \"%s\",\n      \"bytes\": %zu,\n", r->name, r->bytes);
+        fprintf(fp, "      \"tokens\": %zu,\n      \"nodes\": %zu,\n      \"statements\": %zu,\n",
+            r->tokens, r->nodes, r->statements);
+        fprintf(fp, "      \"ast_bytes_per_node\": %.2f,\n", r->nodes ? (double)r->ast_bytes / r->nodes : 0.0);
+        fprintf(fp, "      \"output_bytes\": %zu,\n      \"allocations\": %zu,\n      \"allocated_bytes\": %zu,\n",
+            r->output, r->allocations, r->allocated);
+        if (r->lines_output > 0 && r->compact_output > 0) {
+            fprintf(fp, "      \"lines_output_bytes\": %zu,\n      \"compact_output_bytes\": %zu,\n",
+                r->lines_output, r->compact_output);
+        } else {
+            fprintf(fp, "      \"lines_output_bytes\": null,\n      \"compact_output_bytes\": null,\n");
+        }
+        if (r->tokenized_output > 0) {
+            fprintf(fp, "      \"tokenized_output_bytes\": %zu,\n", r->tokenized_output);
+        } else {
+            fprintf(fp, "      \"tokenized_output_bytes\": null,\n");
+        }
+        fprintf(fp, "      \"phases\": {\n");
+        for (int phase = 0; phase < PHASES; ++phase) {
+            char misses[32] = "null";
+            if (r->misses[phase] >= 0) {
+                snprintf(misses, sizeof(misses), "%.0f", r->misses[phase]);
+            }
+            fprintf(fp, "        \"%s\": { \"seconds\": %.6f, \"mb_per_s\": %.2f, \"tokens_per_s\": %.0f, \"nodes_per_s\": %.0f, \"cache_misses\": %s }%s\n",
+                phase_names[phase], r->seconds[phase], mb_per_s(r, phase),
+                r->tokens / r->seconds[phase], r->nodes / r->seconds[phase], misses,
+                phase + 1 < PHASES ? "," : "");
+        }
+        fprintf(fp, "      }\n    }%s\n", i + 1 < count ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+}
+
+// Read a whole file into a string
+static char *read_text(const char *path) {
+    char *text = NULL;
+    long length;
+    FILE *fp;
+
+    if ((fp = fopen(path, "rb")) == NULL) {
+        return NULL;
+    }
+    if (fseek(fp, 0, SEEK_END) == 0 && (length = ftell(fp)) >= 0 && fseek(fp, 0, SEEK_SET) == 0
+            && (text = malloc(length + 1)) != NULL) {
+        text[fread(text, 1, length, fp)] = '\0';
+    }
+    fclose(fp);
+    return text;
+}
+
+// Find the MB/s of a phase for a file in a baseline written by write_json()
+static double baseline_mb_per_s(const char *baseline, const char *name, const char *phase) {
+    char key[512];
+    const char *entry, *next, *found;
+
+    snprintf(key, sizeof(key), "\"name\": \"%s\"", name);
+    if ((entry = strstr(baseline, key)) == NULL) {
+        return -1;
+    }
+    next = strstr(entry + 1, "\"name\":");
+    snprintf(key, sizeof(key), "\"%s\": { \"seconds\": ", phase);
+    if ((found = strstr(entry, key)) == NULL || (next != NULL && found > next)) {
+        return -1;
+    }
+    if ((found = strstr(found, "\"mb_per_s\": ")) == NULL) {
+        return -1;
+    }
+    return strtod(found + strlen("\"mb_per_s\": "), NULL);
+}
+
+// Compare against the baseline, returns the number of regressions
+static int compare(const char *baseline, const Result *results, int count, double tolerance) {
+    int regressions = 0;
+
+    for (int i = 0; i < count; ++i) {
+        for (int phase = 0; phase < PHASES; ++phase) {
+            double before = baseline_mb_per_s(baseline, results[i].name, phase_names[phase]);
+            double after = mb_per_s(&results[i], phase);
+            const char *verdict = "ok";
+
+            if (before <= 0) {
+                verdict = "new";
+            } else if (after < before * (1.0 - tolerance)) {
+                verdict = "REGRESSION";
+                regressions++;
+            }
+            printf("%-16s %-10s %10.2f MB/s  baseline %10.2f  %s\n",
+                results[i].name, phase_names[phase], after, before > 0 ? before : 0.0, verdict);
+        }
+    }
+    return regressions;
+}
+
+// Main Function
+int main(int argc, char *argv[]) {
+    const char *output = NULL, *baseline = NULL;
+    double tolerance = 0.10;
+    struct rusage usage;
+    Result *results;
+    int runs = 3, count = 0, result = 0;
+
+    results = calloc(argc, sizeof(Result));
+    if (results == NULL) {
+        return 1;
+    }
+    open_cache_counter();
+    for (int i = 1; i < argc; ++i) {
+        if (argv[i][0] == '-' && argv[i][1] != '\0' && argv[i][2] == '\0' && i + 1 < argc) {
+            switch (argv[i][1]) {
+                case 'r': runs = atoi(argv[++i]); continue;
+                case 'o': output = argv[++i]; continue;
+                case 'b': baseline = argv[++i]; continue;
+                case 't': tolerance = atof(argv[++i]); continue;
+                default: break;
+            }
+        }
+        if (bench_file(argv[i], runs > 0 ? runs : 1, &results[count]) < 0) {
+            free(results);
+            return 1;
+        }
+        count++;
+    }
+    if (count == 0) {
+        fprintf(stderr, "Usage: %s [-r runs] [-o results.json] [-b baseline.json] [-t tolerance] file.js ...\n", argv[0]);
+        free(results);
+        return 1;
+    }
+
+    // JSON goes to the results file when there is one, else to stdout
+    getrusage(RUSAGE_SELF, &usage);
+    if (output == NULL) {
+        write_json(stdout, results, count, usage.ru_maxrss);
+    } else {
+        FILE *fp = fopen(output, "w");
+        if (fp == NULL) {
+            fprintf(stderr, "Error: Cannot create file '%s'.\n", output);
+            free(results);
+            return 1;
+        }
+        write_json(fp, results, count, usage.ru_maxrss);
+        fclose(fp);
+        for (int i = 0; i < count; ++i) {
+            if (results[i].lines_output > 0 && results[i].compact_output > 0) {
+                printf("%-16s --compact %10zu bytes, %5.1f%% smaller than --lines=1,1\n", results[i].name,
+                    results[i].compact_output, 100.0 - 100.0 * results[i].compact_output / results[i].lines_output);
+            }
+            if (results[i].lines_output > 0 && results[i].tokenized_output > 0) {
+                printf("%-16s --tokenize %9zu bytes, %5.1f%% smaller than --lines=1,1\n", results[i].name,
+                    results[i].tokenized_output, 100.0 - 100.0 * results[i].tokenized_output / results[i].lines_output);
+            }
+        }
+    }
+
+    if (baseline != NULL) {
+        char *text = read_text(baseline);
+        if (text == NULL) {
+            fprintf(stderr, "Error: Cannot open baseline '%s'.\n", baseline);
+            result = 1;
+        } else {
+            int regressions = compare(text, results, count, tolerance);
+            if (regressions > 0) {
+                printf("%d phase(s) slower than the baseline by more than %.0f%%.\n", regressions, tolerance * 100);
+                result = 1;
+            }
+            free(text);
+        }
+    }
+
+    free(results);
+    return result;
+}
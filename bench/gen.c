@@ -0,0 +1,275 @@
+/*
+ * gen.c - Seeded generator of valid programs for benchmarking js2bas.
+ *
+ * Author: Philip R. Simonson
+ * Date: 10/17/2026
+ *
+ * Usage: gen [-s seed] [-e terms] <size>[K|M|G]
+ * The same seed and size always give the same program. With -e every
+ * statement is an assignment or print of an expression with exactly
+ * 'terms' operands and parentheses nested at random.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// Deepest block nesting and longest expression generated
+#define GEN_MAX_DEPTH 6
+#define GEN_MAX_TERMS 64
+
+// Generator State
+typedef struct {
+    uint64_t state;     // xorshift64*, the same on every platform
+    size_t written;
+    unsigned terms;     // operands of every expression (-e), 0 for the usual mix
+} Gen;
+
+// Variables keep one type, so programs also make sense to a type checker
+static const char *numbers[] = { "a", "b", "c", "x", "y", "i", "count", "total", "value_2", "loop_index" };
+static const char *strings[] = { "name", "answer", "title", "line_text" };
+static const char *operators[] = { "+", "-", "*", "/", "<", ">", "==" };
+
+#define NUMBERS (sizeof(numbers) / sizeof(numbers[0]))
+#define STRINGS (sizeof(strings) / sizeof(strings[0]))
+
+// Next random number
+static uint64_t gen_next(Gen *g) {
+    g->state ^= g->state >> 12;
+    g->state ^= g->state << 25;
+    g->state ^= g->state >> 27;
+    return g->state * 0x2545f4914f6cdd1dull;
+}
+
+// Random number in [0, n)
+static unsigned gen_below(Gen *g, unsigned n) {
+    return (unsigned)(gen_next(g) % n);
+}
+
+// Write text and count it
+static void emit(Gen *g, const char *text) {
+    size_t length = strlen(text);
+    fwrite(text, 1, length, stdout);
+    g->written += length;
+}
+
+// Write formatted text and count it
+static void emitf(Gen *g, const char *format, unsigned value) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), format, value);
+    emit(g, buffer);
+}
+
+// Indent by depth
+static void indent(Gen *g, int depth) {
+    for (int i = 0; i < depth; ++i) {
+        emit(g, "    ");
+    }
+}
+
+// A number or numeric variable
+static void number_leaf(Gen *g) {
+    if (gen_below(g, 2)) {
+        emitf(g, "%u", gen_below(g, 1000));
+    } else {
+        emit(g, numbers[gen_below(g, NUMBERS)]);
+    }
+}
+
+// A string or string variable
+static void string_leaf(Gen *g) {
+    if (gen_below(g, 2)) {
+        emitf(g, "\"text %u\"", gen_below(g, 100));
+    } else {
+        emit(g, strings[gen_below(g, STRINGS)]);
+    }
+}
+
+// A chain of numeric operands, mostly short with the odd long one
+static void expression(Gen *g) {
+    unsigned terms = gen_below(g, 16) == 0 ? 8 + gen_below(g, GEN_MAX_TERMS - 8) : 1 + gen_below(g, 4);
+
+    number_leaf(g);
+    for (unsigned i = 1; i < terms; ++i) {
+        emit(g, " ");
+        emit(g, operators[gen_below(g, sizeof(operators) / sizeof(operators[0]))]);
+        emit(g, " ");
+        number_leaf(g);
+    }
+}
+
+// An expression of exactly g->terms operands with parenthesized groups
+static void long_expression(Gen *g) {
+    unsigned open = 0;
+
+    for (unsigned i = 0; i < g->terms; ++i) {
+        if (i > 0) {
+            emit(g, " ");
+            emit(g, operators[gen_below(g, sizeof(operators) / sizeof(operators[0]))]);
+            emit(g, " ");
+        }
+        while (gen_below(g, 8) == 0) {
+            emit(g, "(");
+            open++;
+        }
+        number_leaf(g);
+        while (open > 0 && gen_below(g, 8) == 0) {
+            emit(g, ")");
+            open--;
+        }
+    }
+    for (; open > 0; --open) {
+        emit(g, ")");
+    }
+}
+
+// A string concatenation
+static void string_expression(Gen *g) {
+    unsigned terms = 1 + gen_below(g, 3);
+
+    string_leaf(g);
+    for (unsigned i = 1; i < terms; ++i) {
+        emit(g, " + ");
+        string_leaf(g);
+    }
+}
+
+static void statement(Gen *g, int depth);
+
+// A braced block of statements
+static void block(Gen *g, int depth) {
+    unsigned count = gen_below(g, 5);
+
+    emit(g, " {\n");
+    for (unsigned i = 0; i < count; ++i) {
+        statement(g, depth + 1);
+    }
+    indent(g, depth);
+    emit(g, "}");
+}
+
+// One statement of the supported subset
+static void statement(Gen *g, int depth) {
+    unsigned kind = gen_below(g, depth < GEN_MAX_DEPTH ? 10 : 7);
+
+    indent(g, depth);
+    switch (kind) {
+        case 0:
+            emit(g, "var ");
+            if (gen_below(g, 2)) {
+                emit(g, numbers[gen_below(g, NUMBERS)]);
+                emitf(g, " = %u;\n", gen_below(g, 1000));
+            } else {
+                emit(g, strings[gen_below(g, STRINGS)]);
+                emitf(g, " = \"init %u\";\n", gen_below(g, 100));
+            }
+            break;
+        case 1:
+            emit(g, numbers[gen_below(g, NUMBERS)]);
+            emit(g, " = ");
+            expression(g);
+            emit(g, ";\n");
+            break;
+        case 2:
+            emit(g, strings[gen_below(g, STRINGS)]);
+            emit(g, " = ");
+            string_expression(g);
+            emit(g, ";\n");
+            break;
+        case 3:
+            emit(g, "print ");
+            if (gen_below(g, 3)) {
+                expression(g);
+            } else {
+                string_expression(g);
+            }
+            emit(g, ";\n");
+            break;
+        case 4:
+            emit(g, strings[gen_below(g, STRINGS)]);
+            emitf(g, " = input(\"Question %u? \");\n", gen_below(g, 100));
+            break;
+        case 5:
+            emitf(g, "// note %u about this part\n", gen_below(g, 1000));
+            break;
+        case 6:
+            emit(g, "exit;\n");
+            break;
+        case 7:
+        case 8:
+            emit(g, "if (");
+            expression(g);
+            emit(g, ")");
+            block(g, depth);
+            if (gen_below(g, 2)) {
+                emit(g, " else");
+                block(g, depth);
+            }
+            emit(g, "\n");
+            break;
+        default:
+            emit(g, "while (");
+            expression(g);
+            emit(g, ")");
+            block(g, depth);
+            emit(g, "\n");
+            break;
+    }
+}
+
+// Parse a size like 512, 64K, 16M or 1G
+static size_t parse_size(const char *text) {
+    char *end;
+    double value = strtod(text, &end);
+
+    switch (*end) {
+        case 'k': case 'K': value *= 1024; break;
+        case 'm': case 'M': value *= 1024 * 1024; break;
+        case 'g': case 'G': value *= 1024.0 * 1024 * 1024; break;
+        case '\0': break;
+        default: return 0;
+    }
+    return value > 0 ? (size_t)value : 0;
+}
+
+// Main Function
+int main(int argc, char *argv[]) {
+    Gen g = { 0x9e3779b97f4a7c15ull, 0, 0 };
+    const char *size_arg = NULL;
+    size_t size;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            g.state ^= strtoull(argv[++i], NULL, 10) * 0xbf58476d1ce4e5b9ull;
+        } else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+            g.terms = (unsigned)strtoul(argv[++i], NULL, 10);
+        } else {
+            size_arg = argv[i];
+        }
+    }
+    if (size_arg == NULL || (size = parse_size(size_arg)) == 0) {
+        fprintf(stderr, "Usage: %s [-s seed] [-e terms] <size>[K|M|G]\n", argv[0]);
+        return 1;
+    }
+    if (g.state == 0) {
+        g.state = 1;
+    }
+
+    while (g.written < size) {
+        if (g.terms > 0) {
+            if (gen_below(&g, 2)) {
+                emit(&g, numbers[gen_below(&g, NUMBERS)]);
+                emit(&g, " = ");
+            } else {
+                emit(&g, "print ");
+            }
+            long_expression(&g);
+            emit(&g, ";\n");
+        } else {
+            statement(&g, 0);
+        }
+    }
+    return fflush(stdout) == 0 ? 0 : 1;
+}
@@ -0,0 +1,126 @@
+/*
+ * keywords.c - Micro-benchmark of keyword classification in the lexer.
+ *
+ * Author: Philip R. Simonson
+ * Date: 10/17/2026
+ *
+ * Usage: keywords [-r runs] [-n lookups]
+ * Times keyword_type() of token.c against the chain of comparisons the
+ * lexer first had, over a mix of the 7 keywords and 9 identifiers taken
+ * in a seeded random order. The fastest of 'runs' runs of 'lookups'
+ * each is reported, in nanoseconds per identifier.
+ *
+ */
+
+// token.c is built in for its static keyword_type() (and defines
+// _DEFAULT_SOURCE, so it comes first)
+#include "token.c"
+
+#include <time.h>
+
+// Words looked up, keywords and identifiers from bench/gen programs
+static const char *words[] = {
+    "if", "else", "print", "input", "while", "exit", "var",
+    "a", "x", "count", "total", "value_2", "loop_index", "name", "answer", "line_text"
+};
+
+#define WORDS (sizeof(words) / sizeof(words[0]))
+
+// Lookups in one pass over the order, a power of two
+#define ORDER 4096
+
+// The lexer's first keyword classification, one comparison per keyword
+// (not inlined, like keyword_type() which token.c calls too)
+__attribute__((noinline)) static TokenType keyword_chain(const char *text, size_t length) {
+    if (length == 2 && memcmp(text, "if", 2) == 0) {
+        return TOKEN_IF;
+    } else if (length == 4 && memcmp(text, "else", 4) == 0) {
+        return TOKEN_ELSE;
+    } else if (length == 5 && memcmp(text, "print", 5) == 0) {
+        return TOKEN_PRINT;
+    } else if (length == 5 && memcmp(text, "input", 5) == 0) {
+        return TOKEN_INPUT;
+    } else if (length == 5 && memcmp(text, "while", 5) == 0) {
+        return TOKEN_WHILE;
+    } else if (length == 4 && memcmp(text, "exit", 4) == 0) {
+        return TOKEN_EXIT;
+    } else if (length == 3 && memcmp(text, "var", 3) == 0) {
+        return TOKEN_ASSIGN;
+    }
+    return TOKEN_IDENTIFIER;
+}
+
+// Word and its length, in the order they are looked up
+typedef struct {
+    const char *text;
+    size_t length;
+} Word;
+
+// Wall clock in seconds
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Fastest run of lookups through the chain or keyword_type(), in nanoseconds
+// per lookup (both are called directly, so they inline as in the lexer)
+static double measure(int chain, const Word *order, long lookups, int runs) {
+    volatile unsigned sink = 0;
+    double best = 0;
+
+    for (int run = 0; run < runs; ++run) {
+        unsigned keywords = 0;
+        double start = now(), seconds;
+
+        for (long i = 0; i < lookups; ++i) {
+            const Word *word = &order[i & (ORDER - 1)];
+            TokenType type = chain ? keyword_chain(word->text, word->length) : keyword_type(word->text, word->length);
+            keywords += type != TOKEN_IDENTIFIER;
+        }
+        seconds = now() - start;
+        sink += keywords;
+        if (run == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+    return best * 1e9 / lookups;
+}
+
+int main(int argc, char *argv[]) {
+    static Word order[ORDER];
+    uint64_t state = 1;
+    long lookups = 50000000;
+    int runs = 5;
+
+    for (int i = 1; i < argc; ++i) {
+        if (argv[i][0] == '-' && argv[i][1] != '\0' && argv[i][2] == '\0' && i + 1 < argc) {
+            switch (argv[i][1]) {
+                case 'r': runs = atoi(argv[++i]); continue;
+                case 'n': lookups = atol(argv[++i]); continue;
+                default: break;
+            }
+        }
+        fprintf(stderr, "Usage: %s [-r runs] [-n lookups]\n", argv[0]);
+        return 1;
+    }
+    if (runs < 1 || lookups < 1) {
+        fprintf(stderr, "Usage: %s [-r runs] [-n lookups]\n", argv[0]);
+        return 1;
+    }
+
+    // xorshift64*, as bench/gen uses, so every run looks up the same words
+    for (int i = 0; i < ORDER; ++i) {
+        const char *text;
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        text = words[(state * 0x2545f4914f6cdd1dull) % WORDS];
+        order[i] = (Word){ text, strlen(text) };
+    }
+
+    printf("chain:        %5.1f ns per identifier\n", measure(1, order, lookups, runs));
+    printf("keyword_type: %5.1f ns per identifier\n", measure(0, order, lookups, runs));
+    return 0;
+}
@@ -0,0 +1,354 @@
+/*
+ * client.c - Client and load generator for the js2bas translation server.
+ *
+ * Author: Philip R. Simonson
+ * Date: 10/17/2026
+ *
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+// Session Structure (one connection sending a run of pipelined requests)
+typedef struct {
+    const char *path;
+    char **bodies;      // request sources, request i sends bodies[i % count]
+    size_t *lengths;
+    char **names;
+    size_t bodies_count;
+    size_t count;       // requests to send
+    size_t depth;       // most requests in flight at once
+    int print;          // write responses to stdout/stderr
+    double *latency;    // milliseconds per request
+    int failed;         // some request came back with an error
+    int broken;         // the connection failed
+} Session;
+
+// Milliseconds since some fixed point
+static double now_ms(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e3 + now.tv_nsec / 1e6;
+}
+
+// Decode a big endian number
+static uint32_t get_u32(const unsigned char *p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+// Read a whole file
+static char *read_file(const char *filename, size_t *length) {
+    char *data = NULL;
+    size_t capacity = 0;
+    FILE *fp;
+
+    if ((fp = fopen(filename, "rb")) == NULL) {
+        fprintf(stderr, "Error: Cannot open file '%s'.\n", filename);
+        return NULL;
+    }
+    *length = 0;
+    for (;;) {
+        if (capacity - *length < 65536) {
+            char *tmp = realloc(data, capacity = capacity * 2 + 65536);
+            if (tmp == NULL) {
+                free(data);
+                fclose(fp);
+                return NULL;
+            }
+            data = tmp;
+        }
+        size_t n = fread(data + *length, 1, capacity - *length, fp);
+        if (n == 0) {
+            break;
+        }
+        *length += n;
+    }
+    fclose(fp);
+    return data;
+}
+
+// Connect to the server
+static int connect_server(const char *path) {
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    int fd;
+
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+// Handle one complete response
+static void session_response(Session *s, size_t index, uint32_t status, const char *data, uint32_t length) {
+    if (status != 0) {
+        s->failed = 1;
+    }
+    if (!s->print) {
+        return;
+    }
+    if (status == 0) {
+        fwrite(data, 1, length, stdout);
+    } else {
+        fprintf(stderr, "In file '%s':\n%.*s", s->names[index % s->bodies_count], (int)length, data);
+    }
+}
+
+// Send all requests of the session and collect the responses, keeping up
+// to depth requests in flight; sending and receiving never block each other
+static void *session_run(void *context) {
+    Session *s = context;
+    size_t sent = 0, received = 0, offset = 0;
+    size_t length = 0, capacity = 65536;
+    unsigned char header[4];
+    double *started = calloc(s->count ? s->count : 1, sizeof(double));
+    char *buffer = malloc(capacity);
+    int fd = connect_server(s->path);
+
+    if (fd < 0 || started == NULL || buffer == NULL) {
+        if (fd < 0) {
+            fprintf(stderr, "Error: Cannot connect to '%s': %s.\n", s->path, strerror(errno));
+        }
+        s->broken = 1;
+        goto done;
+    }
+
+    while (received < s->count) {
+        int sending = sent < s->count && sent - received < s->depth;
+        struct pollfd pfd = { .fd = fd, .events = POLLIN | (sending ? POLLOUT : 0) };
+
+        if (poll(&pfd, 1, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            s->broken = 1;
+            break;
+        }
+
+        if (sending && (pfd.revents & POLLOUT)) {
+            const char *body = s->bodies[sent % s->bodies_count];
+            size_t size = s->lengths[sent % s->bodies_count];
+            struct iovec iov[2];
+            int n = 0;
+
+            if (offset == 0) {
+                header[0] = (unsigned char)(size >> 24);
+                header[1] = (unsigned char)(size >> 16);
+                header[2] = (unsigned char)(size >> 8);
+                header[3] = (unsigned char)size;
+                started[sent] = now_ms();
+            }
+            if (offset < 4) {
+                iov[n].iov_base = header + offset;
+                iov[n++].iov_len = 4 - offset;
+            }
+            iov[n].iov_base = (char *)body + (offset > 4 ? offset - 4 : 0);
+            iov[n++].iov_len = size - (offset > 4 ? offset - 4 : 0);
+
+            ssize_t nbytes = writev(fd, iov, n);
+            if (nbytes < 0 && errno != EAGAIN && errno != EINTR) {
+                s->broken = 1;
+                break;
+            }
+            if (nbytes > 0 && (offset += (size_t)nbytes) == 4 + size) {
+                offset = 0;
+                sent++;
+            }
+        }
+
+        if (pfd.revents & (POLLIN | POLLHUP | POLLERR)) {
+            if (capacity - length < 65536) {
+                char *tmp = realloc(buffer, capacity *= 2);
+                if (tmp == NULL) {
+                    s->broken = 1;
+                    break;
+                }
+                buffer = tmp;
+            }
+            ssize_t nbytes = read(fd, buffer + length, capacity - length);
+            if (nbytes == 0 || (nbytes < 0 && errno != EAGAIN && errno != EINTR)) {
+                fprintf(stderr, "Error: Connection to '%s' closed.\n", s->path);
+                s->broken = 1;
+                break;
+            }
+            if (nbytes > 0) {
+                length += (size_t)nbytes;
+            }
+
+            // Every complete response in the buffer
+            size_t done = 0;
+            while (length - done >= 8) {
+                uint32_t status = get_u32((unsigned char *)buffer + done);
+                uint32_t size = get_u32((unsigned char *)buffer + done + 4);
+                if (length - done - 8 < size) {
+                    break;
+                }
+                if (s->latency != NULL) {
+                    s->latency[received] = now_ms() - started[received];
+                }
+                session_response(s, received, status, buffer + done + 8, size);
+                received++;
+                done += 8 + (size_t)size;
+            }
+            memmove(buffer, buffer + done, length - done);
+            length -= done;
+        }
+    }
+
+done:
+    if (fd >= 0) {
+        close(fd);
+    }
+    free(started);
+    free(buffer);
+    return NULL;
+}
+
+// Order latencies
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Run the load generator and report requests per second and latencies
+static int bench(Session *base, int connections) {
+    Session *sessions = calloc(connections, sizeof(Session));
+    pthread_t *threads = calloc(connections, sizeof(pthread_t));
+    double *latency = calloc(base->count ? base->count : 1, sizeof(double));
+    size_t total = 0;
+    double start, elapsed;
+    int result = 0;
+
+    if (sessions == NULL || threads == NULL || latency == NULL) {
+        fprintf(stderr, "Error: Out of memory.\n");
+        return 1;
+    }
+
+    start = now_ms();
+    for (int i = 0; i < connections; ++i) {
+        size_t count = base->count / connections + ((size_t)i < base->count % connections);
+        sessions[i] = *base;
+        sessions[i].count = count;
+        sessions[i].latency = latency + total;
+        total += count;
+        if (pthread_create(&threads[i], NULL, session_run, &sessions[i]) != 0) {
+            fprintf(stderr, "Error: Cannot start client threads.\n");
+            return 1;
+        }
+    }
+    for (int i = 0; i < connections; ++i) {
+        pthread_join(threads[i], NULL);
+        if (sessions[i].broken) {
+            result = 1;
+        }
+    }
+    elapsed = now_ms() - start;
+
+    if (result == 0) {
+        qsort(latency, total, sizeof(double), compare_double);
+        printf("%zu requests, %d connections, depth %zu: %.0f req/s, p50 %.3f ms, p99 %.3f ms\n",
+            total, connections, base->depth, total / (elapsed / 1e3),
+            total ? latency[(total - 1) / 2] : 0.0, total ? latency[(total - 1) * 99 / 100] : 0.0);
+    }
+    free(sessions);
+    free(threads);
+    free(latency);
+    return result;
+}
+
+// Main Function
+int main(int argc, char *argv[]) {
+    Session session = {0};
+    int benchmark = 0, connections = 1, result = 0;
+    size_t requests = 10000, depth = 16;
+    int first;
+
+    for (first = 1; first < argc && argv[first][0] == '-' && argv[first][1] != '\0'; ++first) {
+        char option = argv[first][1];
+        if (option == 'b') {
+            benchmark = 1;
+            continue;
+        }
+        if ((option == 'n' || option == 'c' || option == 'd') && first + 1 < argc) {
+            long value = atol(argv[++first]);
+            if (value <= 0) {
+                fprintf(stderr, "Option '%c' needs a positive number.\n", option);
+                return 1;
+            }
+            if (option == 'n') {
+                requests = (size_t)value;
+            } else if (option == 'c') {
+                connections = (int)value;
+            } else {
+                depth = (size_t)value;
+            }
+            continue;
+        }
+        fprintf(stderr, "Unknown option '%c'.\n", option);
+        return 1;
+    }
+    if (argc - first < 2) {
+        fprintf(stderr, "Usage: %s [-b [-n requests] [-c connections] [-d depth]] <socket> <filename.js> ...\n", argv[0]);
+        return 1;
+    }
+
+    session.path = argv[first];
+    session.bodies_count = (size_t)(argc - first - 1);
+    session.bodies = calloc(session.bodies_count, sizeof(char*));
+    session.lengths = calloc(session.bodies_count, sizeof(size_t));
+    session.names = &argv[first + 1];
+    if (session.bodies == NULL || session.lengths == NULL) {
+        fprintf(stderr, "Error: Out of memory.\n");
+        return 1;
+    }
+    for (size_t i = 0; i < session.bodies_count; ++i) {
+        if ((session.bodies[i] = read_file(session.names[i], &session.lengths[i])) == NULL) {
+            result = 1;
+            goto done;
+        }
+    }
+
+    if (benchmark) {
+        // Files are sent round robin, responses are only timed
+        session.count = requests;
+        session.depth = depth;
+        result = bench(&session, connections);
+    } else {
+        // Every file once, all pipelined on one connection
+        session.count = session.bodies_count;
+        session.depth = session.bodies_count;
+        session.print = 1;
+        session_run(&session);
+        result = session.failed || session.broken;
+    }
+
+done:
+    for (size_t i = 0; i < session.bodies_count; ++i) {
+        free(session.bodies[i]);
+    }
+    free(session.bodies);
+    free(session.lengths);
+    return result;
+}
@@ -0,0 +1,573 @@
+/*
+ * crunch.c - Tokenized GW-BASIC program files (--tokenize and --list).
+ *
+ * Author: Philip R. Simonson
+ * Date: 10/17/2026
+ *
+ * GW-BASIC crunches every line it loads from an ASCII file into tokens;
+ * a tokenized file is that form saved as is, so it loads without the
+ * crunching and takes less room. After the header byte every line is
+ *     link (2 bytes) / line number (2 bytes) / tokens / 0
+ * with the link the address of the next line, and two zero bytes end the
+ * program. Keywords and operators are one byte, a number after GOTO or
+ * THEN is a line number (0x0E), other numbers are binary: 0 to 9 in one
+ * byte, up to 255 in two, an INTEGER in three, a SINGLE or DOUBLE in
+ * Microsoft Binary Format after its type byte. Names, strings, spaces,
+ * punctuation and the text after REM stay ASCII (names in capitals).
+ * Only the keywords the generator writes are known; none of them need
+ * the two byte tokens starting 0xFD, 0xFE or 0xFF.
+ *
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stdint.h>
+#include "js2bas.h"
+#include "arena.h"
+#include "sink.h"
+#include "crunch.h"
+
+// Tokens of numbers
+#define TOKEN_LINE 0x0e         // line number, 2 bytes
+#define TOKEN_BYTE 0x0f         // 10 to 255, 1 byte
+#define TOKEN_DIGIT 0x11        // 0 to 9, in the token itself
+#define TOKEN_INTEGER 0x1c      // 2 bytes
+#define TOKEN_SINGLE 0x1d       // 4 bytes
+#define TOKEN_DOUBLE 0x1f       // 8 bytes
+
+// Tokens with a meaning of their own
+#define TOKEN_REM 0x8f
+#define TOKEN_PRINT 0x91
+#define TOKEN_ELSE 0xa1         // stored after a ':'
+
+// Types of numeric constants
+#define NUMBER_INTEGER 0
+#define NUMBER_SINGLE 1
+#define NUMBER_DOUBLE 2
+
+// Most digits of a SINGLE written without a suffix
+#define SINGLE_DIGITS 7
+
+// Keywords and operators with their tokens
+static const struct {
+    const char *name;
+    unsigned char token;
+    int jumps;          // a number after it is a line number
+} keywords[] = {
+    { "END", 0x81, 0 },
+    { "INPUT", 0x85, 0 },
+    { "DIM", 0x86, 0 },
+    { "GOTO", 0x89, 1 },
+    { "IF", 0x8b, 0 },
+    { "REM", TOKEN_REM, 0 },
+    { "PRINT", TOKEN_PRINT, 0 },
+    { "ELSE", TOKEN_ELSE, 1 },
+    { "WHILE", 0xb1, 0 },
+    { "WEND", 0xb2, 0 },
+    { "THEN", 0xcd, 1 },
+    { "NOT", 0xd3, 0 },
+    { ">", 0xe6, 0 },
+    { "=", 0xe7, 0 },
+    { "<", 0xe8, 0 },
+    { "+", 0xe9, 0 },
+    { "-", 0xea, 0 },
+    { "*", 0xeb, 0 },
+    { "/", 0xec, 0 },
+    { "^", 0xed, 0 },
+    { "AND", 0xee, 0 },
+    { "OR", 0xef, 0 },
+    { "MOD", 0xf3, 0 },
+    { "\\", 0xf4, 0 }
+};
+
+#define KEYWORDS (sizeof(keywords) / sizeof(keywords[0]))
+
+// Initialize a cruncher writing the tokenized program to out
+void cruncher_init(Cruncher *cruncher, Sink *out, const struct Js2basAllocator *allocator) {
+    memset(cruncher, 0, sizeof(Cruncher));
+    cruncher->out = out;
+    cruncher->allocator = allocator;
+    cruncher->address = CRUNCH_TEXT_BASE;
+}
+
+// Free the buffers of a cruncher
+void cruncher_free(Cruncher *cruncher) {
+    allocator_free(cruncher->allocator, cruncher->line);
+    allocator_free(cruncher->allocator, cruncher->record);
+    memset(cruncher, 0, sizeof(Cruncher));
+}
+
+// Make room for needed more bytes in a buffer, -1 when out of memory
+static int reserve(Cruncher *cruncher, void *buffer, size_t *capacity, size_t used, size_t needed) {
+    size_t size = *capacity ? *capacity : 256;
+    void *tmp;
+
+    if (used + needed <= *capacity) {
+        return 0;
+    }
+    while (size < used + needed) {
+        size *= 2;
+    }
+    if ((tmp = allocator_resize(cruncher->allocator, *(void **)buffer, size)) == NULL) {
+        cruncher->error = ENOMEM;
+        return -1;
+    }
+    *(void **)buffer = tmp;
+    *capacity = size;
+    return 0;
+}
+
+// Append bytes to the line being tokenized
+static void put(Cruncher *cruncher, const void *data, size_t length) {
+    if (reserve(cruncher, &cruncher->record, &cruncher->record_capacity, cruncher->record_length, length) == 0) {
+        memcpy(cruncher->record + cruncher->record_length, data, length);
+        cruncher->record_length += length;
+    }
+}
+
+// Append one byte to the line being tokenized
+static void put_byte(Cruncher *cruncher, unsigned value) {
+    unsigned char byte = (unsigned char)value;
+    put(cruncher, &byte, 1);
+}
+
+// Append a little endian number of size bytes
+static void put_little(Cruncher *cruncher, uint64_t value, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        put_byte(cruncher, (unsigned)(value >> (8 * i)) & 0xff);
+    }
+}
+
+// Read a numeric constant: digits, a '.', an exponent and a type suffix,
+// as GW-BASIC types it; returns its length, 0 if there is none
+static size_t read_number(const char *text, size_t length, double *value, int *type) {
+    char digits[64];
+    size_t i = 0, significant = 0, n = 0;
+    int point = 0, exponent = 0;
+
+    *type = NUMBER_INTEGER;
+    while (i < length && (isdigit((unsigned char)text[i]) || (text[i] == '.' && !point))) {
+        if (text[i] == '.') {
+            point = 1;
+        } else if (significant > 0 || text[i] != '0') {
+            significant++;
+        }
+        if (n + 1 < sizeof(digits)) {
+            digits[n++] = text[i];
+        }
+        i++;
+    }
+    if (i == 0 || (i == 1 && point)) {
+        return 0;
+    }
+    if (i < length && (text[i] == 'E' || text[i] == 'D')) {
+        size_t j = i + 1;
+        if (j < length && (text[j] == '+' || text[j] == '-')) {
+            j++;
+        }
+        if (j < length && isdigit((unsigned char)text[j])) {
+            exponent = text[i];
+            if (n + 1 < sizeof(digits)) {
+                digits[n++] = 'E';
+            }
+            for (i++; i < length && (isdigit((unsigned char)text[i]) || text[i] == '+' || text[i] == '-'); ++i) {
+                if (n + 1 < sizeof(digits)) {
+                    digits[n++] = text[i];
+                }
+            }
+        }
+    }
+    digits[n] = '\0';
+    *value = strtod(digits, NULL);
+
+    if (i < length && (text[i] == '#' || text[i] == '&')) {
+        *type = NUMBER_DOUBLE;  // GW-BASIC has no LONG, DOUBLE holds it exactly
+        i++;
+    } else if (i < length && text[i] == '!') {
+        *type = NUMBER_SINGLE;
+        i++;
+    } else if (i < length && text[i] == '%' && !point && !exponent && *value <= 32767) {
+        i++;
+    } else if (exponent == 'D' || significant > SINGLE_DIGITS) {
+        *type = NUMBER_DOUBLE;
+    } else if (exponent || point || *value > 32767) {
+        *type = NUMBER_SINGLE;
+    }
+    return i;
+}
+
+// Microsoft Binary Format of a SINGLE: exponent byte (bias 129), then
+// the sign and 23 bits of mantissa
+static uint32_t mbf_single(float value) {
+    uint32_t bits, exponent;
+
+    memcpy(&bits, &value, sizeof(bits));
+    exponent = (bits >> 23) & 0xff;
+    if (exponent == 0) {
+        return 0;
+    }
+    exponent = exponent + 2 > 0xff ? 0xff : exponent + 2;
+    return exponent << 24 | (bits >> 31) << 23 | (bits & 0x7fffff);
+}
+
+// Microsoft Binary Format of a DOUBLE: the same exponent byte, then the
+// sign and 55 bits of mantissa
+static uint64_t mbf_double(double value) {
+    uint64_t bits;
+    int64_t exponent;
+
+    memcpy(&bits, &value, sizeof(bits));
+    exponent = (int64_t)((bits >> 52) & 0x7ff) - 1023 + 129;
+    if (exponent <= 0 || ((bits >> 52) & 0x7ff) == 0) {
+        return 0;
+    }
+    if (exponent > 0xff) {
+        exponent = 0xff;
+    }
+    return (uint64_t)exponent << 56 | (bits >> 63) << 55 | (bits & 0xfffffffffffffull) << 3;
+}
+
+// IEEE value of a SINGLE in Microsoft Binary Format
+static float ieee_single(uint32_t mbf) {
+    uint32_t exponent = mbf >> 24, bits;
+    float value;
+
+    if (exponent <= 2) {
+        return 0;
+    }
+    bits = ((mbf >> 23) & 1) << 31 | (exponent - 2) << 23 | (mbf & 0x7fffff);
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// IEEE value of a DOUBLE in Microsoft Binary Format
+static double ieee_double(uint64_t mbf) {
+    uint64_t exponent = mbf >> 56, bits;
+    double value;
+
+    if (exponent == 0) {
+        return 0;
+    }
+    bits = ((mbf >> 55) & 1) << 63 | (exponent - 129 + 1023) << 52 | ((mbf >> 3) & 0xfffffffffffffull);
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Append a numeric constant in its binary form
+static void put_number(Cruncher *cruncher, double value, int type) {
+    if (type == NUMBER_INTEGER && value < 10) {
+        put_byte(cruncher, TOKEN_DIGIT + (unsigned)value);
+    } else if (type == NUMBER_INTEGER && value < 256) {
+        put_byte(cruncher, TOKEN_BYTE);
+        put_byte(cruncher, (unsigned)value);
+    } else if (type == NUMBER_INTEGER) {
+        put_byte(cruncher, TOKEN_INTEGER);
+        put_little(cruncher, (uint16_t)(int)value, 2);
+    } else if (type == NUMBER_SINGLE) {
+        put_byte(cruncher, TOKEN_SINGLE);
+        put_little(cruncher, mbf_single((float)value), 4);
+    } else {
+        put_byte(cruncher, TOKEN_DOUBLE);
+        put_little(cruncher, mbf_double(value), 8);
+    }
+}
+
+// Tokenize one line of text and write it; returns -1 when it has no
+// line number, the program outgrows the segment or memory ran out
+static int crunch_line(Cruncher *cruncher, const char *text, size_t length) {
+    size_t i = 0, word;
+    unsigned number = 0;
+    int jump = 0;
+
+    while (length > 0 && text[length - 1] == '\r') {
+        length--;
+    }
+    if (length == 0) {
+        return 0;
+    }
+    while (i < length && isdigit((unsigned char)text[i]) && number <= 0xffff) {
+        number = number * 10 + (unsigned)(text[i++] - '0');
+    }
+    if (i == 0 || number > 0xffff) {
+        cruncher->error = EINVAL;
+        return -1;
+    }
+    if (i < length && text[i] == ' ') {
+        i++;  // LIST puts it back
+    }
+
+    cruncher->record_length = 0;
+    put_little(cruncher, 0, 2);  // link, known at the end
+    put_little(cruncher, number, 2);
+    while (i < length) {
+        unsigned char c = (unsigned char)text[i];
+        double value;
+        int type;
+
+        if (c == '"') {
+            // Strings are kept as they are, to the closing quote
+            const char *end = memchr(text + i + 1, '"', length - i - 1);
+            word = end != NULL ? (size_t)(end - text) + 1 - i : length - i;
+            put(cruncher, text + i, word);
+            i += word;
+            jump = 0;
+        } else if (isalpha(c)) {
+            // A keyword, or a name (capitals, with any '.' and digits)
+            size_t k;
+            for (word = i; word < length && (isalnum((unsigned char)text[word]) || text[word] == '.'); ++word) {
+            }
+            for (k = 0; k < KEYWORDS; ++k) {
+                if (isalpha((unsigned char)keywords[k].name[0]) && strlen(keywords[k].name) == word - i
+                        && strncasecmp(keywords[k].name, text + i, word - i) == 0) {
+                    break;
+                }
+            }
+            if (k < KEYWORDS && keywords[k].token == TOKEN_ELSE) {
+                put_byte(cruncher, ':');
+            }
+            if (k < KEYWORDS) {
+                put_byte(cruncher, keywords[k].token);
+                jump = keywords[k].jumps;
+                i = word;
+                if (keywords[k].token == TOKEN_REM) {
+                    put(cruncher, text + i, length - i);
+                    i = length;
+                }
+                continue;
+            }
+            for (; i < word; ++i) {
+                put_byte(cruncher, (unsigned)toupper((unsigned char)text[i]));
+            }
+            jump = 0;
+        } else if ((word = read_number(text + i, length - i, &value, &type)) > 0) {
+            if (jump && type == NUMBER_INTEGER && word == strspn(text + i, "0123456789")) {
+                put_byte(cruncher, TOKEN_LINE);
+                put_little(cruncher, (unsigned)value, 2);
+            } else {
+                put_number(cruncher, value, type);
+            }
+            i += word;
+            jump = 0;
+        } else if (c == '?') {
+            put_byte(cruncher, TOKEN_PRINT);
+            i++;
+            jump = 0;
+        } else if (c == ' ') {
+            put_byte(cruncher, c);
+            i++;
+        } else {
+            size_t k;
+            for (k = 0; k < KEYWORDS; ++k) {
+                if (keywords[k].name[0] == (char)c && keywords[k].name[1] == '\0') {
+                    break;
+                }
+            }
+            put_byte(cruncher, k < KEYWORDS ? keywords[k].token : c);
+            i++;
+            jump = 0;
+        }
+    }
+    put_byte(cruncher, 0);
+    if (cruncher->error == 0 && cruncher->address + cruncher->record_length > CRUNCH_TEXT_END) {
+        cruncher->error = EFBIG;
+    }
+    if (cruncher->error != 0) {
+        return -1;
+    }
+
+    cruncher->address += (unsigned)cruncher->record_length;
+    cruncher->record[0] = (unsigned char)(cruncher->address & 0xff);
+    cruncher->record[1] = (unsigned char)(cruncher->address >> 8 & 0xff);
+    sink_write(cruncher->out, (const char *)cruncher->record, cruncher->record_length);
+    return 0;
+}
+
+// Write the header before the first line
+static void start(Cruncher *cruncher) {
+    if (!cruncher->started) {
+        sink_putc(cruncher->out, (char)CRUNCH_HEADER);
+        cruncher->started = 1;
+    }
+}
+
+// Sink callback taking the text: complete lines are tokenized and
+// written, the rest waits for its newline
+int crunch_write(void *user, const char *data, size_t length) {
+    Cruncher *cruncher = user;
+    const char *end = data + length, *newline;
+
+    start(cruncher);
+    while (cruncher->error == 0 && data < end) {
+        size_t part;
+
+        newline = memchr(data, '\n', (size_t)(end - data));
+        part = (size_t)((newline != NULL ? newline : end) - data);
+        if (reserve(cruncher, &cruncher->line, &cruncher->capacity, cruncher->length, part) < 0) {
+            break;
+        }
+        memcpy(cruncher->line + cruncher->length, data, part);
+        cruncher->length += part;
+        data += part;
+        if (newline != NULL) {
+            crunch_line(cruncher, cruncher->line, cruncher->length);
+            cruncher->length = 0;
+            data++;
+        }
+    }
+    return cruncher->error != 0 ? -1 : 0;
+}
+
+// Tokenize what is left and end the program; returns -1 on an error
+int cruncher_finish(Cruncher *cruncher) {
+    start(cruncher);
+    if (cruncher->error == 0 && cruncher->length > 0) {
+        crunch_line(cruncher, cruncher->line, cruncher->length);
+        cruncher->length = 0;
+    }
+    sink_write(cruncher->out, "\0\0", 2);
+    sink_putc(cruncher->out, (char)CRUNCH_EOF);
+    return cruncher->error != 0 ? -1 : 0;
+}
+
+// Write a number back as text, with a type suffix where the text alone
+// would read as another type
+static void list_number(Sink *out, double value, int type) {
+    char text[48];
+    double check;
+    int read;
+
+    if (value >= -1e15 && value <= 1e15 && (double)(int64_t)value == value) {
+        snprintf(text, sizeof(text), "%lld", (long long)value);
+    } else {
+        snprintf(text, sizeof(text), type == NUMBER_SINGLE ? "%.7G" : "%.17G", value);
+    }
+    sink_puts(out, text);
+    read_number(text, strlen(text), &check, &read);
+    if (read != type) {
+        sink_putc(out, type == NUMBER_SINGLE ? '!' : '#');
+    }
+}
+
+// Little endian number of size bytes
+static uint64_t get_little(const unsigned char *data, size_t size) {
+    uint64_t value = 0;
+
+    for (size_t i = size; i > 0; --i) {
+        value = value << 8 | data[i - 1];
+    }
+    return value;
+}
+
+// Index of the keyword of a token, KEYWORDS if it has none
+static size_t keyword_index(unsigned char token) {
+    size_t k;
+
+    for (k = 0; k < KEYWORDS && keywords[k].token != token; ++k) {
+    }
+    return k;
+}
+
+// Whether a token lists as a letter, digit or '.'; a keyword is only
+// read back as one when nothing of a name or number touches it
+static int lists_as_word(unsigned char c) {
+    if (c < 0x80) {
+        return isalnum(c) || c == '.' || (c >= TOKEN_LINE && c <= TOKEN_DOUBLE);
+    }
+    return keyword_index(c) < KEYWORDS && isalpha((unsigned char)keywords[keyword_index(c)].name[0]);
+}
+
+// Write the listing of a tokenized program, as GW-BASIC's LIST would
+// but with a space between a keyword and a name ('?' crunches to PRINT);
+// returns -1 when it is not one
+int detokenize(const unsigned char *data, size_t length, Sink *out) {
+    size_t i = 1;
+
+    if (length == 0 || data[0] != CRUNCH_HEADER) {
+        return -1;
+    }
+    for (;;) {
+        if (i + 2 > length) {
+            return -1;
+        }
+        if (get_little(data + i, 2) == 0) {
+            return 0;
+        }
+        if (i + 4 > length) {
+            return -1;
+        }
+        sink_printf(out, "%u ", (unsigned)get_little(data + i + 2, 2));
+        i += 4;
+
+        while (i < length && data[i] != 0) {
+            unsigned char c = data[i++];
+            size_t k;
+
+            if (c == '"') {
+                const unsigned char *end = memchr(data + i, '"', length - i);
+                size_t stop = end != NULL ? (size_t)(end - data) + 1 : length;
+                if (memchr(data + i, 0, stop - i) != NULL) {
+                    stop = (size_t)((const unsigned char *)memchr(data + i, 0, stop - i) - data);
+                }
+                sink_putc(out, '"');
+                sink_write(out, (const char *)data + i, stop - i);
+                i = stop;
+            } else if (c == TOKEN_REM) {
+                const unsigned char *end = memchr(data + i, 0, length - i);
+                size_t stop = end != NULL ? (size_t)(end - data) : length;
+                sink_literal(out, "REM");
+                sink_write(out, (const char *)data + i, stop - i);
+                i = stop;
+            } else if (c == ':' && i < length && data[i] == TOKEN_ELSE) {
+                continue;  // ELSE lists without its ':'
+            } else if (c == TOKEN_LINE || c == TOKEN_INTEGER) {
+                if (i + 2 > length) {
+                    return -1;
+                }
+                if (c == TOKEN_LINE) {
+                    sink_printf(out, "%u", (unsigned)get_little(data + i, 2));
+                } else {
+                    sink_printf(out, "%d", (int)(int16_t)get_little(data + i, 2));
+                }
+                i += 2;
+            } else if (c == TOKEN_BYTE) {
+                if (i + 1 > length) {
+                    return -1;
+                }
+                sink_printf(out, "%u", data[i++]);
+            } else if (c >= TOKEN_DIGIT && c < TOKEN_DIGIT + 10) {
+                sink_putc(out, (char)('0' + c - TOKEN_DIGIT));
+            } else if (c == TOKEN_SINGLE) {
+                if (i + 4 > length) {
+                    return -1;
+                }
+                list_number(out, ieee_single((uint32_t)get_little(data + i, 4)), NUMBER_SINGLE);
+                i += 4;
+            } else if (c == TOKEN_DOUBLE) {
+                if (i + 8 > length) {
+                    return -1;
+                }
+                list_number(out, ieee_double(get_little(data + i, 8)), NUMBER_DOUBLE);
+                i += 8;
+            } else if (c < 0x80) {
+                sink_putc(out, (char)c);
+            } else if ((k = keyword_index(c)) < KEYWORDS) {
+                sink_puts(out, keywords[k].name);
+            } else {
+                return -1;  // not written by the generator
+            }
+            if (i < length && (c >= 0x80 || data[i] >= 0x80) && lists_as_word(c) && lists_as_word(data[i])) {
+                sink_putc(out, ' ');  // the next token would run into this one
+            }
+        }
+        if (i >= length) {
+            return -1;
+        }
+        sink_putc(out, '\n');
+        i++;
+    }
+}
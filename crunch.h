@@ -0,0 +1,44 @@
+/*
+ * crunch.h - Tokenized GW-BASIC program files (--tokenize and --list).
+ *
+ * Author: Philip R. Simonson
+ * Date: 10/17/2026
+ *
+ */
+
+#include <stddef.h>
+
+// First byte of a tokenized program file, and the byte after its last line
+#define CRUNCH_HEADER 0xff
+#define CRUNCH_EOF 0x1a
+
+// Offset of the program text in GW-BASIC's segment the line links are
+// written for (it relinks the lines as it loads them anyway)
+#define CRUNCH_TEXT_BASE 0x126a
+
+// Last address a link can hold
+#define CRUNCH_TEXT_END 0xffff
+
+// Cruncher Structure (takes the line-numbered text the generator writes,
+// as a Sink callback, and writes each line tokenized once it is complete)
+typedef struct {
+    struct Sink *out;
+    const struct Js2basAllocator *allocator;
+    int error;              // ENOMEM once an allocation failed, EFBIG
+                            // once the program outgrew the segment,
+                            // EINVAL for a line without a number
+    int started;            // the header is written
+    unsigned address;       // of the next line, for the links
+    char *line;             // text of the line being received
+    size_t length;
+    size_t capacity;
+    unsigned char *record;  // the line tokenized
+    size_t record_length;
+    size_t record_capacity;
+} Cruncher;
+
+void cruncher_init(Cruncher *cruncher, struct Sink *out, const struct Js2basAllocator *allocator);
+int crunch_write(void *user, const char *data, size_t length);
+int cruncher_finish(Cruncher *cruncher);
+void cruncher_free(Cruncher *cruncher);
+int detokenize(const unsigned char *data, size_t length, struct Sink *out);
@@ -0,0 +1,427 @@
+/*
+ * dce.c - Dead code elimination of statements and variables (-O).
+ *
+ * Author: Philip R. Simonson
+ * Date: 10/17/2026
+ *
+ * Statements after exit in the same block are dropped, an if whose
+ * condition is a numeric constant is replaced by the branch that runs,
+ * while (0) goes away and while (1) ends its block like exit does.
+ * Variables that are declared but never read are removed with every
+ * assignment to them; expressions have no side effects, so that is
+ * safe. Which variables are read is only known after a scan of the whole
+ * program (dce_begin_scan()), without one every variable is kept.
+ *
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include "js2bas.h"
+#include "arena.h"
+#include "sink.h"
+#include "symbols.h"
+#include "token.h"
+#include "parse.h"
+#include "dce.h"
+
+// Initialize a dead code eliminator reporting removals to report
+void dce_init(Dce *dce, const struct Js2basAllocator *allocator, Sink *report) {
+    memset(dce, 0, sizeof(Dce));
+    dce->allocator = allocator;
+    dce->report = report;
+}
+
+// Free the tables and scratch stacks
+void dce_free(Dce *dce) {
+    allocator_free(dce->allocator, dce->variables);
+    allocator_free(dce->allocator, dce->items);
+    allocator_free(dce->allocator, dce->blocks);
+    allocator_free(dce->allocator, dce->results);
+    allocator_free(dce->allocator, dce->statements);
+    memset(dce, 0, sizeof(Dce));
+}
+
+// Start a scan: statements are pruned the same way, but only to find
+// which variables the program reads
+void dce_begin_scan(Dce *dce) {
+    dce->scanning = 1;
+}
+
+// End a scan, which is only trusted when it saw the whole program
+void dce_end_scan(Dce *dce, int complete) {
+    dce->scanning = 0;
+    dce->scanned = complete && dce->error == 0;
+    dce->ended = 0;
+    dce->unreachable = 0;
+}
+
+// Whether removals are reported
+static int reporting(const Dce *dce) {
+    return dce->report != NULL && !dce->scanning;
+}
+
+// Grow a scratch stack to hold needed elements, NULL when out of memory
+static void *grow(Dce *dce, void *array, size_t *capacity, size_t needed, size_t size) {
+    size_t count = *capacity ? *capacity : 64;
+    void *tmp;
+
+    if (needed <= *capacity) {
+        return array;
+    }
+    while (count < needed) {
+        count *= 2;
+    }
+    if ((tmp = allocator_resize(dce->allocator, array, size * count)) == NULL) {
+        dce->error = ENOMEM;
+        return NULL;
+    }
+    *capacity = count;
+    return tmp;
+}
+
+// What is known about the variable of an identifier node, NULL when out
+// of memory
+static DceVariable *variable(Dce *dce, const Ast *ast, AstIndex node) {
+    uint32_t id = ast->first[node];
+    size_t capacity = dce->variables_capacity;
+    DceVariable *tmp;
+
+    if (id >= capacity) {
+        if ((tmp = grow(dce, dce->variables, &dce->variables_capacity, (size_t)id + 1, sizeof(DceVariable))) == NULL) {
+            return NULL;
+        }
+        memset(tmp + capacity, 0, sizeof(DceVariable) * (dce->variables_capacity - capacity));
+        dce->variables = tmp;
+    }
+    return &dce->variables[id];
+}
+
+// Mark the variables of an expression as read (the scratch stack of
+// statements is free above top while a statement is looked at)
+static void read_expression(Dce *dce, const Ast *ast, AstIndex node, size_t top) {
+    size_t mark = top;
+    AstIndex *tmp;
+
+    if (node == AST_NONE) {
+        return;
+    }
+    if ((tmp = grow(dce, dce->statements, &dce->statements_capacity, top + 1, sizeof(AstIndex))) == NULL) {
+        return;
+    }
+    dce->statements = tmp;
+    dce->statements[top++] = node;
+    while (top > mark) {
+        DceVariable *slot;
+
+        node = dce->statements[--top];
+        if (ast->type[node] == AST_IDENTIFIER) {
+            if ((slot = variable(dce, ast, node)) == NULL) {
+                return;
+            }
+            slot->read = 1;
+        } else if (ast->type[node] == AST_BINARY_OP) {
+            if ((tmp = grow(dce, dce->statements, &dce->statements_capacity, top + 2, sizeof(AstIndex))) == NULL) {
+                return;
+            }
+            dce->statements = tmp;
+            dce->statements[top++] = ast->second[node];
+            dce->statements[top++] = ast->first[node];
+        }
+    }
+}
+
+// Record what a kept statement declares and reads
+static void read_statement(Dce *dce, const Ast *ast, AstIndex node, size_t top) {
+    AstIndex target = ast->first[node];
+    DceVariable *slot;
+
+    switch ((ASTNodeType)ast->type[node]) {
+        case AST_ASSIGN:
+            if (target != AST_NONE && ast->type[target] == AST_IDENTIFIER) {
+                if ((slot = variable(dce, ast, target)) != NULL) {
+                    slot->declared = 1;
+                }
+            }
+            read_expression(dce, ast, ast->second[node], top);
+            break;
+        case AST_EQUALS:
+            if (target != AST_NONE && ast->type[target] != AST_IDENTIFIER) {
+                read_expression(dce, ast, target, top);
+            }
+            read_expression(dce, ast, ast->second[node], top);
+            break;
+        case AST_INPUT:
+            // Input into a variable keeps it, the user sees the prompt
+            read_expression(dce, ast, ast->second[node], top);
+            break;
+        case AST_PRINT:
+        case AST_IF:
+        case AST_WHILE:
+            read_expression(dce, ast, ast->first[node], top);
+            break;
+        default:
+            break;
+    }
+}
+
+// Variable a declaration or assignment stores into, when it is never read
+static const Symbol *unused_target(const Dce *dce, const Ast *ast, AstIndex node) {
+    AstIndex target = ast->first[node];
+    uint32_t id;
+
+    if (!dce->scanned || target == AST_NONE || ast->type[target] != AST_IDENTIFIER) {
+        return NULL;
+    }
+    id = ast->first[target];
+    if (id >= dce->variables_capacity || !dce->variables[id].declared || dce->variables[id].read) {
+        return NULL;
+    }
+    return ast_symbol(ast, target);
+}
+
+// Whether an assignment stores a variable into itself, as x = x * 1 + 0
+// does once simplified
+static int self_assignment(const Ast *ast, AstIndex node) {
+    AstIndex target = ast->first[node], value = ast->second[node];
+
+    return ast->type[node] == AST_EQUALS && target != AST_NONE && value != AST_NONE
+        && ast->type[target] == AST_IDENTIFIER && ast->type[value] == AST_IDENTIFIER
+        && ast->first[target] == ast->first[value];
+}
+
+// Value of a condition: 1 for a nonzero numeric constant, 0 for zero and
+// -1 when it is not a constant
+static int condition_value(const Ast *ast, AstIndex node) {
+    const char *text;
+    uint32_t length, i = 0;
+    int nonzero = 0;
+
+    if (node == AST_NONE || ast->type[node] != AST_NUMBER) {
+        return -1;
+    }
+    text = ast_leaf_text(ast, node);
+    length = ast_leaf_length(ast, node);
+    if (i < length && text[i] == '-') {
+        i++;
+    }
+    if (i == length) {
+        return -1;
+    }
+    for (; i < length && isdigit((unsigned char)text[i]); ++i) {
+        nonzero |= text[i] != '0';
+    }
+    if (i < length && (text[i] == '!' || text[i] == '&' || text[i] == '#')) {
+        i++;
+    }
+    return i == length ? nonzero : -1;
+}
+
+// Push a work item, growing the stack as needed (dce->error is set when
+// out of memory)
+static void push_item(Dce *dce, size_t *items, AstIndex node, AstIndex range, int what) {
+    void *tmp;
+
+    if ((tmp = grow(dce, dce->items, &dce->items_capacity, *items + 1, sizeof(DceItem))) == NULL) {
+        return;
+    }
+    dce->items = tmp;
+    dce->items[(*items)++] = (DceItem){ node, range, what };
+}
+
+// Push the statements of a block as work items, last to first
+static void push_block(Dce *dce, size_t *items, const Ast *ast, AstIndex range) {
+    const AstRange *block = &ast->ranges[range];
+
+    for (uint32_t i = block->count; i > 0; --i) {
+        push_item(dce, items, ast->children[block->start + i - 1], AST_NONE, DCE_STATEMENT);
+    }
+}
+
+// Look at one statement of the innermost open block: keep it, drop it
+// or push what is left to do of it
+static int dce_visit(Dce *dce, Ast *ast, AstIndex node, unsigned line, size_t *items, size_t blocks, size_t *top) {
+    DceBlock *block = &dce->blocks[blocks - 1];
+    ASTNodeType type = (ASTNodeType)ast->type[node];
+    const Symbol *unused;
+    AstIndex range = ast->second[node];
+    int value;
+    void *tmp;
+
+    if (block->ends) {
+        block->skipped++;
+        return 0;
+    }
+
+    if ((type == AST_ASSIGN || type == AST_EQUALS) && (unused = unused_target(dce, ast, node)) != NULL) {
+        if (reporting(dce)) {
+            sink_printf(dce->report, "Line %u: removed %s unused variable '%.*s'.\n", line,
+                type == AST_ASSIGN ? "DIM of" : "assignment to", (int)unused->length, unused->name);
+        }
+        return 0;
+    }
+
+    if (self_assignment(ast, node)) {
+        if (reporting(dce)) {
+            const Symbol *symbol = ast_symbol(ast, ast->first[node]);
+            sink_printf(dce->report, "Line %u: removed assignment of '%.*s' to itself.\n", line,
+                (int)symbol->length, symbol->name);
+        }
+        return 0;
+    }
+
+    value = type == AST_IF || type == AST_WHILE ? condition_value(ast, ast->first[node]) : -1;
+
+    if (type == AST_IF && value >= 0) {
+        // The branch that runs takes the place of the if
+        AstIndex live = value ? range : range + 1;
+        if (reporting(dce)) {
+            if (value || ast->ranges[live].count > 0) {
+                sink_printf(dce->report, "Line %u: replaced IF with a constant condition by its %s branch.\n",
+                    line, value ? "THEN" : "ELSE");
+            } else {
+                sink_printf(dce->report, "Line %u: removed IF with a false condition.\n", line);
+            }
+        }
+        push_block(dce, items, ast, live);
+        return dce->error != 0 ? -1 : 0;
+    }
+    if (type == AST_WHILE && value == 0) {
+        if (reporting(dce)) {
+            sink_printf(dce->report, "Line %u: removed WHILE with a false condition.\n", line);
+        }
+        return 0;
+    }
+
+    if ((tmp = grow(dce, dce->statements, &dce->statements_capacity, *top + 1, sizeof(AstIndex))) == NULL) {
+        return -1;
+    }
+    dce->statements = tmp;
+    dce->statements[(*top)++] = node;
+    if (dce->scanning) {
+        read_statement(dce, ast, node, *top);
+    }
+
+    if (type == AST_EXIT) {
+        block->ends = 1;
+    } else if (type == AST_IF) {
+        push_item(dce, items, node, AST_NONE, DCE_DONE);
+        push_item(dce, items, node, range + 1, DCE_CLOSE);
+        push_block(dce, items, ast, range + 1);
+        push_item(dce, items, node, range + 1, DCE_OPEN);
+        push_item(dce, items, node, range, DCE_CLOSE);
+        push_block(dce, items, ast, range);
+        push_item(dce, items, node, range, DCE_OPEN);
+    } else if (type == AST_WHILE) {
+        push_item(dce, items, node, AST_NONE, DCE_DONE);
+        push_item(dce, items, node, range, DCE_CLOSE);
+        push_block(dce, items, ast, range);
+        push_item(dce, items, node, range, DCE_OPEN);
+    }
+    return dce->error != 0 ? -1 : 0;
+}
+
+// Remove dead code from a statement (line is where it starts, for the
+// report); live gets the statements left in its place, which may be none
+// or several. Returns -1 when out of memory.
+int dce_statement(Dce *dce, Ast *ast, AstIndex root, unsigned line, AstRange *live) {
+    size_t items = 0, blocks = 0, results = 0, top = 0;
+    AstIndex result, range;
+    void *tmp;
+
+    *live = (AstRange){ 0, 0 };
+    if (dce->ended) {
+        dce->unreachable++;
+        return 0;
+    }
+    if ((result = ast_ranges(ast, 1)) == AST_NONE) {
+        dce->error = ENOMEM;
+        return -1;
+    }
+    push_item(dce, &items, root, result, DCE_CLOSE);
+    push_item(dce, &items, root, AST_NONE, DCE_STATEMENT);
+    push_item(dce, &items, root, result, DCE_OPEN);
+
+    while (items > 0 && dce->error == 0) {
+        DceItem item = dce->items[--items];
+        DceBlock block;
+        int then_ends, else_ends;
+
+        switch (item.what) {
+            case DCE_OPEN:
+                if ((tmp = grow(dce, dce->blocks, &dce->blocks_capacity, blocks + 1, sizeof(DceBlock))) == NULL) {
+                    break;
+                }
+                dce->blocks = tmp;
+                dce->blocks[blocks++] = (DceBlock){ item.range, top, 0, 0 };
+                break;
+            case DCE_CLOSE:
+                block = dce->blocks[--blocks];
+                if (block.skipped > 0 && reporting(dce)) {
+                    sink_printf(dce->report, "Line %u: removed %zu unreachable statement%s.\n",
+                        line, block.skipped, block.skipped == 1 ? "" : "s");
+                }
+                if (ast_children(ast, block.range, dce->statements + block.mark, (uint32_t)(top - block.mark)) < 0) {
+                    dce->error = ENOMEM;
+                    break;
+                }
+                top = block.mark;
+                if (blocks == 0) {
+                    if (block.ends) {
+                        dce->ended = 1;
+                        dce->ended_line = line;
+                    }
+                    break;
+                }
+                if ((tmp = grow(dce, dce->results, &dce->results_capacity, results + 1, sizeof(int))) == NULL) {
+                    break;
+                }
+                dce->results = tmp;
+                dce->results[results++] = block.ends;
+                break;
+            case DCE_DONE:
+                if (ast->type[item.node] == AST_WHILE) {
+                    // Only exit leaves while (1), and then nothing runs after it
+                    results--;
+                    if (condition_value(ast, ast->first[item.node]) > 0) {
+                        dce->blocks[blocks - 1].ends = 1;
+                    }
+                    break;
+                }
+                else_ends = dce->results[--results];
+                then_ends = dce->results[--results];
+                range = ast->second[item.node];
+                if (ast->ranges[range].count == 0 && ast->ranges[range + 1].count == 0) {
+                    top--;  // the if is still the last statement kept
+                    if (reporting(dce)) {
+                        sink_printf(dce->report, "Line %u: removed IF without statements.\n", line);
+                    }
+                } else if (then_ends && else_ends) {
+                    dce->blocks[blocks - 1].ends = 1;
+                }
+                break;
+            default:
+                if (dce_visit(dce, ast, item.node, line, &items, blocks, &top) < 0) {
+                    dce->error = ENOMEM;
+                }
+                break;
+        }
+    }
+    if (dce->error != 0) {
+        return -1;
+    }
+    *live = ast->ranges[result];
+    return 0;
+}
+
+// Report the statements that never run because the program ended before
+void dce_finish(Dce *dce) {
+    if (dce->unreachable > 0 && reporting(dce)) {
+        sink_printf(dce->report, "Line %u: removed %zu unreachable statement%s after the end of the program.\n",
+            dce->ended_line, dce->unreachable, dce->unreachable == 1 ? "" : "s");
+    }
+}
@@ -0,0 +1,65 @@
+/*
+ * dce.h - Dead code elimination of statements and variables (-O).
+ *
+ * Author: Philip R. Simonson
+ * Date: 10/17/2026
+ *
+ */
+
+#include <stddef.h>
+
+// Work items of dce_statement()
+#define DCE_STATEMENT 0     // keep, drop or unfold a statement
+#define DCE_OPEN 1          // start collecting the live statements of a block
+#define DCE_CLOSE 2         // store them as the block
+#define DCE_DONE 3          // both blocks of an if, or the body of a while, are done
+
+// Variable Structure (by symbol id, declared or read somewhere in the program)
+typedef struct {
+    int declared;
+    int read;           // read, or input into
+} DceVariable;
+
+// Work Item Structure (what is left to do of a statement)
+typedef struct {
+    AstIndex node;
+    AstIndex range;     // of DCE_OPEN and DCE_CLOSE
+    int what;
+} DceItem;
+
+// Block Structure (a block whose live statements are being collected)
+typedef struct {
+    AstIndex range;     // where they go when the block is closed
+    size_t mark;        // they are on the scratch stack above this
+    int ends;           // a statement of it never finishes
+    size_t skipped;     // statements after that one
+} DceBlock;
+
+// Dead Code Eliminator Structure (lives as long as the translation)
+typedef struct {
+    const struct Js2basAllocator *allocator;
+    struct Sink *report;            // what was removed, NULL to stay quiet
+    int error;                      // ENOMEM once an allocation failed
+    int scanning;                   // collecting reads, nothing is reported
+    int scanned;                    // reads of the whole program are known
+    DceVariable *variables;         // by symbol id
+    size_t variables_capacity;
+    int ended;                      // the program never gets past a statement
+    unsigned ended_line;
+    size_t unreachable;             // top-level statements after it
+    DceItem *items;                 // scratch stacks of dce_statement()
+    size_t items_capacity;
+    DceBlock *blocks;
+    size_t blocks_capacity;
+    int *results;                   // whether closed blocks end
+    size_t results_capacity;
+    AstIndex *statements;           // live statements of the open blocks
+    size_t statements_capacity;
+} Dce;
+
+void dce_init(Dce *dce, const struct Js2basAllocator *allocator, struct Sink *report);
+void dce_free(Dce *dce);
+void dce_begin_scan(Dce *dce);
+void dce_end_scan(Dce *dce, int complete);
+int dce_statement(Dce *dce, Ast *ast, AstIndex root, unsigned line, AstRange *live);
+void dce_finish(Dce *dce);
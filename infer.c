@@ -0,0 +1,381 @@
+/*
+ * infer.c - Type inference of variables over the whole program.
+ *
+ * Author: Philip R. Simonson
+ * Date: 10/17/2026
+ *
+ * Every statement adds what it says about its variables: a literal gives
+ * at least its own type, an assignment from another variable an edge
+ * saying the target is at least as wide, and an operand of '-', '*' or
+ * '/' is a number. Types only ever widen
+ * (INTEGER, LONG, SINGLE, DOUBLE), so following the edges until nothing
+ * changes ends. A variable that keeps growing in a loop from other
+ * variables or by multiplying is made LONG at least, since INTEGER
+ * overflows at 32767. Strings and numbers never mix: the first type seen
+ * is kept and the conflict reported.
+ *
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include "js2bas.h"
+#include "arena.h"
+#include "sink.h"
+#include "symbols.h"
+#include "token.h"
+#include "parse.h"
+#include "optimize.h"
+#include "infer.h"
+
+// Flags of a work item
+#define INFER_NUMERIC 1     // operand that has to be a number
+#define INFER_COMPARED 2    // under a comparison, its type goes nowhere
+
+// Largest values of the integer types
+#define INTEGER_MAX 32767
+#define LONG_MAX_VALUE 2147483647
+
+// Names of the types, for reports
+static const char *kind_names[] = { "UNKNOWN", "INTEGER", "LONG", "SINGLE", "DOUBLE", "STRING" };
+
+// Initialize a type inferrer of the symbols in symbols reporting
+// conflicts to report
+void infer_init(Infer *infer, const struct Js2basAllocator *allocator, SymbolTable *symbols, Sink *report) {
+    memset(infer, 0, sizeof(Infer));
+    infer->allocator = allocator;
+    infer->symbols = symbols;
+    infer->report = report;
+}
+
+// Free the variables, tables and scratch stack
+void infer_free(Infer *infer) {
+    allocator_free(infer->allocator, infer->variables);
+    allocator_free(infer->allocator, infer->edges);
+    allocator_free(infer->allocator, infer->items);
+    memset(infer, 0, sizeof(Infer));
+}
+
+// Id of the variable of an identifier node, counting the use in loops
+// enclosing loops; returns SYMBOL_NONE when out of memory
+static uint32_t variable_id(Infer *infer, const Ast *ast, AstIndex node, int write, unsigned loops) {
+    uint32_t id = ast->first[node];
+
+    if (id >= infer->capacity) {
+        uint32_t capacity = infer->capacity ? infer->capacity : 64;
+        InferVariable *tmp;
+
+        while (capacity <= id) {
+            capacity *= 2;
+        }
+        if ((tmp = allocator_resize(infer->allocator, infer->variables, sizeof(InferVariable) * capacity)) == NULL) {
+            infer->error = ENOMEM;
+            return SYMBOL_NONE;
+        }
+        memset(tmp + infer->capacity, 0, sizeof(InferVariable) * (capacity - infer->capacity));
+        infer->variables = tmp;
+        infer->capacity = capacity;
+    }
+    symbol_use(&infer->symbols->symbols[id], write, loops);
+    return id;
+}
+
+// Widen a variable to at least kind, returns 1 when it changed. A string
+// meeting a number keeps the type seen first and is reported once.
+static int widen(Infer *infer, uint32_t id, ValueKind kind, unsigned line) {
+    InferVariable *variable = &infer->variables[id];
+    Symbol *symbol = &infer->symbols->symbols[id];
+
+    if (kind == KIND_UNKNOWN || kind == symbol->kind) {
+        return 0;
+    }
+    if (symbol->kind != KIND_UNKNOWN && (symbol->kind == KIND_STRING) != (kind == KIND_STRING)) {
+        if (!variable->conflict && infer->report != NULL) {
+            sink_printf(infer->report, "Line %u: variable '%.*s' is used as a number and a string, keeping %s.\n",
+                line, (int)symbol->length, symbol->name, kind_names[symbol->kind]);
+        }
+        variable->conflict = 1;
+        return 0;
+    }
+    if (kind < symbol->kind) {
+        return 0;
+    }
+    symbol->kind = kind;
+    return 1;
+}
+
+// Add an edge (target at least as wide as source), once per pair
+static void add_edge(Infer *infer, uint32_t target, uint32_t source, unsigned line) {
+    size_t i;
+
+    if (target == source) {
+        return;
+    }
+    if (infer->edges_count * 2 >= infer->edges_size) {
+        size_t size = infer->edges_size ? infer->edges_size * 2 : 256;
+        InferEdge *old = infer->edges, *edges;
+        size_t old_size = infer->edges_size;
+
+        if ((edges = allocator_alloc(infer->allocator, sizeof(InferEdge) * size)) == NULL) {
+            infer->error = ENOMEM;
+            return;
+        }
+        for (i = 0; i < size; ++i) {
+            edges[i].target = UINT32_MAX;
+        }
+        infer->edges = edges;
+        infer->edges_size = size;
+        infer->edges_count = 0;
+        for (size_t j = 0; j < old_size; ++j) {
+            if (old[j].target != UINT32_MAX) {
+                add_edge(infer, old[j].target, old[j].source, old[j].line);
+            }
+        }
+        allocator_free(infer->allocator, old);
+    }
+
+    i = (((size_t)target * 0x9e3779b1u) ^ source) & (infer->edges_size - 1);
+    while (infer->edges[i].target != UINT32_MAX) {
+        if (infer->edges[i].target == target && infer->edges[i].source == source) {
+            return;
+        }
+        i = (i + 1) & (infer->edges_size - 1);
+    }
+    infer->edges[i] = (InferEdge){ target, source, line };
+    infer->edges_count++;
+}
+
+// Type of a number literal: digits with an optional '-' and type suffix
+static ValueKind literal_kind(const Ast *ast, AstIndex node) {
+    const char *text = ast_leaf_text(ast, node);
+    uint32_t length = ast_leaf_length(ast, node), i = 0;
+    int64_t value = 0;
+
+    if (i < length && text[i] == '-') {
+        i++;
+    }
+    for (; i < length && isdigit((unsigned char)text[i]); ++i) {
+        if (value <= LONG_MAX_VALUE) {
+            value = value * 10 + (text[i] - '0');
+        }
+    }
+    if (i < length) {
+        switch (text[i]) {
+            case '%': return KIND_INTEGER;
+            case '&': return KIND_LONG;
+            case '!': return KIND_SINGLE;
+            case '#': return KIND_DOUBLE;
+            default: return KIND_SINGLE;
+        }
+    }
+    return value <= INTEGER_MAX ? KIND_INTEGER : value <= LONG_MAX_VALUE ? KIND_LONG : KIND_DOUBLE;
+}
+
+// Make room for needed more work items
+static int reserve_items(Infer *infer, size_t top, size_t needed) {
+    size_t capacity = infer->items_capacity ? infer->items_capacity : 64;
+    InferItem *tmp;
+
+    if (top + needed <= infer->items_capacity) {
+        return 0;
+    }
+    while (capacity < top + needed) {
+        capacity *= 2;
+    }
+    if ((tmp = allocator_resize(infer->allocator, infer->items, sizeof(InferItem) * capacity)) == NULL) {
+        infer->error = ENOMEM;
+        return -1;
+    }
+    infer->items = tmp;
+    infer->items_capacity = capacity;
+    return 0;
+}
+
+// Walk an expression assigned to target (UINT32_MAX for none) on the
+// scratch stack above top: returns the type its literals and operators
+// give, adds edges from the variables it copies and marks its operands
+// that have to be numbers
+static ValueKind expression(Infer *infer, const Ast *ast, AstIndex root, uint32_t target, unsigned loops,
+        unsigned line, size_t top) {
+    ValueKind kind = KIND_UNKNOWN, leaf;
+    size_t mark = top;
+    int self = 0, others = 0, multiplies = 0;
+
+    if (root == AST_NONE || reserve_items(infer, top, 1) < 0) {
+        return KIND_UNKNOWN;
+    }
+    infer->items[top++] = (InferItem){ root, 0, 0 };
+    while (top > mark && infer->error == 0) {
+        InferItem item = infer->items[--top];
+        AstIndex node = item.node;
+        int flags = item.flags & INFER_COMPARED;
+        uint32_t id;
+
+        leaf = KIND_UNKNOWN;
+        switch ((ASTNodeType)ast->type[node]) {
+            case AST_NUMBER:
+                leaf = literal_kind(ast, node);
+                break;
+            case AST_STRING:
+                leaf = KIND_STRING;
+                break;
+            case AST_IDENTIFIER:
+                if ((id = variable_id(infer, ast, node, 0, loops)) == SYMBOL_NONE) {
+                    break;
+                }
+                if (item.flags & INFER_NUMERIC) {
+                    widen(infer, id, KIND_INTEGER, line);
+                }
+                if (target != UINT32_MAX && !(item.flags & INFER_COMPARED)) {
+                    add_edge(infer, target, id, line);
+                    self |= id == target;
+                    others |= id != target;
+                }
+                break;
+            case AST_BINARY_OP:
+                if (reserve_items(infer, top, 2) < 0) {
+                    break;
+                }
+                switch (ast->op[node]) {
+                    case '<': case '>': case '=':
+                        leaf = KIND_INTEGER;  // -1 or 0
+                        flags = INFER_COMPARED;
+                        break;
+                    case '/':
+                        leaf = KIND_SINGLE;
+                        flags |= INFER_NUMERIC;
+                        break;
+                    case '*':
+                        multiplies = 1;
+                        flags |= INFER_NUMERIC;
+                        break;
+                    case '-':
+                        flags |= INFER_NUMERIC;
+                        break;
+                    case '+':
+                        flags |= item.flags & INFER_NUMERIC;
+                        break;
+                    default:
+                        break;  // ',' between PRINT items
+                }
+                infer->items[top++] = (InferItem){ ast->second[node], flags, 0 };
+                infer->items[top++] = (InferItem){ ast->first[node], flags, 0 };
+                break;
+            default:
+                break;
+        }
+        if (!(item.flags & INFER_COMPARED) && leaf != KIND_UNKNOWN) {
+            kind = kind == KIND_STRING || leaf == KIND_STRING ? KIND_STRING : leaf > kind ? leaf : kind;
+        }
+    }
+    if (loops > 0 && self && (others || multiplies) && target != UINT32_MAX) {
+        infer->variables[target].accumulates = 1;
+    }
+    return kind;
+}
+
+// Add what one top-level statement says about its variables (line is
+// where it starts, for reports); returns -1 when out of memory
+int infer_statement(Infer *infer, const Ast *ast, AstIndex root, unsigned line) {
+    size_t top = 0;
+
+    if (root == AST_NONE || reserve_items(infer, 0, 1) < 0) {
+        return infer->error != 0 ? -1 : 0;
+    }
+    infer->items[top++] = (InferItem){ root, 0, 0 };
+    while (top > 0 && infer->error == 0) {
+        InferItem item = infer->items[--top];
+        AstIndex node = item.node, target = ast->first[node];
+        unsigned loops = item.loops;
+        const AstRange *blocks = NULL;
+        int count = 0;
+        uint32_t id;
+        ValueKind kind;
+
+        switch ((ASTNodeType)ast->type[node]) {
+            case AST_ASSIGN:
+            case AST_EQUALS:
+                if (target == AST_NONE || ast->type[target] != AST_IDENTIFIER) {
+                    expression(infer, ast, ast->second[node], UINT32_MAX, loops, line, top);
+                    break;
+                }
+                if ((id = variable_id(infer, ast, target, 1, loops)) == SYMBOL_NONE) {
+                    break;
+                }
+                if (ast->type[node] == AST_ASSIGN && infer->symbols->symbols[id].declared == 0) {
+                    infer->symbols->symbols[id].declared = line;
+                }
+                kind = expression(infer, ast, ast->second[node], id, loops, line, top);
+                widen(infer, id, kind, line);
+                break;
+            case AST_INPUT:
+                if (ast->second[node] != AST_NONE && ast->type[ast->second[node]] == AST_IDENTIFIER
+                        && (id = variable_id(infer, ast, ast->second[node], 1, loops)) != SYMBOL_NONE) {
+                    infer->variables[id].input = 1;
+                }
+                break;
+            case AST_PRINT:
+                expression(infer, ast, ast->first[node], UINT32_MAX, loops, line, top);
+                break;
+            case AST_IF:
+                expression(infer, ast, ast->first[node], UINT32_MAX, loops, line, top);
+                blocks = &ast->ranges[ast->second[node]];
+                count = 2;
+                break;
+            case AST_WHILE:
+                loops++;  // the test runs as often as the body
+                expression(infer, ast, ast->first[node], UINT32_MAX, loops, line, top);
+                blocks = &ast->ranges[ast->second[node]];
+                count = 1;
+                break;
+            default:
+                break;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            if (reserve_items(infer, top, blocks[i].count) < 0) {
+                break;
+            }
+            for (uint32_t j = 0; j < blocks[i].count; ++j) {
+                infer->items[top++] = (InferItem){ ast->children[blocks[i].start + j], 0, loops };
+            }
+        }
+    }
+    return infer->error != 0 ? -1 : 0;
+}
+
+// Follow the edges until no type changes
+static void propagate(Infer *infer) {
+    int changed = 1;
+
+    while (changed) {
+        changed = 0;
+        for (size_t i = 0; i < infer->edges_size; ++i) {
+            const InferEdge *edge = &infer->edges[i];
+            if (edge->target != UINT32_MAX) {
+                changed |= widen(infer, edge->target, infer->symbols->symbols[edge->source].kind, edge->line);
+            }
+        }
+    }
+}
+
+// Settle the type of every variable once all statements are in
+int infer_finish(Infer *infer) {
+    propagate(infer);
+    for (uint32_t id = 0; id < infer->capacity && id < infer->symbols->count; ++id) {
+        const InferVariable *variable = &infer->variables[id];
+        Symbol *symbol = &infer->symbols->symbols[id];
+
+        if (variable->accumulates && symbol->kind != KIND_STRING && symbol->kind < KIND_LONG) {
+            symbol->kind = KIND_LONG;
+        } else if (variable->input && symbol->kind == KIND_UNKNOWN) {
+            symbol->kind = KIND_STRING;
+        }
+    }
+    propagate(infer);
+    return infer->error != 0 ? -1 : 0;
+}
@@ -0,0 +1,51 @@
+/*
+ * infer.h - Type inference of variables over the whole program.
+ *
+ * Author: Philip R. Simonson
+ * Date: 10/17/2026
+ *
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Inferred Variable Structure (by symbol id, the type goes in the symbol)
+typedef struct {
+    int input;          // gets input(), a string unless used as a number
+    int accumulates;    // grows in a loop, x = x + y or x = x * 2
+    int conflict;       // used as a number and a string, reported once
+} InferVariable;
+
+// Inference Edge Structure (target gets at least the type of source)
+typedef struct {
+    uint32_t target;
+    uint32_t source;
+    unsigned line;
+} InferEdge;
+
+// Work Item Structure (a statement or part of an expression still to do)
+typedef struct {
+    AstIndex node;
+    int flags;          // INFER_NUMERIC, INFER_COMPARED
+    unsigned loops;     // loops around a statement
+} InferItem;
+
+// Type Inferrer Structure (lives as long as the translation)
+typedef struct {
+    const struct Js2basAllocator *allocator;
+    SymbolTable *symbols;           // gets the types, reads and writes
+    struct Sink *report;            // type conflicts, NULL to stay quiet
+    int error;                      // ENOMEM once an allocation failed
+    InferVariable *variables;       // by symbol id
+    uint32_t capacity;
+    InferEdge *edges;               // by (target, source), open addressing
+    size_t edges_size;
+    size_t edges_count;
+    InferItem *items;               // scratch stack of infer_statement()
+    size_t items_capacity;
+} Infer;
+
+void infer_init(Infer *infer, const struct Js2basAllocator *allocator, SymbolTable *symbols, struct Sink *report);
+void infer_free(Infer *infer);
+int infer_statement(Infer *infer, const Ast *ast, AstIndex root, unsigned line);
+int infer_finish(Infer *infer);
@@ -0,0 +1,197 @@
+/*
+ * input.c - Source input for the tokenizer (memory mapped files and
+ *           incrementally read pipes).
+ *
+ * Author: Philip R. Simonson
+ * Date: 10/17/2026
+ *
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "js2bas.h"
+#include "arena.h"
+#include "sink.h"
+#include "input.h"
+
+// Open a file, retrying with a '.js' extension
+static int open_source(const char *filename) {
+    char name[512];
+    size_t length;
+    int fd;
+
+    if ((fd = open(filename, O_RDONLY)) >= 0) {
+        return fd;
+    }
+
+    length = strlen(filename);
+    if (length >= 3 && strcmp(filename + length - 3, ".js") == 0) {
+        return -1;
+    }
+    if (snprintf(name, sizeof(name), "%s.js", filename) >= (int)sizeof(name)) {
+        return -1;
+    }
+    return open(name, O_RDONLY);
+}
+
+// Open input, regular files are mapped and everything else is read in chunks
+int input_open(Input *in, const char *filename, Sink *diag) {
+    struct stat st;
+
+    memset(in, 0, sizeof(Input));
+    in->diag = diag;
+    if (filename == NULL || strcmp(filename, "-") == 0) {
+        in->fd = STDIN_FILENO;
+    } else if ((in->fd = open_source(filename)) < 0) {
+        in->error = errno;
+        sink_printf(diag, "Error: Cannot open file '%s'.\n", filename);
+        return -1;
+    }
+
+    if (fstat(in->fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        if (st.st_size == 0) {
+            in->eof = 1;
+            return 0;
+        }
+        if ((uint64_t)st.st_size > INPUT_WINDOW_MAX) {
+            // The whole file is one window, tokens could not tell 4 GB apart
+            sink_printf(diag, "Error: File '%s' is 4 GB or larger.\n", filename);
+            in->error = EFBIG;
+            close(in->fd);
+            in->fd = -1;
+            return -1;
+        }
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, in->fd, 0);
+        if (map != MAP_FAILED) {
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            in->mapped = 1;
+            in->eof = 1;
+            in->buffer = map;
+            in->length = in->capacity = st.st_size;
+            return 0;
+        }
+    }
+
+    return 0;
+}
+
+// Keep an old window alive until input_release()
+static int retire_window(Input *in) {
+    if (in->buffer == NULL) {
+        return 0;
+    }
+    if (in->retired_count == in->retired_capacity) {
+        size_t capacity = in->retired_capacity ? in->retired_capacity * 2 : 8;
+        char **tmp = allocator_resize(in->allocator, in->retired, sizeof(char*) * capacity);
+        if (tmp == NULL) {
+            return -1;
+        }
+        in->retired = tmp;
+        in->retired_capacity = capacity;
+    }
+    in->retired[in->retired_count++] = in->buffer;
+    return 0;
+}
+
+// Read the next chunk, data before offset 'keep' may be dropped
+size_t input_fill(Input *in, size_t keep) {
+    ssize_t nbytes;
+
+    if (in->eof) {
+        return 0;
+    }
+
+    if (in->capacity - in->length < INPUT_CHUNK) {
+        // Start a new window holding only the bytes still needed. The old
+        // one is not freed since AST nodes may point into it.
+        size_t drop = keep > in->base ? keep - in->base : 0;
+        size_t live = in->length - drop;
+        size_t capacity = INPUT_CHUNK * 4;
+        char *buffer;
+
+        if (live + INPUT_CHUNK > INPUT_WINDOW_MAX) {
+            sink_literal(in->diag, "Error: Input of 4 GB or larger cannot be kept at once.\n");
+            in->error = EFBIG;
+            in->eof = 1;
+            return 0;
+        }
+        while (capacity < live + INPUT_CHUNK) {
+            capacity *= 2;
+        }
+        if ((buffer = allocator_alloc(in->allocator, capacity)) == NULL || retire_window(in) < 0) {
+            sink_literal(in->diag, "Error: Out of memory.\n");
+            allocator_free(in->allocator, buffer);
+            in->error = ENOMEM;
+            in->eof = 1;
+            return 0;
+        }
+        if (live > 0) {
+            memcpy(buffer, in->buffer + drop, live);
+        }
+        in->buffer = buffer;
+        in->length = live;
+        in->capacity = capacity;
+        in->base += drop;
+    }
+
+    do {
+        nbytes = read(in->fd, in->buffer + in->length, in->capacity - in->length);
+    } while (nbytes < 0 && errno == EINTR);
+
+    if (nbytes <= 0) {
+        if (nbytes < 0) {
+            in->error = errno;
+            sink_printf(in->diag, "Error: Cannot read input: %s.\n", strerror(errno));
+        }
+        in->eof = 1;
+        return 0;
+    }
+
+    in->length += nbytes;
+    return nbytes;
+}
+
+// Read everything that is left into one window, returns -1 on error
+int input_read_all(Input *in) {
+    while (!in->eof) {
+        input_fill(in, in->base);
+        input_release(in);  // Nothing points into the old windows yet
+    }
+    return in->error ? -1 : 0;
+}
+
+// Free old windows once nothing points into them any more
+void input_release(Input *in) {
+    for (size_t i = 0; i < in->retired_count; ++i) {
+        allocator_free(in->allocator, in->retired[i]);
+    }
+    in->retired_count = 0;
+}
+
+// Close input and free all buffers
+void input_close(Input *in) {
+    input_release(in);
+    allocator_free(in->allocator, in->retired);
+    if (in->mapped) {
+        munmap(in->buffer, in->length);
+    } else {
+        allocator_free(in->allocator, in->buffer);
+    }
+    if (in->fd != STDIN_FILENO && in->fd >= 0) {
+        close(in->fd);
+    }
+    in->retired = NULL;
+    in->retired_count = in->retired_capacity = 0;
+    in->buffer = NULL;
+    in->length = in->capacity = 0;
+    in->fd = -1;
+}
+
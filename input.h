@@ -0,0 +1,41 @@
+/*
+ * input.h - Source input for the tokenizer (memory mapped files and
+ *           incrementally read pipes).
+ *
+ * Author: Philip R. Simonson
+ * Date: 10/17/2026
+ *
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Size of a single read from a pipe or terminal
+#define INPUT_CHUNK 65536
+
+// Largest window, token offsets are 32 bits relative to its start
+#define INPUT_WINDOW_MAX UINT32_MAX
+
+// Input Structure
+typedef struct Input {
+    int fd;
+    int mapped;         // buffer is a read-only mapping of the whole file
+    int eof;            // no more data will arrive
+    int error;          // errno of a failed read, 0 otherwise
+    struct Sink *diag;  // error messages
+    const struct Js2basAllocator *allocator;  // windows, NULL for malloc()
+    char *buffer;       // current window of the input
+    size_t length;      // valid bytes in buffer
+    size_t capacity;
+    size_t base;        // offset of buffer[0] in the whole input
+    char **retired;     // old windows still referenced by the AST
+    size_t retired_count;
+    size_t retired_capacity;
+} Input;
+
+int input_open(Input *in, const char *filename, struct Sink *diag);
+size_t input_fill(Input *in, size_t keep);
+int input_read_all(Input *in);
+void input_release(Input *in);
+void input_close(Input *in);
+
@@ -0,0 +1,212 @@
+/*
+ * js2bas.c - Public interface of libjs2bas, the JavaScript-like language
+ *            to BASIC translator.
+ *
+ * Author: Philip R. Simonson
+ * Date: 10/17/2026
+ *
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "js2bas.h"
+#include "arena.h"
+#include "input.h"
+#include "sink.h"
+#include "scan.h"
+#include "symbols.h"
+#include "token.h"
+#include "parse.h"
+#include "translate.h"
+#include "stats.h"
+
+// Context Structure (buffers are kept for the next translation)
+struct Js2basContext {
+    Js2basAllocator allocator;
+    Js2basAllocator counting;     // the allocator with counters, with stats
+    Js2basOptions options;
+    Js2basStats stats;
+    Arena arena;
+    Sink out;
+    Sink diag;
+    const Js2basSink *out_sink;   // of the translation in progress
+    const Js2basSink *diag_sink;
+};
+
+// Hand flushed output to the caller's sink
+static int write_out(void *user, const char *data, size_t length) {
+    Js2basContext *ctx = user;
+    return ctx->out_sink->write(ctx->out_sink->user, data, length);
+}
+
+// Hand diagnostics to the caller's sink, or drop them without one
+static int write_diag(void *user, const char *data, size_t length) {
+    Js2basContext *ctx = user;
+
+    if (ctx->diag_sink == NULL || ctx->diag_sink->write == NULL) {
+        return 0;
+    }
+    return ctx->diag_sink->write(ctx->diag_sink->user, data, length);
+}
+
+// Allocator hooks counting calls and bytes on the way to the real ones
+static void *count_alloc(void *user, size_t size) {
+    Js2basContext *ctx = user;
+
+    ctx->stats.allocations++;
+    ctx->stats.allocated_bytes += size;
+    return allocator_alloc(&ctx->allocator, size);
+}
+
+static void *count_resize(void *user, void *ptr, size_t size) {
+    Js2basContext *ctx = user;
+
+    ctx->stats.allocations++;
+    ctx->stats.allocated_bytes += size;
+    return allocator_resize(&ctx->allocator, ptr, size);
+}
+
+static void count_release(void *user, void *ptr) {
+    Js2basContext *ctx = user;
+
+    allocator_free(&ctx->allocator, ptr);
+}
+
+// Create a context, allocator and options may be NULL for the defaults
+Js2basContext *js2bas_create(const Js2basAllocator *allocator, const Js2basOptions *options) {
+    Js2basAllocator hooks = {0};
+    Js2basContext *ctx;
+
+    if (allocator != NULL) {
+        hooks = *allocator;
+    }
+    if ((ctx = allocator_alloc(&hooks, sizeof(Js2basContext))) == NULL) {
+        return NULL;
+    }
+    memset(ctx, 0, sizeof(Js2basContext));
+    ctx->allocator = hooks;
+    if (options != NULL) {
+        ctx->options = *options;
+    }
+    ctx->counting = ctx->allocator;
+    if (STATS_ENABLED(ctx) && ctx->options.stats) {
+        ctx->counting = (Js2basAllocator){ count_alloc, count_resize, count_release, ctx };
+    }
+
+    scan_init();
+    arena_init(&ctx->arena);
+    ctx->arena.allocator = &ctx->counting;
+    sink_init_callback(&ctx->out, write_out, ctx);
+    sink_init_callback(&ctx->diag, write_diag, ctx);
+    ctx->out.allocator = ctx->diag.allocator = &ctx->counting;
+    return ctx;
+}
+
+// Point the context sinks at the caller's sinks for one translation
+static void begin(Js2basContext *ctx, const Js2basSink *out, const Js2basSink *diag) {
+    ctx->out_sink = out;
+    ctx->diag_sink = diag;
+    ctx->out.batch = ctx->options.flush_size;
+    ctx->out.error = ctx->diag.error = 0;
+    memset(&ctx->stats, 0, sizeof(Js2basStats));
+}
+
+// Statistics to collect, NULL when they are not wanted
+static Js2basStats *collect(Js2basContext *ctx) {
+    return STATS_ENABLED(ctx) && ctx->options.stats ? &ctx->stats : NULL;
+}
+
+// Finish a translation, diagnostics are handed over at the end
+static int end(Js2basContext *ctx, int result) {
+    if (collect(ctx) != NULL) {
+        stats_finish(&ctx->stats);
+    }
+    sink_flush(&ctx->diag);
+    sink_reset(&ctx->out);
+    ctx->out_sink = ctx->diag_sink = NULL;
+    return result;
+}
+
+// Translate a source buffer, returns JS2BAS_OK or one of the errors
+int js2bas_translate(Js2basContext *ctx, const char *source, size_t length,
+        const Js2basSink *out, const Js2basSink *diag) {
+    if (ctx == NULL || out == NULL || out->write == NULL) {
+        return JS2BAS_ERROR_OUTPUT;
+    }
+    begin(ctx, out, diag);
+    if (length > INPUT_WINDOW_MAX) {
+        sink_literal(&ctx->diag, "Error: Source of 4 GB or larger cannot be translated.\n");
+        return end(ctx, JS2BAS_ERROR_INPUT);
+    }
+    return end(ctx, translate_buffer(source, length, &ctx->arena, &ctx->out, &ctx->diag, &ctx->options, collect(ctx)));
+}
+
+// Translate a file ('-' or NULL for standard input), regular files are
+// mapped and anything else is read while translating
+int js2bas_translate_file(Js2basContext *ctx, const char *filename,
+        const Js2basSink *out, const Js2basSink *diag) {
+    Js2basStats *stats;
+    double wall = 0, cpu = 0;
+    Input in;
+    int result;
+
+    if (ctx == NULL || out == NULL || out->write == NULL) {
+        return JS2BAS_ERROR_OUTPUT;
+    }
+    begin(ctx, out, diag);
+    if ((stats = collect(ctx)) != NULL) {
+        wall = stats_wall();
+        cpu = stats_cpu();
+    }
+    if (input_open(&in, filename, &ctx->diag) < 0) {
+        return end(ctx, JS2BAS_ERROR_INPUT);
+    }
+    in.allocator = &ctx->counting;
+    if (stats != NULL) {
+        stats->wall[JS2BAS_PHASE_LOAD] = stats_wall() - wall;
+        stats->cpu[JS2BAS_PHASE_LOAD] = stats_cpu() - cpu;
+    }
+    result = translate(&in, &ctx->arena, &ctx->out, &ctx->diag, &ctx->options, stats);
+    input_close(&in);
+    return end(ctx, result);
+}
+
+// Statistics of the last translation, NULL unless the context collects them
+const Js2basStats *js2bas_stats(const Js2basContext *ctx) {
+    if (ctx == NULL || !(STATS_ENABLED(ctx) && ctx->options.stats)) {
+        return NULL;
+    }
+    return &ctx->stats;
+}
+
+// Write statistics as a table or as JSON, returns JS2BAS_OK or an error
+int js2bas_stats_write(const Js2basStats *stats, int json, const Js2basSink *sink) {
+    Sink out;
+    int result;
+
+    if (stats == NULL || sink == NULL || sink->write == NULL) {
+        return JS2BAS_ERROR_OUTPUT;
+    }
+    sink_init_callback(&out, sink->write, sink->user);
+    stats_write(stats, json, &out);
+    result = sink_flush(&out) < 0 ? (out.error == ENOMEM ? JS2BAS_ERROR_MEMORY : JS2BAS_ERROR_OUTPUT) : JS2BAS_OK;
+    sink_free(&out);
+    return result;
+}
+
+// Free a context and everything it kept
+void js2bas_destroy(Js2basContext *ctx) {
+    Js2basAllocator allocator;
+
+    if (ctx == NULL) {
+        return;
+    }
+    allocator = ctx->allocator;
+    arena_free(&ctx->arena);
+    sink_free(&ctx->out);
+    sink_free(&ctx->diag);
+    allocator_free(&allocator, ctx);
+}
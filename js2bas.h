@@ -0,0 +1,113 @@
+/*
+ * js2bas.h - Public interface of libjs2bas, the JavaScript-like language
+ *            to BASIC translator.
+ *
+ * Author: Philip R. Simonson
+ * Date: 10/17/2026
+ *
+ * A context is used by one thread at a time; separate contexts can
+ * translate on separate threads. Nothing in the library writes to stdio
+ * or exits, everything goes through the sinks and the return value.
+ *
+ */
+
+#ifndef JS2BAS_H
+#define JS2BAS_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Exported from the shared library (everything else is hidden)
+#define JS2BAS_API __attribute__((visibility("default")))
+
+// Results of js2bas_translate() and js2bas_translate_file()
+#define JS2BAS_OK 0
+#define JS2BAS_ERROR_PARSE 1    // the diagnostics sink has the details
+#define JS2BAS_ERROR_MEMORY 2
+#define JS2BAS_ERROR_OUTPUT 3   // a sink write callback failed
+#define JS2BAS_ERROR_INPUT 4    // the file could not be opened or read
+
+// Allocator Hooks (members left NULL fall back to malloc/realloc/free)
+typedef struct Js2basAllocator {
+    void *(*alloc)(void *user, size_t size);
+    void *(*resize)(void *user, void *ptr, size_t size);
+    void (*release)(void *user, void *ptr);
+    void *user;
+} Js2basAllocator;
+
+// Output Sink (write returns 0 on success, anything else stops translation)
+typedef struct Js2basSink {
+    int (*write)(void *user, const char *data, size_t length);
+    void *user;
+} Js2basSink;
+
+// Options
+typedef struct Js2basOptions {
+    size_t flush_size;  // output is handed over once this much is pending,
+                        // 0 hands over every statement as soon as it is done
+    int optimize;       // fold constants, simplify expressions and remove
+                        // dead code (-O)
+    int verbose;        // report what -O removed to the diagnostics (-v)
+    unsigned line_start;  // number lines for GW-BASIC from here (--lines),
+                          // 0 for QBasic block IF and WHILE/WEND
+    unsigned line_step;   // 0 for 10
+    int compact;        // line-numbered GW-BASIC as small as it gets: short
+                        // names, no REM, statements joined with ':' (--compact)
+    Js2basSink names;   // where --compact writes each short name and the
+                        // name it stands for, nowhere without a write callback
+    int tokenize;       // write line-numbered GW-BASIC as a tokenized binary
+                        // program file instead of text (--tokenize)
+    int stats;         // collect Js2basStats, see js2bas_stats()
+} Js2basOptions;
+
+// Phases of a translation (tokenizing, parsing and generating interleave
+// statement by statement, each phase gets only its own share)
+enum {
+    JS2BAS_PHASE_LOAD,
+    JS2BAS_PHASE_TOKENIZE,
+    JS2BAS_PHASE_PARSE,
+    JS2BAS_PHASE_GENERATE,
+    JS2BAS_PHASES
+};
+
+// Number of token and syntax tree node types counted
+#define JS2BAS_TOKEN_TYPES 21
+#define JS2BAS_NODE_TYPES 12
+
+// Statistics of the last translation of a context (js2bas_stats() gives
+// NULL unless options.stats was set, or if built with JS2BAS_NO_STATS)
+typedef struct Js2basStats {
+    double wall[JS2BAS_PHASES];         // seconds, tokenize, parse and generate
+                                        // shared out as one statement in 16 took
+    double cpu[JS2BAS_PHASES];          // seconds of the translating thread's
+                                        // CPU time, shared out the same way
+    size_t tokens[JS2BAS_TOKEN_TYPES];  // per token type (EOF, NUMBER, ...)
+    size_t nodes[JS2BAS_NODE_TYPES];    // per node type (NUMBER, STRING, ...)
+    size_t max_depth;                   // deepest syntax tree node, 1 for the root
+    size_t statements;
+    size_t bytes_out;
+    size_t allocations;                 // calls to the allocator hooks
+    size_t allocated_bytes;             // bytes asked for by those calls
+    long peak_rss;                      // kilobytes, of the whole process
+} Js2basStats;
+
+// Context (opaque, keeps its buffers between translations)
+typedef struct Js2basContext Js2basContext;
+
+JS2BAS_API Js2basContext *js2bas_create(const Js2basAllocator *allocator, const Js2basOptions *options);
+JS2BAS_API int js2bas_translate(Js2basContext *ctx, const char *source, size_t length,
+    const Js2basSink *out, const Js2basSink *diag);
+JS2BAS_API int js2bas_translate_file(Js2basContext *ctx, const char *filename,
+    const Js2basSink *out, const Js2basSink *diag);
+JS2BAS_API const Js2basStats *js2bas_stats(const Js2basContext *ctx);
+JS2BAS_API int js2bas_stats_write(const Js2basStats *stats, int json, const Js2basSink *sink);
+JS2BAS_API void js2bas_destroy(Js2basContext *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // JS2BAS_H
@@ -12,118 +12,623 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include "js2bas.h"
+#include "arena.h"
+#include "input.h"
+#include "sink.h"
+#include "pool.h"
+#include "scan.h"
+#include "symbols.h"
 #include "token.h"
 #include "parse.h"
+#include "crunch.h"
+#include "vm.h"
+#include "translate.h"
+#include "watch.h"
+#include "server.h"
 
-// Load a source file
-char *load_file(const char *filename, long int *outsize)
-{
-	char name[512];
-	long int nbytes;
-	long int size;
-	char *source;
-	char *dot;
-	FILE *fp;
-
-	dot = strrchr(filename, '.');
-	if(dot != NULL) {
-		*dot = '\0';
-	}
-	strncpy(name, filename, sizeof(name)-1);
-	strncat(name, ".js", sizeof(name)-1);
-
-	if((fp = fopen(name, "rt")) == NULL) {
-		fprintf(stderr, "Error: Cannot open file '%s'.\n", name);
-		return NULL;
-	}
-
-	fseek(fp, 0, SEEK_END);
-	size = ftell(fp);
-	fseek(fp, 0, SEEK_SET);
-
-	source = (char*)malloc((size+1) * sizeof(char));
-	if(source == NULL) {
-		fprintf(stderr, "Error: Out of memory.\n");
-		fclose(fp);
-		return NULL;
-	}
-
-	nbytes = fread(source, sizeof(char), size, fp);
-	source[nbytes] = '\0';
-	fclose(fp);
-
-	if(nbytes != size) {
-		fprintf(stderr, "Error: Total bytes does NOT match size.\n");
-		free(source);
-		source = NULL;
-	}
-
-	if(outsize != NULL) {
-		*outsize = size;
-	}
-
-	return source;
+// Output is flushed once this much is pending (after every statement on a terminal)
+#define OUTPUT_BATCH (4 * SINK_CHUNK)
+
+// Batch Structure (one task per input file)
+typedef struct {
+    char **files;
+    size_t count;
+    size_t capacity;
+    Sink *diags;
+    int *results;
+    int optimize;
+    int verbose;
+    unsigned line_start;    // --lines, 0 for none
+    unsigned line_step;
+    int compact;            // --compact, short names go to name.map
+    int tokenize;           // --tokenize
+} Batch;
+
+// Add a file to the batch
+static int batch_add(Batch *batch, const char *filename) {
+    if (batch->count == batch->capacity) {
+        size_t capacity = batch->capacity ? batch->capacity * 2 : 16;
+        char **tmp = realloc(batch->files, sizeof(char*) * capacity);
+        if (tmp == NULL) {
+            return -1;
+        }
+        batch->files = tmp;
+        batch->capacity = capacity;
+    }
+    if ((batch->files[batch->count] = strdup(filename)) == NULL) {
+        return -1;
+    }
+    batch->count++;
+    return 0;
+}
+
+// Add every file listed in a manifest (one per line, '#' starts a comment)
+static int batch_add_manifest(Batch *batch, const char *manifest) {
+    char line[4096];
+    FILE *fp;
+
+    if ((fp = fopen(manifest, "r")) == NULL) {
+        fprintf(stderr, "Error: Cannot open manifest '%s'.\n", manifest);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        size_t length = strcspn(line, "\r\n");
+        line[length] = '\0';
+        while (length > 0 && isspace((unsigned char)line[length - 1])) {
+            line[--length] = '\0';
+        }
+        if (length == 0 || line[0] == '#') {
+            continue;
+        }
+        if (batch_add(batch, line) < 0) {
+            fclose(fp);
+            return -1;
+        }
+    }
+    fclose(fp);
+    return 0;
+}
+
+// Name of an output file, 'name.js' becomes 'name.bas' (or another
+// extension)
+static char *output_name(const char *filename, const char *extension) {
+    size_t length = strlen(filename), size = strlen(extension) + 1;
+    char *name;
+
+    if (length >= 3 && strcmp(filename + length - 3, ".js") == 0) {
+        length -= 3;
+    }
+    if ((name = malloc(length + size)) == NULL) {
+        return NULL;
+    }
+    memcpy(name, filename, length);
+    memcpy(name + length, extension, size);
+    return name;
+}
+
+// Output File Structure (created on the first write, so a file that
+// cannot be read leaves no .bas behind)
+typedef struct {
+    const char *name;
+    int fd;
+    Sink *diag;
+} OutputFile;
+
+// Write all of data to a file descriptor
+static int write_all(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += written;
+        length -= (size_t)written;
+    }
+    return 0;
+}
+
+// Create the output file if it is not open yet
+static int output_create(OutputFile *file) {
+    if (file->fd < 0 && (file->fd = open(file->name, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+        sink_printf(file->diag, "Error: Cannot create file '%s': %s.\n", file->name, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+// Library sink writing to an output file
+static int write_file(void *user, const char *data, size_t length) {
+    OutputFile *file = user;
+
+    if (output_create(file) < 0) {
+        return -1;
+    }
+    return write_all(file->fd, data, length);
+}
+
+// Library sink writing to standard output or standard error
+static int write_stream(void *user, const char *data, size_t length) {
+    return write_all(*(int *)user, data, length);
+}
+
+// Library sink collecting diagnostics in a memory sink
+static int write_sink(void *user, const char *data, size_t length) {
+    Sink *sink = user;
+
+    sink_write(sink, data, length);
+    return sink->error != 0 ? -1 : 0;
+}
+
+// Translate one file of the batch into its own output file
+static void translate_file(void *context, size_t index) {
+    Batch *batch = context;
+    Js2basOptions options = { .flush_size = OUTPUT_BATCH, .optimize = batch->optimize,
+        .verbose = batch->verbose, .line_start = batch->line_start, .line_step = batch->line_step,
+        .compact = batch->compact, .tokenize = batch->tokenize };
+    Js2basSink out, diag = { write_sink, &batch->diags[index] };
+    OutputFile file = { NULL, -1, &batch->diags[index] }, map = { NULL, -1, &batch->diags[index] };
+    Js2basContext *ctx;
+    char *outname, *mapname = NULL;
+
+    batch->results[index] = 1;
+    outname = output_name(batch->files[index], ".bas");
+    if (batch->compact) {
+        map.name = mapname = output_name(batch->files[index], ".map");
+        options.names = (Js2basSink){ write_file, &map };
+    }
+    if (outname == NULL || (batch->compact && mapname == NULL)
+            || (ctx = js2bas_create(NULL, &options)) == NULL) {
+        sink_literal(&batch->diags[index], "Error: Out of memory.\n");
+        free(outname);
+        free(mapname);
+        return;
+    }
+
+    file.name = outname;
+    out.write = write_file;
+    out.user = &file;
+    batch->results[index] = js2bas_translate_file(ctx, batch->files[index], &out, &diag);
+    if (batch->results[index] != JS2BAS_ERROR_INPUT && output_create(&file) < 0) {
+        batch->results[index] = JS2BAS_ERROR_OUTPUT;  // nothing was written
+    }
+
+    if (file.fd >= 0) {
+        close(file.fd);
+    }
+    if (map.fd >= 0) {
+        close(map.fd);
+    }
+    // A failed file leaves no output behind, not even an empty one
+    if (batch->results[index] != JS2BAS_OK) {
+        if (file.fd >= 0) {
+            unlink(outname);
+        }
+        if (map.fd >= 0) {
+            unlink(mapname);
+        }
+    }
+    js2bas_destroy(ctx);
+    free(outname);
+    free(mapname);
+}
+
+// Translate all files of the batch on a pool of threads
+static int run_batch(Batch *batch, int threads) {
+    int result = 0;
+
+    batch->diags = calloc(batch->count, sizeof(Sink));
+    batch->results = calloc(batch->count, sizeof(int));
+    if (batch->diags == NULL || batch->results == NULL) {
+        fprintf(stderr, "Error: Out of memory.\n");
+        return 1;
+    }
+    for (size_t i = 0; i < batch->count; ++i) {
+        sink_init_memory(&batch->diags[i]);
+    }
+
+    if (pool_run(threads, batch->count, translate_file, batch) < 0) {
+        fprintf(stderr, "Error: Cannot start worker threads.\n");
+        return 1;
+    }
+
+    // Report in input order, whichever thread finished first
+    for (size_t i = 0; i < batch->count; ++i) {
+        if (batch->diags[i].length > 0) {
+            char *text = sink_contents(&batch->diags[i], NULL);
+            fprintf(stderr, "In file '%s':\n%s", batch->files[i], text ? text : "");
+            allocator_free(batch->diags[i].allocator, text);
+        }
+        if (batch->results[i] != JS2BAS_OK) {
+            result = 1;
+        }
+        sink_free(&batch->diags[i]);
+    }
+    return result;
+}
+
+// Parse the value of --lines: nothing, "=start" or "=start,step"
+static int parse_lines(const char *value, Batch *batch) {
+    unsigned long start = 10, step = 10;
+    char *end;
+
+    if (*value == '=') {
+        start = strtoul(value + 1, &end, 10);
+        if (*end == ',') {
+            step = strtoul(end + 1, &end, 10);
+        }
+        if (*end != '\0' || end == value + 1) {
+            return -1;
+        }
+    }
+    if (start < 1 || start > GWBASIC_MAX_LINE || step < 1 || step > GWBASIC_MAX_LINE) {
+        return -1;
+    }
+    batch->line_start = (unsigned)start;
+    batch->line_step = (unsigned)step;
+    return 0;
+}
+
+// Write the listing of a tokenized program to standard output
+static int list_program(const char *filename) {
+    Input in;
+    Sink out, diag;
+    int result = 1;
+
+    sink_init_fd(&out, STDOUT_FILENO);
+    sink_init_fd(&diag, STDERR_FILENO);
+    if (input_open(&in, filename, &diag) == 0) {
+        if (input_read_all(&in) < 0) {
+            sink_printf(&diag, "Error: Cannot read file '%s'.\n", filename);
+        } else if (detokenize((const unsigned char *)in.buffer, in.length, &out) < 0) {
+            sink_printf(&diag, "Error: '%s' is not a tokenized program.\n", filename);
+        } else {
+            result = 0;
+        }
+        input_close(&in);
+    }
+    if (sink_flush(&out) < 0) {
+        sink_literal(&diag, "Error: Cannot write output.\n");
+        result = 1;
+    }
+    sink_flush(&diag);
+    sink_free(&out);
+    sink_free(&diag);
+    return result;
+}
+
+// Translate the file of the batch and run the BASIC program in the
+// virtual machine, INPUT reading the lines of a script (standard input
+// without one); the instructions it took go to standard error
+static int run_program(const Batch *batch, const char *script, unsigned long long steps) {
+    Js2basOptions options = { .optimize = batch->optimize, .verbose = batch->verbose,
+        .line_start = batch->line_start, .line_step = batch->line_step, .compact = batch->compact };
+    int diag_fd = STDERR_FILENO;
+    Js2basSink program_sink, diag_sink = { write_stream, &diag_fd };
+    Js2basContext *ctx;
+    Sink program, out, diag;
+    Input in;
+    Vm vm;
+    char *text = NULL;
+    size_t length = 0;
+    int result = 1;
+
+    sink_init_memory(&program);
+    sink_init_fd(&out, STDOUT_FILENO);
+    sink_init_fd(&diag, STDERR_FILENO);
+    out.batch = isatty(STDOUT_FILENO) ? 0 : OUTPUT_BATCH;
+    program_sink = (Js2basSink){ write_sink, &program };
+    if ((ctx = js2bas_create(NULL, &options)) == NULL) {
+        sink_literal(&diag, "Error: Out of memory.\n");
+    } else if (js2bas_translate_file(ctx, batch->count ? batch->files[0] : NULL, &program_sink, &diag_sink) == JS2BAS_OK
+            && (text = sink_contents(&program, &length)) == NULL) {
+        sink_literal(&diag, "Error: Out of memory.\n");
+    }
+    js2bas_destroy(ctx);
+
+    if (text != NULL && input_open(&in, script, &diag) == 0) {
+        if (input_read_all(&in) < 0) {
+            sink_printf(&diag, "Error: Cannot read the input of the program.\n");
+        } else {
+            vm_init(&vm, NULL, &diag);
+            vm.limit = steps;
+            if (vm_compile(&vm, text, length) == 0) {
+                result = vm_run(&vm, in.buffer, in.length, &out) < 0;
+                sink_printf(&diag, "Executed %llu instructions.\n", (unsigned long long)vm.executed);
+                if (batch->verbose) {
+                    vm_write_counts(&vm, &diag);
+                }
+            }
+            vm_free(&vm);
+        }
+        input_close(&in);
+    }
+
+    sink_flush(&out);
+    sink_flush(&diag);
+    allocator_free(program.allocator, text);
+    sink_free(&program);
+    sink_free(&out);
+    sink_free(&diag);
+    return result;
+}
+
+// Free the batch
+static void batch_free(Batch *batch) {
+    for (size_t i = 0; i < batch->count; ++i) {
+        free(batch->files[i]);
+    }
+    free(batch->files);
+    free(batch->diags);
+    free(batch->results);
 }
 
 // Main Function
 int main(int argc, char *argv[]) {
-    char *source;
-    Token *tokens;
-    
-    if (argc != 2 && argc != 3) {
-	    fprintf(stderr, "Usage: %s <filename.js>\n", argv[0]);
+    Batch batch = {0};
+    int threads = 0;
+    int parallel = 0;
+    int watching = 0;
+    int stats = 0;      // 1 for a table, 2 for JSON
+    const char *socket_path = NULL;
+    const char *listing = NULL;
+    int running = 0;            // --run
+    const char *script = NULL;  // input of the program, standard input for none
+    unsigned long long steps = 0;
+    int result;
+
+    if (argc < 2) {
+	    fprintf(stderr, "Usage: %s [-O] [-v] [-P] [--lines[=start[,step]]] [--compact] [--tokenize] [--list file.bas] [--run[=input]] [--steps=count] [--watch] [--serve socket] [--stats[=json]] [-j threads] [-m manifest] <filename.js|-> ...\n", argv[0]);
 	    return 1;
     }
 
-    char *filename = NULL;
-    int mode = 0;
-    int found = 0;
-    for (int i = 0; i < argc; ++i) {
-	    if (!found && argv[i][0] == '-') {
-		    int j = 1;
-		    while (!found && argv[i][j] != '\0') {
-			    if (argv[i][j] == 'b') {
-				    mode = 0;
-				    break;
-			    } else {
+    for (int i = 1; i < argc; ++i) {
+	    if (strcmp(argv[i], "--watch") == 0) {
+		    watching = 1;
+	    } else if (strcmp(argv[i], "--stats") == 0 || strcmp(argv[i], "--stats=json") == 0) {
+		    stats = argv[i][7] == '=' ? 2 : 1;
+	    } else if (strncmp(argv[i], "--lines", 7) == 0 && (argv[i][7] == '\0' || argv[i][7] == '=')) {
+		    if (parse_lines(&argv[i][7], &batch) < 0) {
+			    fprintf(stderr, "Option 'lines' takes a start and step from 1 to %d.\n", GWBASIC_MAX_LINE);
+			    batch_free(&batch);
+			    return 1;
+		    }
+	    } else if (strcmp(argv[i], "--compact") == 0) {
+		    batch.compact = 1;
+	    } else if (strcmp(argv[i], "--tokenize") == 0) {
+		    batch.tokenize = 1;
+	    } else if (strcmp(argv[i], "--run") == 0 || strncmp(argv[i], "--run=", 6) == 0) {
+		    running = 1;
+		    script = argv[i][5] == '=' ? &argv[i][6] : NULL;
+	    } else if (strncmp(argv[i], "--steps=", 8) == 0) {
+		    char *end;
+		    steps = strtoull(&argv[i][8], &end, 10);
+		    if (*end != '\0' || end == &argv[i][8] || steps == 0) {
+			    fprintf(stderr, "Option 'steps' takes a count of instructions above 0.\n");
+			    batch_free(&batch);
+			    return 1;
+		    }
+	    } else if (strcmp(argv[i], "--list") == 0) {
+		    if (i + 1 >= argc) {
+			    fprintf(stderr, "Option 'list' needs a tokenized program.\n");
+			    batch_free(&batch);
+			    return 1;
+		    }
+		    listing = argv[++i];
+	    } else if (strcmp(argv[i], "--serve") == 0) {
+		    if (i + 1 >= argc) {
+			    fprintf(stderr, "Option 'serve' needs a socket path.\n");
+			    batch_free(&batch);
+			    return 1;
+		    }
+		    socket_path = argv[++i];
+	    } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+		    char option = argv[i][1];
+		    if (option == 'j' || option == 'm') {
+			    const char *value = argv[i][2] != '\0' ? &argv[i][2] : (i + 1 < argc ? argv[++i] : NULL);
+			    if (value == NULL) {
+				    fprintf(stderr, "Option '%c' needs a value.\n", option);
+				    batch_free(&batch);
+				    return 1;
+			    }
+			    if (option == 'j') {
+				    char *end;
+				    long count;
+				    errno = 0;
+				    count = strtol(value, &end, 10);
+				    if (*end != '\0' || end == value || errno != 0 || count <= 0 || count > INT_MAX) {
+					    fprintf(stderr, "Option 'j' takes a number of threads above 0.\n");
+					    batch_free(&batch);
+					    return 1;
+				    }
+				    threads = (int)count;
+			    } else if (batch_add_manifest(&batch, value) < 0) {
+				    batch_free(&batch);
+				    return 1;
+			    }
+			    continue;
+		    }
+		    for (int j = 1; argv[i][j] != '\0'; ++j) {
+			    if (argv[i][j] == 'P') {
+				    parallel = 1;
+			    } else if (argv[i][j] == 'O') {
+				    batch.optimize = 1;
+			    } else if (argv[i][j] == 'v') {
+				    batch.verbose = 1;
+			    } else if (argv[i][j] != 'b') {
 				    fprintf(stderr, "Unknown option '%c'.\n", argv[i][j]);
+				    batch_free(&batch);
 				    return 1;
 			    }
-			    ++j;
 		    }
-		    found = 1;
-	    } else {
-		    filename = argv[i];
+	    } else if (batch_add(&batch, argv[i]) < 0) {
+		    fprintf(stderr, "Error: Out of memory.\n");
+		    batch_free(&batch);
+		    return 1;
 	    }
     }
 
-    source = load_file(filename, NULL);
-    if(source == NULL) {
+    if (listing != NULL) {
+	    result = list_program(listing);
+	    batch_free(&batch);
+	    return result;
+    }
+
+    scan_init();  // Pick scanners before any thread starts lexing
+
+    if (parallel && batch.count > 1) {
+	    fprintf(stderr, "Option 'P' works on a single file.\n");
+	    batch_free(&batch);
+	    return 1;
+    }
+
+    if (stats && (batch.count > 1 || threads > 0 || parallel || watching)) {
+	    fprintf(stderr, "Option 'stats' works on a single file or with 'serve'.\n");
+	    batch_free(&batch);
+	    return 1;
+    }
+
+    if (batch.optimize && (parallel || watching)) {
+	    fprintf(stderr, "Option 'O' does not work with 'P' or 'watch'.\n");
+	    batch_free(&batch);
 	    return 1;
     }
-    
-    tokens = tokenize(source);
-    free(source);
-
-    Token *currentToken = tokens;
-    while(currentToken->type != TOKEN_EOF) {
-	    ASTNode *ast = parse_statement(&currentToken);
-	    if (ast == NULL) {
-	        fprintf(stderr, "Error in parsing the source code.\n");
-	        free(tokens);  // Free tokens before exiting
-	        return 1;
+
+    if ((batch.line_start > 0 || batch.compact || batch.tokenize) && (parallel || watching)) {
+	    fprintf(stderr, "Options 'lines', 'compact' and 'tokenize' do not work with 'P' or 'watch'.\n");
+	    batch_free(&batch);
+	    return 1;
+    }
+
+    if (running && (batch.count > 1 || threads > 0 || parallel || watching || socket_path != NULL || stats || batch.tokenize)) {
+	    fprintf(stderr, "Option 'run' works on a single file, without 'P', 'j', 'watch', 'serve', 'stats' or 'tokenize'.\n");
+	    batch_free(&batch);
+	    return 1;
+    }
+
+    if (running && script == NULL && (batch.count == 0 || strcmp(batch.files[0], "-") == 0)) {
+	    fprintf(stderr, "Option 'run' needs an input file when the program comes from standard input.\n");
+	    batch_free(&batch);
+	    return 1;
+    }
+
+    if (running) {
+	    // Translate and run the program in the virtual machine
+	    result = run_program(&batch, script, steps);
+    } else if (socket_path != NULL) {
+	    // Translate requests from clients until killed
+	    Js2basOptions options = { .flush_size = SINK_CHUNK, .optimize = batch.optimize, .verbose = batch.verbose,
+		    .line_start = batch.line_start, .line_step = batch.line_step, .compact = batch.compact,
+		    .tokenize = batch.tokenize };
+	    Sink diag;
+
+	    sink_init_fd(&diag, STDERR_FILENO);
+	    result = serve(socket_path, &options, stats, &diag);
+	    sink_flush(&diag);
+	    sink_free(&diag);
+    } else if (watching) {
+	    // Keep name.bas up to date until interrupted
+	    Watch watch;
+	    Sink diag;
+	    char *outname;
+
+	    if (batch.count != 1 || strcmp(batch.files[0], "-") == 0 || parallel) {
+		    fprintf(stderr, "Option 'watch' works on a single named file.\n");
+		    batch_free(&batch);
+		    return 1;
+	    }
+	    if ((outname = output_name(batch.files[0], ".bas")) == NULL) {
+		    fprintf(stderr, "Error: Out of memory.\n");
+		    batch_free(&batch);
+		    return 1;
 	    }
+	    sink_init_fd(&diag, STDERR_FILENO);
+	    result = 1;
+	    if (watch_init(&watch, batch.files[0], outname, &diag) == 0) {
+		    result = watch_run(&watch);
+		    watch_free(&watch);
+	    }
+	    sink_flush(&diag);
+	    sink_free(&diag);
+	    free(outname);
+    } else if (batch.count > 1 || (threads > 0 && !parallel)) {
+	    // Batch mode, every file gets its own .bas file
+	    result = run_batch(&batch, threads > 0 ? threads : 1);
+    } else if (!parallel) {
+	    // Files are mapped, pipes are read chunk by chunk while parsing
+	    Js2basOptions options = { .flush_size = isatty(STDOUT_FILENO) ? 0 : OUTPUT_BATCH, .optimize = batch.optimize,
+		    .verbose = batch.verbose, .line_start = batch.line_start, .line_step = batch.line_step,
+		    .compact = batch.compact, .tokenize = batch.tokenize, .stats = stats != 0 };
+	    int out_fd = STDOUT_FILENO, diag_fd = STDERR_FILENO;
+	    Js2basSink out = { write_stream, &out_fd }, diag = { write_stream, &diag_fd };
+	    Sink errors;
+	    OutputFile map = { NULL, -1, &errors };
+	    Js2basContext *ctx;
 
-	    if(!mode) {
-		    generate_gwbasic_code(ast, 0);
+	    // Short names go next to a named source, standard input has none
+	    sink_init_fd(&errors, STDERR_FILENO);
+	    if (batch.compact && batch.count > 0 && strcmp(batch.files[0], "-") != 0) {
+		    map.name = output_name(batch.files[0], ".map");
+		    options.names = (Js2basSink){ write_file, &map };
 	    }
-	    free_ast(ast);
-	    putchar('\n');
-    }
+	    if ((batch.compact && options.names.write != NULL && map.name == NULL)
+			    || (ctx = js2bas_create(NULL, &options)) == NULL) {
+		    fprintf(stderr, "Error: Out of memory.\n");
+		    free((char *)map.name);
+		    sink_free(&errors);
+		    batch_free(&batch);
+		    return 1;
+	    }
+	    result = js2bas_translate_file(ctx, batch.count ? batch.files[0] : NULL, &out, &diag);
+	    if (stats) {
+		    // Statistics go to standard error, after the translation
+		    if (js2bas_stats(ctx) == NULL) {
+			    fprintf(stderr, "Statistics are not available in this build.\n");
+		    } else {
+			    js2bas_stats_write(js2bas_stats(ctx), stats == 2, &diag);
+		    }
+	    }
+	    if (map.fd >= 0) {
+		    close(map.fd);
+	    }
+	    sink_flush(&errors);
+	    sink_free(&errors);
+	    free((char *)map.name);
+	    js2bas_destroy(ctx);
+    } else {
+	    // Statements of one file on several threads, same output
+	    Input in;
+	    Sink out, diag;
 
-    // Free tokens and AST
-    free_tokens(tokens);
+	    sink_init_fd(&diag, STDERR_FILENO);
+	    // Files are mapped, pipes are read chunk by chunk while parsing
+	    if (input_open(&in, batch.count ? batch.files[0] : NULL, &diag) < 0) {
+		    sink_flush(&diag);
+		    sink_free(&diag);
+		    batch_free(&batch);
+		    return 1;
+	    }
 
-    return 0;
-}
+	    sink_init_fd(&out, STDOUT_FILENO);
+	    out.batch = isatty(STDOUT_FILENO) ? 0 : OUTPUT_BATCH;
+	    if (threads <= 0) {
+		    threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	    }
+	    result = translate_parallel(&in, &out, &diag, threads);
+	    sink_flush(&diag);
 
+	    sink_free(&out);
+	    sink_free(&diag);
+	    input_close(&in);
+    }
+
+    batch_free(&batch);
+    return result != 0 ? 1 : 0;
+}
@@ -0,0 +1,357 @@
+/*
+ * optimize.c - Constant folding and simplification of expressions (-O).
+ *
+ * Author: Philip R. Simonson
+ * Date: 10/17/2026
+ *
+ * Expressions are folded bottom up in one pass over their nodes. A constant is
+ * only folded when the interpreter would compute exactly the same value
+ * of the same type: INTEGER and LONG results must not overflow, '/'
+ * (always SINGLE) must divide exactly, and folded values keep their type
+ * with a '&' or '!' suffix where the digits alone would read as INTEGER.
+ *
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "js2bas.h"
+#include "arena.h"
+#include "sink.h"
+#include "symbols.h"
+#include "token.h"
+#include "parse.h"
+#include "optimize.h"
+
+// Largest values of each numeric type that fold exactly (SINGLE holds
+// every integer up to 2^24)
+#define INTEGER_MAX 32767
+#define LONG_MAX_VALUE 2147483647
+#define SINGLE_EXACT (1 << 24)
+
+// Longest string constant folded (GW-BASIC strings stop at 255)
+#define STRING_MAX 255
+
+// Initialize an optimizer allocating folded nodes from arena
+void optimizer_init(Optimizer *opt, Arena *arena) {
+    memset(opt, 0, sizeof(Optimizer));
+    opt->arena = arena;
+    opt->allocator = arena->allocator;
+}
+
+// Free the optimizer tables
+void optimizer_free(Optimizer *opt) {
+    allocator_free(opt->allocator, opt->symbols);
+    allocator_free(opt->allocator, opt->operands);
+    memset(opt, 0, sizeof(Optimizer));
+}
+
+// Type of a variable, unknown unless declared before
+static ValueKind variable_kind(const Optimizer *opt, const Ast *ast, AstIndex node) {
+    uint32_t id = ast->first[node];
+    return id < opt->capacity ? opt->symbols[id].kind : KIND_UNKNOWN;
+}
+
+// Record the type a declaration gives a variable; declaring one twice
+// with different types makes it unknown
+static int declare(Optimizer *opt, const Ast *ast, AstIndex node, ValueKind kind) {
+    uint32_t id = ast->first[node];
+    OptimizerSymbol *symbol;
+
+    if (id >= opt->capacity) {
+        size_t capacity = opt->capacity ? opt->capacity : 64;
+        OptimizerSymbol *tmp;
+
+        while (capacity <= id) {
+            capacity *= 2;
+        }
+        if ((tmp = allocator_resize(opt->allocator, opt->symbols, sizeof(OptimizerSymbol) * capacity)) == NULL) {
+            return -1;
+        }
+        memset(tmp + opt->capacity, 0, sizeof(OptimizerSymbol) * (capacity - opt->capacity));
+        opt->symbols = tmp;
+        opt->capacity = capacity;
+    }
+
+    symbol = &opt->symbols[id];
+    if (symbol->declared) {
+        if (symbol->kind != kind) {
+            symbol->kind = KIND_UNKNOWN;
+        }
+        return 0;
+    }
+    symbol->declared = 1;
+    symbol->kind = kind;
+    return 0;
+}
+
+// Numeric types
+static int is_numeric(ValueKind kind) {
+    return kind == KIND_INTEGER || kind == KIND_LONG || kind == KIND_SINGLE;
+}
+
+// Describe a leaf of an expression
+static Operand leaf(const Optimizer *opt, const Ast *ast, AstIndex node) {
+    Operand operand = { KIND_UNKNOWN, 0, 0 };
+
+    if (ast->type[node] == AST_NUMBER) {
+        const char *text = ast_leaf_text(ast, node);
+        int64_t value = 0;
+        for (uint32_t i = 0; i < ast_leaf_length(ast, node) && value <= LONG_MAX_VALUE; ++i) {
+            value = value * 10 + (text[i] - '0');
+        }
+        // Bigger literals are DOUBLE and left alone
+        if (value <= LONG_MAX_VALUE) {
+            operand.kind = value <= INTEGER_MAX ? KIND_INTEGER : KIND_LONG;
+            operand.constant = 1;
+            operand.value = value;
+        }
+    } else if (ast->type[node] == AST_STRING) {
+        operand.kind = KIND_STRING;
+        operand.constant = 1;
+    } else if (ast->type[node] == AST_IDENTIFIER) {
+        operand.kind = variable_kind(opt, ast, node);
+    }
+    return operand;
+}
+
+// Make node a leaf with a text from the arena, returns -1 when out of memory
+static int make_leaf(Optimizer *opt, Ast *ast, AstIndex node, ASTNodeType type, const char *text, uint32_t length) {
+    AstIndex index = ast_text(ast, text, length);
+
+    if (index == AST_NONE) {
+        opt->error = ENOMEM;
+        return -1;
+    }
+    ast->type[node] = type;
+    ast->first[node] = index;
+    ast->second[node] = AST_NONE;
+    return 0;
+}
+
+// Turn an operator node into a numeric constant, if the value fits its type
+static Operand fold_number(Optimizer *opt, Ast *ast, AstIndex node, Operand result, int64_t value, ValueKind kind) {
+    int64_t limit = kind == KIND_INTEGER ? INTEGER_MAX : kind == KIND_LONG ? LONG_MAX_VALUE : SINGLE_EXACT;
+    const char *suffix = "";
+    char buffer[32], *text;
+    int length;
+
+    result.kind = kind;
+    if (value > limit || value < -limit) {
+        return result;  // the interpreter overflows or rounds, so it may as well
+    }
+    if (kind == KIND_SINGLE) {
+        suffix = "!";
+    } else if (kind == KIND_LONG && value >= -INTEGER_MAX && value <= INTEGER_MAX) {
+        suffix = opt->numbered ? "#" : "&";  // GW-BASIC's LONG is a DOUBLE
+    }
+
+    length = snprintf(buffer, sizeof(buffer), "%lld%s", (long long)value, suffix);
+    if ((text = arena_alloc(opt->arena, length)) == NULL) {
+        opt->error = ENOMEM;
+        return result;
+    }
+    memcpy(text, buffer, length);
+    if (make_leaf(opt, ast, node, AST_NUMBER, text, length) < 0) {
+        return result;
+    }
+    result.constant = 1;
+    result.value = value;
+    return result;
+}
+
+// Turn an operator node into a string constant
+static Operand fold_string(Optimizer *opt, Ast *ast, AstIndex node, Operand result) {
+    AstIndex left = ast->first[node], right = ast->second[node];
+    uint32_t left_length = ast_leaf_length(ast, left);
+    uint32_t length = left_length + ast_leaf_length(ast, right);
+    char *text;
+
+    result.kind = KIND_STRING;
+    if (length > STRING_MAX) {
+        return result;
+    }
+    if ((text = arena_alloc(opt->arena, length > 0 ? length : 1)) == NULL) {
+        opt->error = ENOMEM;
+        return result;
+    }
+    memcpy(text, ast_leaf_text(ast, left), left_length);
+    memcpy(text + left_length, ast_leaf_text(ast, right), length - left_length);
+    if (make_leaf(opt, ast, node, AST_STRING, text, length) < 0) {
+        return result;
+    }
+    result.constant = 1;
+    return result;
+}
+
+// Make node a copy of the operand it simplifies to
+static Operand replace(Ast *ast, AstIndex node, AstIndex operand, const Operand *value) {
+    ast->type[node] = ast->type[operand];
+    ast->op[node] = ast->op[operand];
+    ast->first[node] = ast->first[operand];
+    ast->second[node] = ast->second[operand];
+    return *value;
+}
+
+// Fold or simplify one operator whose operands are done already, the
+// result replaces the operator node in place
+static Operand simplify(Optimizer *opt, Ast *ast, AstIndex node, const Operand *left, const Operand *right) {
+    Operand result = { KIND_UNKNOWN, 0, 0 };
+    char op = ast->op[node];
+    int numeric = is_numeric(left->kind) && is_numeric(right->kind);
+    int constant = left->constant && right->constant;
+    ValueKind kind = left->kind > right->kind ? left->kind : right->kind;
+    int64_t a = left->value, b = right->value;
+
+    switch (op) {
+        case '<': case '>': case '=':
+            // Relations are INTEGER -1 or 0, whatever they compare
+            result.kind = KIND_INTEGER;
+            if (constant && numeric && (kind != KIND_SINGLE
+                    || (llabs(a) <= SINGLE_EXACT && llabs(b) <= SINGLE_EXACT))) {
+                int truth = op == '<' ? a < b : op == '>' ? a > b : a == b;
+                return fold_number(opt, ast, node, result, truth ? -1 : 0, KIND_INTEGER);
+            }
+            return result;
+        case '+': case '-': case '*':
+            break;
+        case '/':
+            // Always SINGLE, folded only when exact
+            if (!numeric || left->kind == KIND_LONG || right->kind == KIND_LONG) {
+                return result;
+            }
+            result.kind = KIND_SINGLE;
+            if (constant && b != 0 && a % b == 0 && llabs(a) <= SINGLE_EXACT && llabs(b) <= SINGLE_EXACT) {
+                return fold_number(opt, ast, node, result, a / b, KIND_SINGLE);
+            }
+            return result;
+        default:
+            return result;  // ',' separates PRINT items
+    }
+
+    if (op == '+' && left->kind == KIND_STRING && right->kind == KIND_STRING) {
+        if (constant) {
+            return fold_string(opt, ast, node, result);
+        }
+        result.kind = KIND_STRING;
+        return result;
+    }
+    if (!numeric) {
+        return result;
+    }
+
+    if (constant) {
+        int64_t value = op == '+' ? a + b : op == '-' ? a - b : a * b;
+        if (kind == KIND_SINGLE && (llabs(a) > SINGLE_EXACT || llabs(b) > SINGLE_EXACT)) {
+            result.kind = kind;
+            return result;  // LONG operands may round when made SINGLE
+        }
+        return fold_number(opt, ast, node, result, value, kind);
+    }
+
+    // Identities, only between INTEGER values so the type stays the same
+    if (kind == KIND_INTEGER) {
+        const Operand *value = left->constant ? right : left;
+        AstIndex operand = left->constant ? ast->second[node] : ast->first[node];
+        int64_t c = left->constant ? a : b;
+
+        if (left->constant || right->constant) {
+            if (c == 0 && (op == '+' || (op == '-' && right->constant))) {
+                return replace(ast, node, operand, value);
+            }
+            if (c == 1 && op == '*') {
+                return replace(ast, node, operand, value);
+            }
+            // x*0 only for a variable, a longer x could overflow first
+            if (c == 0 && op == '*' && ast->type[operand] == AST_IDENTIFIER) {
+                return fold_number(opt, ast, node, result, 0, KIND_INTEGER);
+            }
+        }
+    }
+    result.kind = kind;
+    return result;
+}
+
+// Optimize an expression in one pass over its nodes: they are the
+// contiguous run from its leftmost leaf to its root, every operator after
+// its operands
+static void optimize_expression(Optimizer *opt, Ast *ast, AstIndex root) {
+    AstIndex start = root;
+
+    if (root == AST_NONE || ast->type[root] != AST_BINARY_OP) {
+        return;
+    }
+    while (ast->type[start] == AST_BINARY_OP) {
+        start = ast->first[start];
+    }
+
+    if (root - start + 1 > opt->operands_capacity) {
+        size_t capacity = opt->operands_capacity ? opt->operands_capacity : 64;
+        Operand *tmp;
+        while (capacity < root - start + 1) {
+            capacity *= 2;
+        }
+        tmp = allocator_resize(opt->allocator, opt->operands, sizeof(Operand) * capacity);
+        if (tmp == NULL) {
+            opt->error = ENOMEM;
+            return;
+        }
+        opt->operands = tmp;
+        opt->operands_capacity = capacity;
+    }
+
+    for (AstIndex node = start; node <= root && opt->error == 0; ++node) {
+        if (ast->type[node] != AST_BINARY_OP) {
+            opt->operands[node - start] = leaf(opt, ast, node);
+        } else {
+            opt->operands[node - start] = simplify(opt, ast, node,
+                &opt->operands[ast->first[node] - start], &opt->operands[ast->second[node] - start]);
+        }
+    }
+}
+
+// Optimize the expressions of a statement in one pass over its nodes
+// (statements come in source order, so variables are declared before
+// they are used); returns -1 when out of memory
+int optimize_statement(Optimizer *opt, Ast *ast) {
+    AstIndex expression;
+
+    for (AstIndex node = 0; node < ast->count && opt->error == 0; ++node) {
+        switch ((ASTNodeType)ast->type[node]) {
+            case AST_ASSIGN:
+                // Declarations are only folded with line numbers, blocks
+                // take the DIM type from the literal
+                expression = ast->second[node];
+                if (opt->numbered && expression != AST_NONE) {
+                    optimize_expression(opt, ast, expression);
+                }
+                if (ast->first[node] != AST_NONE && ast->type[ast->first[node]] == AST_IDENTIFIER
+                        && expression != AST_NONE) {
+                    ValueKind kind = KIND_UNKNOWN;
+                    if (ast->type[expression] == AST_NUMBER) {
+                        kind = KIND_INTEGER;
+                    } else if (ast->type[expression] == AST_STRING || ast->type[expression] == AST_IDENTIFIER) {
+                        kind = KIND_STRING;
+                    }
+                    if (declare(opt, ast, ast->first[node], kind) < 0) {
+                        opt->error = ENOMEM;
+                    }
+                }
+                break;
+            case AST_EQUALS:
+                optimize_expression(opt, ast, ast->second[node]);
+                break;
+            case AST_PRINT:
+            case AST_IF:
+            case AST_WHILE:
+                optimize_expression(opt, ast, ast->first[node]);
+                break;
+            default:
+                break;
+        }
+    }
+    return opt->error != 0 ? -1 : 0;
+}
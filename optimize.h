@@ -0,0 +1,40 @@
+/*
+ * optimize.h - Constant folding and simplification of expressions (-O).
+ *
+ * Author: Philip R. Simonson
+ * Date: 10/17/2026
+ *
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Declared Variable Structure (by symbol id)
+typedef struct {
+    ValueKind kind;
+    int declared;
+} OptimizerSymbol;
+
+// Operand Structure (what is known about the value of a node)
+typedef struct {
+    ValueKind kind;
+    int constant;
+    int64_t value;      // of numeric constants
+} Operand;
+
+// Optimizer Structure (lives as long as the translation, variables are
+// declared once and keep their type)
+typedef struct {
+    const struct Js2basAllocator *allocator;
+    struct Arena *arena;            // folded texts, of the current statement
+    int error;                      // ENOMEM once an allocation failed
+    int numbered;                   // GW-BASIC with line numbers, which has no '&'
+    OptimizerSymbol *symbols;       // by symbol id
+    size_t capacity;
+    Operand *operands;              // of the nodes of an expression
+    size_t operands_capacity;
+} Optimizer;
+
+void optimizer_init(Optimizer *opt, struct Arena *arena);
+void optimizer_free(Optimizer *opt);
+int optimize_statement(Optimizer *opt, struct Ast *ast);
@@ -11,616 +11,1529 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include "arena.h"
+#include "sink.h"
+#include "symbols.h"
 #include "token.h"
 #include "parse.h"
 
 // Error Handling
-void error(const char *message, Token *token) {
+static void error(const char *message, Parser *p) {
+    Lexer *lex = p->lex;
+    Token *token = peek_token(lex, 0);
     if (token->type == TOKEN_EOF) {
-        fprintf(stderr, "Error: %s at end of input.\n", message);
+        sink_printf(p->diag, "Error: %s at end of input.\n", message);
     } else {
-        fprintf(stderr, "Error: %s at '%s' (line %d).\n", message, token->lexeme, token->line);
-    }
-}
-
-// Parse Expressions
-ASTNode *parse_expression(Token **tokens) {
-    ASTNode *node = malloc(sizeof(ASTNode));
-    if (node == NULL) exit(1);  // Memory allocation check
-
-    if ((*tokens)->type == TOKEN_NUMBER) {
-        node->type = AST_NUMBER;
-        node->as.number.value = (*tokens)->lexeme;
-        (*tokens)++;
-    } else if ((*tokens)->type == TOKEN_STRING) {
-	node->type = AST_STRING;
-	node->as.string.value = (*tokens)->lexeme;
-	(*tokens)++;
-    } else if ((*tokens)->type == TOKEN_IDENTIFIER) {
-	node->type = AST_IDENTIFIER;
-	node->as.string.value = (*tokens)->lexeme;
-	(*tokens)++;
-    } else {
-        error("Expected a number or identifier or string", *tokens);
-        free(node);
-        return NULL;  // Return null if expression is not valid
+        sink_printf(p->diag, "Error: %s at '%.*s' (line %u).\n", message, (int)token->length, token_text(lex, token), (unsigned)token->line);
+    }
+}
+
+// Report running out of memory (once), the parse then fails
+static void out_of_memory(Parser *p) {
+    if (p->error == 0) {
+        sink_literal(p->diag, "Out of memory!\n");
+        p->error = ENOMEM;
+    }
+}
+
+// Add a node to the syntax tree (growing the arrays only when full)
+static AstIndex new_node(Parser *p, ASTNodeType type, AstIndex first) {
+    Ast *ast = &p->ast;
+    AstIndex node;
+
+    if (ast->count < ast->capacity) {
+        node = ast->count++;
+        ast->type[node] = type;
+        ast->op[node] = 0;
+        ast->first[node] = first;
+        ast->second[node] = AST_NONE;
+        return node;
+    }
+    node = ast_node(ast, type, first, AST_NONE);
+    if (node == AST_NONE) {
+        out_of_memory(p);  // Memory allocation check
+    }
+    return node;
+}
+
+// Add a leaf node for the lexeme of the current token and skip it (an
+// identifier is interned and gets its symbol id, tokens stay 12 bytes)
+static AstIndex take_leaf(Parser *p, ASTNodeType type) {
+    Token *token = peek_token(p->lex, 0);
+    Ast *ast = &p->ast;
+    AstIndex text;
+
+    if (type == AST_IDENTIFIER) {
+        text = symbol_intern(p->lex->symbols, token_text(p->lex, token), token->length);
+        if (text == SYMBOL_NONE) {
+            out_of_memory(p);
+            return AST_NONE;
+        }
+    } else if (ast->texts < ast->texts_capacity) {
+        text = ast->texts++;
+        ast->text[text] = token_text(p->lex, token);
+        ast->length[text] = token->length;
+    } else if ((text = ast_text(ast, token_text(p->lex, token), token->length)) == AST_NONE) {
+        out_of_memory(p);
+        return AST_NONE;
+    }
+    next_token(p->lex);
+    return new_node(p, type, text);
+}
+
+// Push a parsed statement onto the scratch stack
+static int push_child(Parser *p, AstIndex child) {
+    if (p->top == p->capacity) {
+        size_t capacity = p->capacity ? p->capacity * 2 : 64;
+        AstIndex *tmp = allocator_resize(p->arena->allocator, p->stack, sizeof(AstIndex) * capacity);
+        if (tmp == NULL) {
+            out_of_memory(p);
+            return -1;
+        }
+        p->stack = tmp;
+        p->capacity = capacity;
+    }
+    p->stack[p->top++] = child;
+    return 0;
+}
+
+// Move statements pushed since mark into a range of the syntax tree
+static int pop_children(Parser *p, size_t mark, AstIndex range) {
+    int result = ast_children(&p->ast, range, p->stack + mark, p->top - mark);
+
+    if (result < 0) {
+        out_of_memory(p);  // Memory allocation check
+    }
+    p->top = mark;
+    return result;
+}
+
+// Grow an array of a syntax tree to capacity elements
+static void *grow_array(const Ast *ast, void *array, uint32_t capacity, size_t size) {
+    return allocator_resize(ast->allocator, array, size * capacity);
+}
+
+// Next capacity of an array holding count elements, 0 once indices run out
+static uint32_t next_capacity(uint32_t capacity, uint32_t minimum) {
+    if (capacity == 0) {
+        return minimum;
+    }
+    return capacity < AST_NONE / 2 ? capacity * 2 : 0;
+}
+
+// Initialize an empty syntax tree
+void ast_init(Ast *ast, const struct Js2basAllocator *allocator) {
+    memset(ast, 0, sizeof(Ast));
+    ast->allocator = allocator;
+}
+
+// Drop every node, keeping the arrays for the next statement
+void ast_reset(Ast *ast) {
+    ast->count = 0;
+    ast->texts = 0;
+    ast->children_count = 0;
+    ast->ranges_count = 0;
+}
+
+// Free the arrays of a syntax tree
+void ast_free(Ast *ast) {
+    const struct Js2basAllocator *allocator = ast->allocator;
+
+    allocator_free(allocator, ast->type);
+    allocator_free(allocator, ast->op);
+    allocator_free(allocator, ast->first);
+    allocator_free(allocator, ast->second);
+    allocator_free(allocator, ast->text);
+    allocator_free(allocator, ast->length);
+    allocator_free(allocator, ast->children);
+    allocator_free(allocator, ast->ranges);
+    ast_init(ast, allocator);
+}
+
+// Add a node, returns its index or AST_NONE when out of memory
+AstIndex ast_node(Ast *ast, ASTNodeType type, AstIndex first, AstIndex second) {
+    if (ast->count == ast->capacity) {
+        uint32_t capacity = next_capacity(ast->capacity, 256);
+        void *tmp;
+
+        if (capacity == 0) {
+            return AST_NONE;
+        }
+        if ((tmp = grow_array(ast, ast->type, capacity, sizeof(uint8_t))) == NULL) {
+            return AST_NONE;
+        }
+        ast->type = tmp;
+        if ((tmp = grow_array(ast, ast->op, capacity, sizeof(char))) == NULL) {
+            return AST_NONE;
+        }
+        ast->op = tmp;
+        if ((tmp = grow_array(ast, ast->first, capacity, sizeof(AstIndex))) == NULL) {
+            return AST_NONE;
+        }
+        ast->first = tmp;
+        if ((tmp = grow_array(ast, ast->second, capacity, sizeof(AstIndex))) == NULL) {
+            return AST_NONE;
+        }
+        ast->second = tmp;
+        ast->capacity = capacity;
+    }
+    ast->type[ast->count] = type;
+    ast->op[ast->count] = 0;
+    ast->first[ast->count] = first;
+    ast->second[ast->count] = second;
+    return ast->count++;
+}
+
+// Add the text of a leaf, returns its index or AST_NONE when out of memory
+AstIndex ast_text(Ast *ast, const char *text, uint32_t length) {
+    if (ast->texts == ast->texts_capacity) {
+        uint32_t capacity = next_capacity(ast->texts_capacity, 256);
+        void *tmp;
+
+        if (capacity == 0) {
+            return AST_NONE;
+        }
+        if ((tmp = grow_array(ast, (void *)ast->text, capacity, sizeof(const char *))) == NULL) {
+            return AST_NONE;
+        }
+        ast->text = tmp;
+        if ((tmp = grow_array(ast, ast->length, capacity, sizeof(uint32_t))) == NULL) {
+            return AST_NONE;
+        }
+        ast->length = tmp;
+        ast->texts_capacity = capacity;
+    }
+    ast->text[ast->texts] = text;
+    ast->length[ast->texts] = length;
+    return ast->texts++;
+}
+
+// Add count empty ranges, returns the index of the first or AST_NONE
+AstIndex ast_ranges(Ast *ast, uint32_t count) {
+    AstIndex first = ast->ranges_count;
+
+    while (ast->ranges_capacity - ast->ranges_count < count) {
+        uint32_t capacity = next_capacity(ast->ranges_capacity, 64);
+        AstRange *tmp;
+
+        if (capacity == 0) {
+            return AST_NONE;
+        }
+        if ((tmp = grow_array(ast, ast->ranges, capacity, sizeof(AstRange))) == NULL) {
+            return AST_NONE;
+        }
+        ast->ranges = tmp;
+        ast->ranges_capacity = capacity;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        ast->ranges[ast->ranges_count++] = (AstRange){ 0, 0 };
+    }
+    return first;
+}
+
+// Copy the statements of a block into range, returns -1 when out of memory
+int ast_children(Ast *ast, AstIndex range, const AstIndex *statements, uint32_t count) {
+    while (ast->children_capacity - ast->children_count < count) {
+        uint32_t capacity = next_capacity(ast->children_capacity, 256);
+        AstIndex *tmp;
+
+        if (capacity == 0) {
+            return -1;
+        }
+        if ((tmp = grow_array(ast, ast->children, capacity, sizeof(AstIndex))) == NULL) {
+            return -1;
+        }
+        ast->children = tmp;
+        ast->children_capacity = capacity;
+    }
+    if (count > 0) {
+        memcpy(ast->children + ast->children_count, statements, sizeof(AstIndex) * count);
+    }
+    ast->ranges[range] = (AstRange){ ast->children_count, count };
+    ast->children_count += count;
+    return 0;
+}
+
+// Initialize parser reading from lexer and allocating from arena
+void parser_init(Parser *p, Lexer *lex, Arena *arena, Sink *diag) {
+    memset(p, 0, sizeof(Parser));
+    p->lex = lex;
+    p->arena = arena;
+    p->diag = diag;
+    ast_init(&p->ast, arena->allocator);
+}
+
+// Free parser scratch space and syntax tree
+void parser_free(Parser *p) {
+    ast_free(&p->ast);
+    allocator_free(p->arena->allocator, p->stack);
+    allocator_free(p->arena->allocator, p->operators);
+    allocator_free(p->arena->allocator, p->blocks);
+    p->stack = NULL;
+    p->operators = NULL;
+    p->blocks = NULL;
+    p->top = p->capacity = 0;
+    p->operators_top = p->operators_capacity = 0;
+    p->blocks_top = p->blocks_capacity = 0;
+}
+
+// How much looser than '*' and '/' an operator binds; a table, since the
+// generator asks for both sides of every operator
+static const unsigned char looseness[256] = {
+    [','] = 3,  // separates PRINT items
+    ['<'] = 2, ['>'] = 2, ['='] = 2,
+    ['+'] = 1, ['-'] = 1,
+};
+
+// Binding strength of a binary operator, higher binds tighter (the same
+// as BASIC, so the tree prints back without extra parentheses)
+static int precedence(char op) {
+    return 3 - looseness[(unsigned char)op];
+}
+
+// Push a pending operator (0 for an open parenthesis)
+static int push_operator(Parser *p, char op) {
+    if (p->operators_top == p->operators_capacity) {
+        size_t capacity = p->operators_capacity ? p->operators_capacity * 2 : 64;
+        char *tmp = allocator_resize(p->arena->allocator, p->operators, capacity);
+        if (tmp == NULL) {
+            out_of_memory(p);
+            return -1;
+        }
+        p->operators = tmp;
+        p->operators_capacity = capacity;
+    }
+    p->operators[p->operators_top++] = op;
+    return 0;
+}
+
+// Make a node of the top pending operator and its two operands (so
+// operands always come before their operator)
+static int reduce(Parser *p) {
+    AstIndex node = new_node(p, AST_BINARY_OP, AST_NONE);
+
+    if (node == AST_NONE) {
+        return -1;
+    }
+    p->ast.op[node] = p->operators[--p->operators_top];
+    p->ast.second[node] = p->stack[--p->top];
+    p->ast.first[node] = p->stack[p->top - 1];
+    p->stack[p->top - 1] = node;
+    return 0;
+}
+
+// Parse Expressions (precedence climbing on explicit stacks, so neither
+// long expressions nor deep parentheses use up the native stack)
+AstIndex parse_expression(Parser *p) {
+    size_t mark = p->top, base = p->operators_top;
+    size_t groups = 0;
+    AstIndex node;
+    Token *token;
+    char op;
+
+    for (;;) {
+        // Operand, after any opening parentheses
+        token = peek_token(p->lex, 0);
+        if (token->type == TOKEN_LPAREN) {
+            if (push_operator(p, 0) < 0) {
+                goto fail;
+            }
+            groups++;
+            next_token(p->lex);
+            continue;
+        }
+        if (token->type != TOKEN_NUMBER && token->type != TOKEN_STRING && token->type != TOKEN_IDENTIFIER) {
+            error("Expected a number or identifier or string", p);
+            goto fail;
+        }
+        node = take_leaf(p, token->type == TOKEN_NUMBER ? AST_NUMBER : token->type == TOKEN_STRING ? AST_STRING : AST_IDENTIFIER);
+        if (node == AST_NONE || push_child(p, node) < 0) {
+            goto fail;
+        }
+
+        // Closing parentheses of this expression, then an operator or the end
+        token = peek_token(p->lex, 0);
+        while (token->type == TOKEN_RPAREN && groups > 0) {
+            while (p->operators[p->operators_top - 1] != 0) {
+                if (reduce(p) < 0) {
+                    goto fail;
+                }
+            }
+            p->operators_top--;
+            groups--;
+            next_token(p->lex);
+            token = peek_token(p->lex, 0);
+        }
+        if (token->type != TOKEN_OPERATOR) {
+            break;
+        }
+
+        op = token_text(p->lex, token)[0];  // '=' stands for ==
+        while (p->operators_top > base && p->operators[p->operators_top - 1] != 0
+                && precedence(p->operators[p->operators_top - 1]) >= precedence(op)) {
+            if (reduce(p) < 0) {  // Left to right within a level
+                goto fail;
+            }
+        }
+        if (push_operator(p, op) < 0) {
+            goto fail;
+        }
+        next_token(p->lex);
     }
 
-    if ((*tokens)->type == TOKEN_OPERATOR) {
-        char *op = (*tokens)->lexeme;
-        (*tokens)++;
-        ASTNode *right = parse_expression(tokens);
-        if (right == NULL) {
-            free(node);
-            return NULL;
+    if (groups > 0) {
+        error("Expected ')'", p);
+        goto fail;
+    }
+    while (p->operators_top > base) {
+        if (reduce(p) < 0) {
+            goto fail;
         }
-        ASTNode *binary_op_node = malloc(sizeof(ASTNode));
-        if (binary_op_node == NULL) exit(1);  // Memory allocation check
-        binary_op_node->type = AST_BINARY_OP;
-        binary_op_node->as.binary_op.left = node;
-        binary_op_node->as.binary_op.right = right;
-        binary_op_node->as.binary_op.op = op;
-        return binary_op_node;
     }
+    node = p->stack[mark];
+    p->top = mark;
 
     // Check for statement terminator
-    if ((*tokens)->type == TOKEN_SEMICOLON) {
-	(*tokens)++; // Skip ';'
+    if (peek_token(p->lex, 0)->type == TOKEN_SEMICOLON) {
+	next_token(p->lex); // Skip ';'
     }
 
     return node;
+
+fail:
+    p->top = mark;
+    p->operators_top = base;
+    return AST_NONE;
 }
 
-// Parse If Statements
-ASTNode *parse_if_statement(Token **tokens) {
-    ASTNode *node = malloc(sizeof(ASTNode));
-    if (node == NULL) exit(1);  // Memory allocation check
-    node->type = AST_IF;
+// Parse the head of an if statement up to its opening brace (the
+// branches are parsed by parse_statement())
+AstIndex parse_if_statement(Parser *p) {
+    AstIndex node = new_node(p, AST_IF, AST_NONE), condition, ranges;
+    if (node == AST_NONE) {
+        return AST_NONE;
+    }
 
-    (*tokens)++;  // Skip 'if'
-    if ((*tokens)->type == TOKEN_LPAREN) {
-        (*tokens)++;  // Skip '('
-        node->as.if_stmt.condition = parse_expression(tokens);
-        if (node->as.if_stmt.condition == NULL) {
-            error("Invalid condition in if statement", *tokens);
-            free(node);
-            return NULL;  // Error in parsing condition
+    next_token(p->lex);  // Skip 'if'
+    if (peek_token(p->lex, 0)->type == TOKEN_LPAREN) {
+        next_token(p->lex);  // Skip '('
+        condition = parse_expression(p);
+        if (condition == AST_NONE) {
+            error("Invalid condition in if statement", p);
+            return AST_NONE;  // Error in parsing condition
         }
-        if ((*tokens)->type == TOKEN_RPAREN) {
-            (*tokens)++;  // Skip ')'
+        p->ast.first[node] = condition;
+        if (peek_token(p->lex, 0)->type == TOKEN_RPAREN) {
+            next_token(p->lex);  // Skip ')'
         } else {
-            error("Expected ')' after if condition", *tokens);
-            free(node);
-            return NULL;  // Error: expected closing parenthesis
+            error("Expected ')' after if condition", p);
+            return AST_NONE;  // Error: expected closing parenthesis
         }
     } else {
-        error("Expected '(' after 'if'", *tokens);
-        free(node);
-        return NULL;  // Error: expected opening parenthesis
-    }
-
-    node->as.if_stmt.then_count = 0;
-    node->as.if_stmt.then_branch = NULL;
-
-    if ((*tokens)->type == TOKEN_LBRACE) {
-        (*tokens)++;
-
-	while((*tokens)->type != TOKEN_RBRACE && (*tokens)->type != TOKEN_EOF) {
-		ASTNode **tmp = (ASTNode**)realloc(node->as.if_stmt.then_branch, sizeof(ASTNode*) * (node->as.if_stmt.then_count+2));
-	        if (tmp == NULL) {
-	            fprintf(stderr, "Out of memory!\n");
-	            free(node);
-	            return NULL;  // Error out of memory
-	        }
-		node->as.if_stmt.then_branch = tmp;
-	        node->as.if_stmt.then_branch[node->as.if_stmt.then_count] = parse_statement(tokens);
-	        if (node->as.if_stmt.then_branch[node->as.if_stmt.then_count] == NULL) {
-	            error("Invalid statement in then branch", *tokens);
-	            free(node);
-	            return NULL;  // Error in parsing then branch
-	        }
-		node->as.if_stmt.then_count++;
-	        node->as.if_stmt.then_branch[node->as.if_stmt.then_count] = NULL;
-
-		// Check for statement termination
-		if ((*tokens)->type == TOKEN_SEMICOLON) {
-			(*tokens)++; // Skip ';'
-		}
-	}
+        error("Expected '(' after 'if'", p);
+        return AST_NONE;  // Error: expected opening parenthesis
+    }
 
-	if ((*tokens)->type == TOKEN_RBRACE) {
-	       (*tokens)++;
-	} else {
-	       error("Expected '}' after then branch", *tokens);
-	       free(node);
-	       return NULL;  // Error: expected closing brace
-	}
+    if ((ranges = ast_ranges(&p->ast, 2)) == AST_NONE) {
+        out_of_memory(p);
+        return AST_NONE;
+    }
+    p->ast.second[node] = ranges;  // then and else branch
+
+    if (peek_token(p->lex, 0)->type == TOKEN_LBRACE) {
+        next_token(p->lex);
     } else {
-        error("Expected '{' after if condition", *tokens);
-        free(node);
-        return NULL;  // Error: expected opening brace
-    }
-
-    node->as.if_stmt.else_count = 0;
-    node->as.if_stmt.else_branch = NULL;
-
-    if ((*tokens)->type == TOKEN_ELSE) {
-        (*tokens)++; // Skip 'else'
-
-	if ((*tokens)->type == TOKEN_LBRACE) {
-                (*tokens)++; // Skip '{'
-
-		while((*tokens)->type != TOKEN_RBRACE && (*tokens)->type != TOKEN_EOF) {
-			ASTNode **tmp = (ASTNode**)realloc(node->as.if_stmt.else_branch, sizeof(ASTNode*) * (node->as.if_stmt.else_count+2));
-		        if (tmp == NULL) {
-		            fprintf(stderr, "Out of memory!\n");
-		            free(node);
-		            return NULL;  // Error out of memory
-		        }
-			node->as.if_stmt.else_branch = tmp;
-		        node->as.if_stmt.else_branch[node->as.if_stmt.else_count] = parse_statement(tokens);
-			if (node->as.if_stmt.else_branch[node->as.if_stmt.else_count] == NULL) {
-	                	error("Invalid statement in else branch", *tokens);
-	                	free(node);
-	                	return NULL;  // Error in parsing else branch
-	            	}
-			node->as.if_stmt.else_count++;
-			node->as.if_stmt.else_branch[node->as.if_stmt.else_count] = NULL;
-
-			// Check for statement termination
-			if ((*tokens)->type == TOKEN_SEMICOLON) {
-				(*tokens)++; // Skip ';'
-			}
-		}
+        error("Expected '{' after if condition", p);
+        return AST_NONE;  // Error: expected opening brace
+    }
+    return node;
+}
+
+// Push a block whose statements are being parsed
+static int push_block(Parser *p, AstIndex node, int part) {
+    if (p->blocks_top == p->blocks_capacity) {
+        size_t capacity = p->blocks_capacity ? p->blocks_capacity * 2 : 16;
+        ParserBlock *tmp = allocator_resize(p->arena->allocator, p->blocks, sizeof(ParserBlock) * capacity);
+        if (tmp == NULL) {
+            out_of_memory(p);
+            return -1;
+        }
+        p->blocks = tmp;
+        p->blocks_capacity = capacity;
+    }
+    p->blocks[p->blocks_top++] = (ParserBlock){ node, p->top, part };
+    return 0;
+}
+
+// Close the innermost block at its '}', returns 1 when an else branch
+// follows in the same block, 0 when the statement is complete, -1 on error
+static int close_block(Parser *p, ParserBlock *block) {
+    AstIndex range = p->ast.second[block->node];
+
+    if (block->part == BLOCK_BODY) {
+        if (pop_children(p, block->mark, range) < 0) {
+            return -1;
+        }
+        if (peek_token(p->lex, 0)->type == TOKEN_RBRACE) {
+            next_token(p->lex);
+        } else {
+            error("Expected '}' after while body", p);
+            return -1;  // Error: expected closing brace
+        }
+    } else if (block->part == BLOCK_THEN) {
+        if (pop_children(p, block->mark, range) < 0) {
+            return -1;
+        }
+        if (peek_token(p->lex, 0)->type == TOKEN_RBRACE) {
+            next_token(p->lex);
+        } else {
+            error("Expected '}' after then branch", p);
+            return -1;  // Error: expected closing brace
+        }
 
-	        if ((*tokens)->type == TOKEN_RBRACE) {
-	        	(*tokens)++; // Skip '}'
-	        } else {
-	               	error("Expected '}' after else branch", *tokens);
-	               	free(node);
-	               	return NULL;  // Error: expected closing brace
-	        }
+        if (peek_token(p->lex, 0)->type == TOKEN_ELSE) {
+            next_token(p->lex); // Skip 'else'
+            if (peek_token(p->lex, 0)->type == TOKEN_LBRACE) {
+                next_token(p->lex); // Skip '{'
+                block->part = BLOCK_ELSE;
+                block->mark = p->top;
+                return 1;
+            }
+            error("Expected '{' after else keyword", p);
+            return -1;  // Error: expected opening brace
+        }
+    } else {
+        if (pop_children(p, block->mark, range + 1) < 0) {
+            return -1;
+        }
+        if (peek_token(p->lex, 0)->type == TOKEN_RBRACE) {
+            next_token(p->lex); // Skip '}'
         } else {
-            error("Expected '{' after else keyword", *tokens);
-            free(node);
-            return NULL;  // Error: expected opening brace
+            error("Expected '}' after else branch", p);
+            return -1;  // Error: expected closing brace
         }
     }
 
     // Check for statement terminator
-    if ((*tokens)->type == TOKEN_SEMICOLON) {
-        (*tokens)++; // Skip ';'
+    if (peek_token(p->lex, 0)->type == TOKEN_SEMICOLON) {
+        next_token(p->lex); // Skip ';'
     }
-
-    return node;
+    return 0;
 }
 
 // Forward Declarations
-ASTNode *parse_expression(Token **tokens);
-ASTNode *parse_statement(Token **tokens);
-ASTNode *parse_while_statement(Token **tokens);
-ASTNode *parse_input_statement(Token **tokens);
-ASTNode *parse_variable_statement(Token **tokens);
-
-// Parse Statements
-ASTNode *parse_statement(Token **tokens) {
-    if ((*tokens)->type == TOKEN_IF) {
-        return parse_if_statement(tokens);
-    } else if ((*tokens)->type == TOKEN_ASSIGN) {
-	return parse_variable_statement(tokens);
-    } else if ((*tokens)->type == TOKEN_WHILE) {
-	return parse_while_statement(tokens);
-    } else if ((*tokens)->type == TOKEN_REM) {
-	ASTNode *node = malloc(sizeof(ASTNode));
-	if (node == NULL) exit(1); // Memory allocation check
-	node->type = AST_REM;
-	node->as.string.value = (*tokens)->lexeme;
-	(*tokens)++; // Skip REM
-	return node;
-    } else if ((*tokens)->type == TOKEN_EXIT) {
-	ASTNode *node = malloc(sizeof(ASTNode));
-	if (node == NULL) exit(1); // Memory allocation check
-	node->type = AST_EXIT;
-	node->as.string.value = NULL;
-	(*tokens)++; // Skip 'break'
+AstIndex parse_expression(Parser *p);
+AstIndex parse_statement(Parser *p);
+AstIndex parse_while_statement(Parser *p);
+AstIndex parse_input_statement(Parser *p);
+AstIndex parse_variable_statement(Parser *p);
+
+// Parse one statement, or only the head of an if or while statement
+static AstIndex parse_single(Parser *p) {
+    if (peek_token(p->lex, 0)->type == TOKEN_IF) {
+        return parse_if_statement(p);
+    } else if (peek_token(p->lex, 0)->type == TOKEN_ASSIGN) {
+	return parse_variable_statement(p);
+    } else if (peek_token(p->lex, 0)->type == TOKEN_WHILE) {
+	return parse_while_statement(p);
+    } else if (peek_token(p->lex, 0)->type == TOKEN_REM) {
+	return take_leaf(p, AST_REM); // Skip REM
+    } else if (peek_token(p->lex, 0)->type == TOKEN_EXIT) {
+	AstIndex node = new_node(p, AST_EXIT, AST_NONE);
+	if (node == AST_NONE) {
+		return AST_NONE;
+	}
+	next_token(p->lex); // Skip 'break'
 	
 	// Check for statement terminator
-	if ((*tokens)->type == TOKEN_SEMICOLON) {
-	    (*tokens)++; // Skip ';'
+	if (peek_token(p->lex, 0)->type == TOKEN_SEMICOLON) {
+	    next_token(p->lex); // Skip ';'
 	}
 
 	return node;
-    } else if ((*tokens)->type == TOKEN_IDENTIFIER) {
-	return parse_input_statement(tokens);
-    } else if ((*tokens)->type == TOKEN_PRINT) {
-        ASTNode *node = malloc(sizeof(ASTNode));
-        if (node == NULL) exit(1);  // Memory allocation check
-        node->type = AST_PRINT;
-        (*tokens)++;  // Skip 'print'
-        node->as.print_stmt.expression = parse_expression(tokens);
-        if (node->as.print_stmt.expression == NULL) {
-            error("Invalid expression in print statement", *tokens);
-            free(node);
-            return NULL;  // Error in parsing print statement
+    } else if (peek_token(p->lex, 0)->type == TOKEN_IDENTIFIER) {
+	return parse_input_statement(p);
+    } else if (peek_token(p->lex, 0)->type == TOKEN_PRINT) {
+        AstIndex node = new_node(p, AST_PRINT, AST_NONE), expression;
+        if (node == AST_NONE) {
+            return AST_NONE;
+        }
+        next_token(p->lex);  // Skip 'print'
+        expression = parse_expression(p);
+        if (expression == AST_NONE) {
+            error("Invalid expression in print statement", p);
+            return AST_NONE;  // Error in parsing print statement
         }
+        p->ast.first[node] = expression;
 
 	// Check for statement terminator
-	if ((*tokens)->type == TOKEN_SEMICOLON) {
-	    (*tokens)++; // Skip ';'
+	if (peek_token(p->lex, 0)->type == TOKEN_SEMICOLON) {
+	    next_token(p->lex); // Skip ';'
 	}
 
         return node;
     } else {
-        return parse_expression(tokens);
+        return parse_expression(p);
     }
 }
 
-// Parse while statement
-ASTNode *parse_while_statement(Token **tokens)
-{
-	ASTNode *node = malloc(sizeof(ASTNode));
-	if (node == NULL) exit(1); // Memory allocation check
-	node->type = AST_WHILE;
-	node->as.while_stmt.body = NULL;
-
-	(*tokens)++; // Skip 'while'
-	if ((*tokens)->type == TOKEN_LPAREN) {
-		(*tokens)++; // Skip '('
-		node->as.while_stmt.condition = parse_expression(tokens);
-		if (node->as.while_stmt.condition == NULL) {
-			error("Invalid condition in while statement", *tokens);
-			free(node);
-			return NULL; // Error in parsing condition
-		}
-		if ((*tokens)->type == TOKEN_RPAREN) {
-			(*tokens)++; // Skip ')'
-		} else {
-			error("Expected ')' after while condition", *tokens);
-			free(node);
-			return NULL;
-		}
-	} else {
-		error("Expected '(' after 'while'", *tokens);
-		free(node);
-		return NULL; // Error: expected opening parenthesis
-	}
+// Parse Statements (open blocks are kept on an explicit stack, so deep
+// nesting costs no native stack)
+AstIndex parse_statement(Parser *p) {
+    size_t base = p->blocks_top;
+    AstIndex node;
+    int quiet = 0;
 
-	node->as.while_stmt.body_count = 0;
-	node->as.while_stmt.body = NULL;
+    ast_reset(&p->ast);  // Drop the previous statement
+    p->ast.symbols = p->lex->symbols;
 
-	if ((*tokens)->type == TOKEN_LBRACE) {
-		(*tokens)++;
+    for (;;) {
+        if (p->blocks_top > base) {
+            TokenType type = peek_token(p->lex, 0)->type;
+            if (type == TOKEN_RBRACE || type == TOKEN_EOF) {
+                int closed = close_block(p, &p->blocks[p->blocks_top - 1]);
+                if (closed < 0) {
+                    quiet = 1;
+                    goto fail;
+                }
+                if (closed > 0) {
+                    continue;  // on to the else branch
+                }
+                node = p->blocks[--p->blocks_top].node;
+                goto complete;
+            }
+        }
 
-		while((*tokens)->type != TOKEN_RBRACE && (*tokens)->type != TOKEN_EOF) {
-			ASTNode **tmp = (ASTNode**)realloc(node->as.while_stmt.body, sizeof(ASTNode*) * (node->as.while_stmt.body_count + 2));
-			if(tmp == NULL) {
-				fprintf(stderr, "Out of memory!\n");
-				free(node);
-				return NULL;
-			}
-			node->as.while_stmt.body = tmp;
-			node->as.while_stmt.body[node->as.while_stmt.body_count] = parse_statement(tokens);
-			if (node->as.while_stmt.body[node->as.while_stmt.body_count] == NULL) {
-				error("Invalid statement in while body", *tokens);
-				free(node);
-				return NULL; // Error in parsing while body
-			}
-			node->as.while_stmt.body_count++;
-			node->as.while_stmt.body[node->as.while_stmt.body_count] = NULL;
-			// Check for statement terminator
-			if ((*tokens)->type == TOKEN_SEMICOLON) {
-			    (*tokens)++; // Skip ';'
-			}
+        node = parse_single(p);
+        if (node == AST_NONE) {
+            goto fail;
+        }
+        if (p->ast.type[node] == AST_IF || p->ast.type[node] == AST_WHILE) {
+            if (push_block(p, node, p->ast.type[node] == AST_IF ? BLOCK_THEN : BLOCK_BODY) < 0) {
+                goto fail;
+            }
+            continue;
+        }
 
-		}
+    complete:
+        if (p->blocks_top == base) {
+            return node;
+        }
+        if (push_child(p, node) < 0) {
+            quiet = 1;
+            goto fail;
+        }
+
+        // Check for statement termination
+        if (peek_token(p->lex, 0)->type == TOKEN_SEMICOLON) {
+            next_token(p->lex); // Skip ';'
+        }
+    }
 
-		if ((*tokens)->type == TOKEN_RBRACE) {
-			(*tokens)++;
+fail:
+    // Every open block reports the statement that failed in it, except
+    // one that failed itself
+    while (p->blocks_top > base) {
+        ParserBlock *block = &p->blocks[--p->blocks_top];
+        if (!quiet) {
+            error(block->part == BLOCK_THEN ? "Invalid statement in then branch"
+                : block->part == BLOCK_ELSE ? "Invalid statement in else branch"
+                : "Invalid statement in while body", p);
+        }
+        quiet = 0;
+        p->top = block->mark;
+    }
+    return AST_NONE;
+}
+
+// Parse the head of a while statement up to its opening brace (the body
+// is parsed by parse_statement())
+AstIndex parse_while_statement(Parser *p)
+{
+	AstIndex node = new_node(p, AST_WHILE, AST_NONE), condition, range;
+	if (node == AST_NONE) {
+		return AST_NONE;
+	}
+
+	next_token(p->lex); // Skip 'while'
+	if (peek_token(p->lex, 0)->type == TOKEN_LPAREN) {
+		next_token(p->lex); // Skip '('
+		condition = parse_expression(p);
+		if (condition == AST_NONE) {
+			error("Invalid condition in while statement", p);
+			return AST_NONE; // Error in parsing condition
+		}
+		p->ast.first[node] = condition;
+		if (peek_token(p->lex, 0)->type == TOKEN_RPAREN) {
+			next_token(p->lex); // Skip ')'
 		} else {
-			printf("%s\n", (*tokens)->lexeme);
-			error("Expected '}' after while body", *tokens);
-			free(node);
-			return NULL; // Error: expected closing brace
+			error("Expected ')' after while condition", p);
+			return AST_NONE;
 		}
 	} else {
-		error("Expected '{' after while condition", *tokens);
-		free(node);
-		return NULL; // Error: expected opening brace
+		error("Expected '(' after 'while'", p);
+		return AST_NONE; // Error: expected opening parenthesis
 	}
 
-	// Check for statement terminator
-	if ((*tokens)->type == TOKEN_SEMICOLON) {
-	    (*tokens)++; // Skip ';'
+	if ((range = ast_ranges(&p->ast, 1)) == AST_NONE) {
+		out_of_memory(p);
+		return AST_NONE;
 	}
+	p->ast.second[node] = range;  // body
 
+	if (peek_token(p->lex, 0)->type == TOKEN_LBRACE) {
+		next_token(p->lex);
+	} else {
+		error("Expected '{' after while condition", p);
+		return AST_NONE; // Error: expected opening brace
+	}
 	return node;
 }
 
 // Parse input statement
-ASTNode *parse_input_statement(Token **tokens)
+AstIndex parse_input_statement(Parser *p)
 {
-	ASTNode *node = malloc(sizeof(ASTNode));
-	if (node == NULL) exit(1); // Memory allocation check
+	AstIndex node = new_node(p, AST_EQUALS, AST_NONE);
+	if (node == AST_NONE) {
+		return AST_NONE;
+	}
 	
-	ASTNode *tmp = NULL;
-
-	if((*tokens)->type == TOKEN_IDENTIFIER) {
-		tmp = parse_expression(tokens);
-		if (tmp == NULL) {
-			error("Expected 'identifier'", *tokens);
-			free(node);
-			return NULL;
+	AstIndex tmp = AST_NONE, expression;
+
+	if(peek_token(p->lex, 0)->type == TOKEN_IDENTIFIER) {
+		tmp = parse_expression(p);
+		if (tmp == AST_NONE) {
+			error("Expected 'identifier'", p);
+			return AST_NONE;
 		}
 	} else {
-		error("Expected identifier", *tokens);
-		free(node);
-		return NULL;
+		error("Expected identifier", p);
+		return AST_NONE;
 	}
 
-	if((*tokens)->type == TOKEN_EQUALS) {
-		(*tokens)++; // Skip '='
+	if(peek_token(p->lex, 0)->type == TOKEN_EQUALS) {
+		next_token(p->lex); // Skip '='
 	} else {
-		error("Expected '=' after identifier", *tokens);
-		free(node);
-		return NULL;
+		error("Expected '=' after identifier", p);
+		return AST_NONE;
 	}
 
-	if((*tokens)->type == TOKEN_INPUT) {
-		node->type = AST_INPUT;
-		node->as.input_stmt.identifier = tmp;
-		(*tokens)++; // Skip 'input'
+	if(peek_token(p->lex, 0)->type == TOKEN_INPUT) {
+		p->ast.type[node] = AST_INPUT;
+		p->ast.second[node] = tmp;
+		next_token(p->lex); // Skip 'input'
 
-		if((*tokens)->type == TOKEN_LPAREN) {
-			(*tokens)++; // Skip '('
+		if(peek_token(p->lex, 0)->type == TOKEN_LPAREN) {
+			next_token(p->lex); // Skip '('
 
-			if((*tokens)->type == TOKEN_STRING) {
-				node->as.input_stmt.string = parse_expression(tokens);
+			if(peek_token(p->lex, 0)->type == TOKEN_STRING) {
+				expression = parse_expression(p);
+				p->ast.first[node] = expression;
+				if (p->error != 0) {
+					return AST_NONE;
+				}
 			} else {
-				error("Expected string", *tokens);
-				free(node);
-				return NULL;
+				error("Expected string", p);
+				return AST_NONE;
 			}
 
-			if((*tokens)->type == TOKEN_RPAREN) {
-				(*tokens)++; // Skip ')'
+			if(peek_token(p->lex, 0)->type == TOKEN_RPAREN) {
+				next_token(p->lex); // Skip ')'
 			} else {
-				error("Expected ')'", *tokens);
-				free(node);
-				return NULL;
+				error("Expected ')'", p);
+				return AST_NONE;
 			}
 		} else {
-			error("Expected '(' after '='", *tokens);
-			free(node);
-			return NULL;
+			error("Expected '(' after '='", p);
+			return AST_NONE;
 		}
 	} else {
-		node->type = AST_EQUALS;
-		node->as.assign_stmt.identifier = tmp;
-		node->as.assign_stmt.expression = parse_expression(tokens);
-		if (node->as.assign_stmt.expression == NULL) {
-			error("Expected number or string or identifier", *tokens);
-			free(node);
-			return NULL;
+		p->ast.first[node] = tmp;
+		expression = parse_expression(p);
+		if (expression == AST_NONE) {
+			error("Expected number or string or identifier", p);
+			return AST_NONE;
 		}
+		p->ast.second[node] = expression;
 	}
 
 	// Check for statement terminator
-	if ((*tokens)->type == TOKEN_SEMICOLON) {
-		(*tokens)++; // Skip ';'
+	if (peek_token(p->lex, 0)->type == TOKEN_SEMICOLON) {
+		next_token(p->lex); // Skip ';'
 	}
 
 	return node;
 }
 
 // Parse variables
-ASTNode *parse_variable_statement(Token **tokens)
+AstIndex parse_variable_statement(Parser *p)
 {
-	ASTNode *node = malloc(sizeof(ASTNode));
-	if (node == NULL) exit(1);  // Memory allocation check
-	node->type = AST_ASSIGN;
-	(*tokens)++; // Skip 'var'
+	AstIndex node = new_node(p, AST_ASSIGN, AST_NONE), expression;
+	if (node == AST_NONE) {
+		return AST_NONE;
+	}
+	next_token(p->lex); // Skip 'var'
 
-	if((*tokens)->type == TOKEN_IDENTIFIER) {
-  		node->as.assign_stmt.identifier = parse_expression(tokens);
+	if(peek_token(p->lex, 0)->type == TOKEN_IDENTIFIER) {
+  		expression = parse_expression(p);
+		p->ast.first[node] = expression;
+		if (p->error != 0) {
+			return AST_NONE;
+		}
 	} else {
-		error("Expected identifier", *tokens);
-		free(node);
-		return NULL;
+		error("Expected identifier", p);
+		return AST_NONE;
 	}
 
-	if((*tokens)->type == TOKEN_EQUALS) {
-		(*tokens)++; // Skip '='
+	if(peek_token(p->lex, 0)->type == TOKEN_EQUALS) {
+		next_token(p->lex); // Skip '='
 	}
 
-	if((*tokens)->type == TOKEN_NUMBER || (*tokens)->type == TOKEN_STRING) {
-		node->as.assign_stmt.expression = parse_expression(tokens);
+	if(peek_token(p->lex, 0)->type == TOKEN_NUMBER || peek_token(p->lex, 0)->type == TOKEN_STRING) {
+		expression = parse_expression(p);
+		p->ast.second[node] = expression;
 	} else {
-	    error("Invalid expression in variable statement", *tokens);
-	    free(node);
-	    return NULL;  // Error in parsing print statement
+	    error("Invalid expression in variable statement", p);
+	    return AST_NONE;  // Error in parsing print statement
 	}
 
 	return node;
 }
 
-// Generate GW-BASIC Code
-void generate_gwbasic_code(ASTNode *node, int depth) {
-    if (node == NULL) return;
-    if (depth < 0) return;
+// Expression Item (an operator whose operands are being printed)
+typedef struct {
+    AstIndex node;
+    char right;         // printing the right operand
+    char parens;        // the operand being printed is in parentheses
+} ExpressionItem;
 
-    switch (node->type) {
-        case AST_NUMBER:
-            printf("%s", node->as.number.value);
+// Number of items printed without allocating
+#define EXPRESSION_ITEMS 64
+
+// An operand needs parentheses when it binds looser than its operator,
+// or as loose on the right (operators group left to right)
+static int needs_parens(const Ast *ast, AstIndex op, AstIndex operand, int right) {
+    int outer, inner;
+
+    if (ast->type[operand] != AST_BINARY_OP) {
+        return 0;
+    }
+    outer = precedence(ast->op[op]);
+    inner = precedence(ast->op[operand]);
+    return inner < outer || (right && inner == outer);
+}
+
+// Flags of the generator
+#define GENERATE_NUMBERED 1     // line-numbered GW-BASIC
+#define GENERATE_COMPACT 2      // --compact: short names, no spaces around operators
+
+// Write an operator, with a space either side unless compact
+static void generate_operator(Sink *out, const char *op, size_t length, int flags) {
+    char spaced[4] = { ' ', op[0], op[length - 1], ' ' };
+
+    if (flags & GENERATE_COMPACT) {
+        sink_write(out, op, length);
+    } else if (length == 1) {
+        spaced[2] = ' ';
+        sink_write(out, spaced, 3);
+    } else {
+        sink_write(out, spaced, 4);  // operators are at most two characters
+    }
+}
+
+static void generate_simple(Sink *out, const Ast *ast, AstIndex node, int flags);
+
+// Generate an expression in order: the stack holds the operators whose
+// left operand is being printed, then the ones whose right operand is
+static void generate_expression(Sink *out, const Ast *ast, AstIndex node, int flags) {
+    ExpressionItem local[EXPRESSION_ITEMS], *stack = local;
+    size_t top = 0, capacity = EXPRESSION_ITEMS;
+
+    for (;;) {
+        // Down the left operands to the first leaf
+        while (ast->type[node] == AST_BINARY_OP) {
+            if (top == capacity) {
+                ExpressionItem *tmp = allocator_alloc(out->allocator, sizeof(ExpressionItem) * capacity * 2);
+                if (tmp == NULL) {
+                    out->error = ENOMEM;
+                    goto done;
+                }
+                memcpy(tmp, stack, sizeof(ExpressionItem) * top);
+                if (stack != local) {
+                    allocator_free(out->allocator, stack);
+                }
+                stack = tmp;
+                capacity *= 2;
+            }
+            stack[top] = (ExpressionItem){ node, 0, (char)needs_parens(ast, node, ast->first[node], 0) };
+            if (stack[top++].parens) {
+                sink_putc(out, '(');
+            }
+            node = ast->first[node];
+        }
+        generate_simple(out, ast, node, flags);
+
+        // Up past every operator whose right operand is done
+        while (top > 0 && stack[top - 1].right) {
+            if (stack[--top].parens) {
+                sink_putc(out, ')');
+            }
+        }
+        if (top == 0) {
             break;
-	case AST_STRING:
-	    printf("\"%s\"", node->as.string.value);
+        }
+
+        // The left operand is done, print the operator and go right
+        node = stack[top - 1].node;
+        if (stack[top - 1].parens) {
+            sink_putc(out, ')');
+        }
+        generate_operator(out, &ast->op[node], 1, flags);
+        stack[top - 1].right = 1;
+        stack[top - 1].parens = (char)needs_parens(ast, node, ast->second[node], 1);
+        if (stack[top - 1].parens) {
+            sink_putc(out, '(');
+        }
+        node = ast->second[node];
+    }
+
+done:
+    if (stack != local) {
+        allocator_free(out->allocator, stack);
+    }
+}
+
+// Walk Item (a node still to be visited)
+typedef struct {
+    AstIndex node;
+    size_t depth;
+} WalkItem;
+
+// Visit every node of a statement with its depth (1 for node itself); the
+// stack is taken from the arena, so deep trees need no native stack.
+// Returns -1 when out of memory.
+int ast_walk(const Ast *ast, AstIndex node, Arena *arena, void (*visit)(const Ast *ast, AstIndex node, size_t depth, void *user), void *user) {
+    AstIndex children[2];
+    const AstRange *ranges;
+    WalkItem *stack;
+    size_t top = 0, capacity = EXPRESSION_ITEMS;
+
+    if (node == AST_NONE) {
+        return 0;
+    }
+    if ((stack = arena_alloc(arena, sizeof(WalkItem) * capacity)) == NULL) {
+        return -1;
+    }
+    stack[top++] = (WalkItem){ node, 1 };
+
+    while (top > 0) {
+        WalkItem item = stack[--top];
+        size_t needed;
+        int blocks = 0;
+
+        node = item.node;
+        visit(ast, node, item.depth, user);
+
+        children[0] = children[1] = AST_NONE;
+        switch ((ASTNodeType)ast->type[node]) {
+            case AST_BINARY_OP:
+            case AST_INPUT:
+            case AST_ASSIGN:
+            case AST_EQUALS:
+                children[0] = ast->first[node];
+                children[1] = ast->second[node];
+                break;
+            case AST_IF:
+                children[0] = ast->first[node];
+                blocks = 2;
+                break;
+            case AST_WHILE:
+                children[0] = ast->first[node];
+                blocks = 1;
+                break;
+            case AST_PRINT:
+                children[0] = ast->first[node];
+                break;
+            default:
+                break;  // the leaves, their first is a text
+        }
+
+        ranges = blocks > 0 ? &ast->ranges[ast->second[node]] : NULL;
+        needed = top + 2;
+        for (int i = 0; i < blocks; ++i) {
+            needed += ranges[i].count;
+        }
+        if (needed > capacity) {
+            WalkItem *tmp;
+            while (capacity < needed) {
+                capacity *= 2;
+            }
+            if ((tmp = arena_alloc(arena, sizeof(WalkItem) * capacity)) == NULL) {
+                return -1;
+            }
+            memcpy(tmp, stack, sizeof(WalkItem) * top);
+            stack = tmp;
+        }
+
+        for (int i = 0; i < 2; ++i) {
+            if (children[i] != AST_NONE) {
+                stack[top++] = (WalkItem){ children[i], item.depth + 1 };
+            }
+        }
+        for (int i = 0; i < blocks; ++i) {
+            for (uint32_t j = 0; j < ranges[i].count; ++j) {
+                stack[top++] = (WalkItem){ ast->children[ranges[i].start + j], item.depth + 1 };
+            }
+        }
+    }
+    return 0;
+}
+
+// Write a variable name; GW-BASIC names may have '.' but not '_'
+static void generate_name(Sink *out, const char *name, uint32_t length) {
+    uint32_t start = 0;
+
+    for (uint32_t i = 0; i < length; ++i) {
+        if (name[i] == '_') {
+            sink_write(out, name + start, i - start);
+            sink_putc(out, '.');
+            start = i + 1;
+        }
+    }
+    sink_write(out, name + start, length - start);
+}
+
+// Write an inferred type
+static void generate_type(Sink *out, ValueKind kind) {
+    switch (kind) {
+        case KIND_INTEGER: sink_literal(out, "INTEGER"); break;
+        case KIND_LONG: sink_literal(out, "LONG"); break;
+        case KIND_SINGLE: sink_literal(out, "SINGLE"); break;
+        case KIND_DOUBLE: sink_literal(out, "DOUBLE"); break;
+        default: sink_literal(out, "STRING"); break;
+    }
+}
+
+// Generate a statement or expression without blocks (for the
+// line-numbered GW-BASIC target a declaration is an assignment)
+static void generate_simple(Sink *out, const Ast *ast, AstIndex node, int flags) {
+    char alias[SYMBOL_ALIAS_MAX];
+    const Symbol *symbol;
+    AstIndex expression;
+
+    if (node == AST_NONE) return;
+
+    switch ((ASTNodeType)ast->type[node]) {
+        case AST_NUMBER:
+	    sink_write(out, ast_leaf_text(ast, node), ast_leaf_length(ast, node));
 	    break;
 	case AST_IDENTIFIER:
-	    printf("%s", node->as.string.value);
-	    break;
-        case AST_BINARY_OP:
-            generate_gwbasic_code(node->as.binary_op.left, depth);
-	    if(strncmp(node->as.binary_op.op, "==", 2) == 0) {
-		    printf(" = ");
+	    symbol = ast_symbol(ast, node);
+	    if (flags & GENERATE_NUMBERED) {
+		    // GW-BASIC has no LONG, DOUBLE holds all of it exactly
+		    static const char suffixes[] = { 0, '%', '#', '!', '#', '$' };
+		    if (flags & GENERATE_COMPACT) {
+			    sink_write(out, alias, symbol_alias_name(symbol->alias, alias));
+		    } else {
+			    generate_name(out, symbol->name, symbol->length);
+		    }
+		    if (suffixes[symbol->kind] != 0) {
+			    sink_putc(out, suffixes[symbol->kind]);
+		    }
 	    } else {
-	            printf(" %s ", node->as.binary_op.op);
-	    }
-            generate_gwbasic_code(node->as.binary_op.right, depth);
-            break;
-        case AST_IF:
-            printf("IF ");
-            generate_gwbasic_code(node->as.if_stmt.condition, depth);
-            printf(" THEN");
-	    for(int i = 0; i < (depth + 1); ++i) {
-	    	printf("\t");
-	    }
-	    for(int i = 0; i < node->as.if_stmt.then_count; ++i) {
-		if (i < node->as.if_stmt.then_count) {
-			printf("\n");
-		}
-		for(int i = 0; i < (depth + 1); ++i) {
-			printf("\t");
-		}
-            	generate_gwbasic_code(node->as.if_stmt.then_branch[i], depth + 1);
-	    }
-            if (node->as.if_stmt.else_branch) {
-		printf("\n");
-		for(int i = 0; i < depth; ++i) {
-			printf("\t");
-		}
-                printf("ELSE");
-		for(int i = 0; i < node->as.if_stmt.else_count; ++i) {
-			if (i < node->as.if_stmt.else_count) {
-				printf("\n");
-			}
-			for(int i = 0; i < (depth + 1); ++i) {
-				printf("\t");
-			}
-                	generate_gwbasic_code(node->as.if_stmt.else_branch[i], depth + 1);
-		}
-            }
-	    printf("\n");
-	    for(int i = 0; i < depth; ++i) {
-		    printf("\t");
-	    }
-	    printf("END IF");
-            break;
-	case AST_WHILE:
-	    printf("WHILE ");
-	    generate_gwbasic_code(node->as.while_stmt.condition, depth);
-	    for(int i = 0; i < depth; ++i) {
-	    	printf("\t");
+		    sink_write(out, symbol->name, symbol->length);
 	    }
-	    for(int i = 0; i < node->as.while_stmt.body_count; ++i) {
-		if (i < node->as.while_stmt.body_count) {
-			printf("\n");
-		}
-		for(int i = 0; i < (depth + 1); ++i) {
-			printf("\t");
-		}
-	    	generate_gwbasic_code(node->as.while_stmt.body[i], depth + 1);
-	    }
-	    printf("\n");
-	    for(int i = 0; i < depth; ++i) {
-		    printf("\t");
-	    }
-	    printf("WEND");
 	    break;
+	case AST_STRING:
+	    sink_putc(out, '"');
+	    sink_write(out, ast_leaf_text(ast, node), ast_leaf_length(ast, node));
+	    sink_putc(out, '"');
+	    break;
+        case AST_BINARY_OP:
+            generate_expression(out, ast, node, flags);
+            break;
 	case AST_EXIT:
-	    printf("END");
+	    sink_literal(out, "END");
 	    break;
 	case AST_INPUT:
-	    printf("INPUT ");
-	    generate_gwbasic_code(node->as.input_stmt.string, depth);
-	    printf(" ; ");
-	    generate_gwbasic_code(node->as.input_stmt.identifier, depth);
+	    sink_literal(out, "INPUT ");
+	    generate_simple(out, ast, ast->first[node], flags);
+	    if (flags & GENERATE_COMPACT) {
+		    sink_putc(out, ';');
+	    } else {
+		    sink_literal(out, " ; ");
+	    }
+	    generate_simple(out, ast, ast->second[node], flags);
 	    break;
 	case AST_ASSIGN:
-	    printf("DIM ");
-	    generate_gwbasic_code(node->as.assign_stmt.identifier, depth);
-	    printf(" AS ");
-	    if (node->as.assign_stmt.expression->type == AST_NUMBER) {
-		    printf("INTEGER");
-	    } else if(node->as.assign_stmt.expression->type == AST_STRING) {
-		    printf("STRING");
-	    } else if(node->as.assign_stmt.expression->type == AST_IDENTIFIER) {
-		    printf("STRING");
+	    if (flags & GENERATE_NUMBERED) {
+		    generate_simple(out, ast, ast->first[node], flags);
+		    generate_operator(out, "=", 1, flags);
+		    generate_simple(out, ast, ast->second[node], flags);
+		    break;
+	    }
+	    sink_literal(out, "DIM ");
+	    generate_simple(out, ast, ast->first[node], flags);
+	    sink_literal(out, " AS ");
+	    expression = ast->second[node];
+	    if (ast->first[node] != AST_NONE && ast->type[ast->first[node]] == AST_IDENTIFIER
+			    && ast_symbol(ast, ast->first[node])->kind != KIND_UNKNOWN) {
+		    generate_type(out, ast_symbol(ast, ast->first[node])->kind);
+	    } else if (expression == AST_NONE) {
+		    break;
+	    } else if (ast->type[expression] == AST_NUMBER) {
+		    sink_literal(out, "INTEGER");
+	    } else if(ast->type[expression] == AST_STRING) {
+		    sink_literal(out, "STRING");
+	    } else if(ast->type[expression] == AST_IDENTIFIER) {
+		    sink_literal(out, "STRING");
 	    }
 	    break;
 	case AST_EQUALS:
-	    generate_gwbasic_code(node->as.assign_stmt.identifier, depth);
-	    printf(" = ");
-	    generate_gwbasic_code(node->as.assign_stmt.expression, depth);
+	    generate_simple(out, ast, ast->first[node], flags);
+	    generate_operator(out, "=", 1, flags);
+	    generate_simple(out, ast, ast->second[node], flags);
 	    break;
 	case AST_REM:
-	    printf("REM %s", node->as.string.value);
+	    sink_literal(out, "REM ");
+	    sink_write(out, ast_leaf_text(ast, node), ast_leaf_length(ast, node));
 	    break;
         case AST_PRINT:
-            printf("PRINT ");
-            generate_gwbasic_code(node->as.print_stmt.expression, depth);
+            if (flags & GENERATE_COMPACT) {
+                sink_putc(out, '?');  // GW-BASIC reads it as PRINT
+            } else {
+                sink_literal(out, "PRINT ");
+            }
+            generate_simple(out, ast, ast->first[node], flags);
             break;
+        default:
+            break;  // blocks are generated by generate_gwbasic_code()
     }
 }
 
-// Free AST recursively
-void free_ast(ASTNode *node) {
-	if (node == NULL) return;
-
-	switch (node->type) {
-		case AST_NUMBER:
-			// No need to free
-			break;
-		case AST_STRING:
-			// No need to free
-			break;
-		case AST_IDENTIFIER:
-			// No need to free
-			break;
-		case AST_BINARY_OP:
-			free_ast(node->as.binary_op.left);
-			free_ast(node->as.binary_op.right);
-			break;
-		case AST_IF:
-			free_ast(node->as.if_stmt.condition);
-			for (int i = 0; i < node->as.if_stmt.then_count; ++i) {
-				free_ast(node->as.if_stmt.then_branch[i]);
-			}
-			free(node->as.if_stmt.then_branch);
-			for (int i = 0; i < node->as.if_stmt.else_count; ++i) {
-				free_ast(node->as.if_stmt.else_branch[i]);
-			}
-			free(node->as.if_stmt.else_branch);
-			break;
-		case AST_ASSIGN:
-			free_ast(node->as.assign_stmt.identifier);
-			free_ast(node->as.assign_stmt.expression);
-			break;
-		case AST_PRINT:
-			free_ast(node->as.print_stmt.expression);
-			break;
-		case AST_WHILE:
-			free_ast(node->as.while_stmt.condition);
-			for (int i = 0; i < node->as.while_stmt.body_count; ++i) {
-				free_ast(node->as.while_stmt.body[i]);
-			}
-			free(node->as.while_stmt.body);
-			break;
-		case AST_REM:
-			// No need to free as it's pointing to lexeme in tokens
-			break;
-		case AST_INPUT:
-			free_ast(node->as.input_stmt.identifier);
-			free_ast(node->as.input_stmt.string);
-			break;
-		case AST_EXIT:
-			// No associated memory to free for EXIT
-			break;
-		case AST_EQUALS:
-			// This is typically handled under BINARY_OP
-			break;
-	}
+// Generate Frame (an if or while statement being generated)
+typedef struct {
+    AstIndex node;
+    int depth;
+    int part;           // GENERATE_ENTER, or the block part being generated
+    uint32_t index;     // next statement of that part
+} GenerateFrame;
+
+#define GENERATE_ENTER -1
+
+// Number of frames kept without allocating
+#define GENERATE_FRAMES 64
 
-	free(node); // Finally, free the node itself
+// Generate GW-BASIC Code (nested blocks are kept on an explicit stack,
+// entering a statement prints its head, leaving it prints END IF or WEND)
+void generate_gwbasic_code(Sink *out, const Ast *ast, AstIndex node, int depth) {
+    GenerateFrame local[GENERATE_FRAMES], *stack = local;
+    size_t top = 0, capacity = GENERATE_FRAMES;
+
+    if (node == AST_NONE) return;
+    if (depth < 0) return;
+
+    stack[top++] = (GenerateFrame){ node, depth, GENERATE_ENTER, 0 };
+    while (top > 0) {
+        GenerateFrame *frame = &stack[top - 1];
+        AstIndex current = frame->node;
+        const AstRange *range;
+
+        if (ast->type[current] != AST_IF && ast->type[current] != AST_WHILE) {
+            generate_simple(out, ast, current, 0);
+            top--;
+            continue;
+        }
+
+        // Enter
+        if (frame->part == GENERATE_ENTER) {
+            if (ast->type[current] == AST_IF) {
+                sink_literal(out, "IF ");
+                generate_simple(out, ast, ast->first[current], 0);
+                sink_literal(out, " THEN");
+                sink_indent(out, frame->depth + 1);
+                frame->part = BLOCK_THEN;
+            } else {
+                sink_literal(out, "WHILE ");
+                generate_simple(out, ast, ast->first[current], 0);
+                sink_indent(out, frame->depth);
+                frame->part = BLOCK_BODY;
+            }
+            continue;
+        }
+
+        // The else branch is the range after the then branch
+        range = &ast->ranges[ast->second[current] + (frame->part == BLOCK_ELSE)];
+
+        // Next statement of the block
+        if (frame->index < range->count) {
+            AstIndex child = ast->children[range->start + frame->index++];
+            sink_putc(out, '\n');
+            sink_indent(out, frame->depth + 1);
+            if (top == capacity) {
+                GenerateFrame *tmp = allocator_alloc(out->allocator, sizeof(GenerateFrame) * capacity * 2);
+                if (tmp == NULL) {
+                    out->error = ENOMEM;
+                    break;
+                }
+                memcpy(tmp, stack, sizeof(GenerateFrame) * top);
+                if (stack != local) {
+                    allocator_free(out->allocator, stack);
+                }
+                stack = tmp;
+                capacity *= 2;
+                frame = &stack[top - 1];
+            }
+            stack[top++] = (GenerateFrame){ child, frame->depth + 1, GENERATE_ENTER, 0 };
+            continue;
+        }
+
+        // Else (only printed when the branch has statements)
+        if (frame->part == BLOCK_THEN && ast->ranges[ast->second[current] + 1].count > 0) {
+            sink_putc(out, '\n');
+            sink_indent(out, frame->depth);
+            sink_literal(out, "ELSE");
+            frame->part = BLOCK_ELSE;
+            frame->index = 0;
+            continue;
+        }
+
+        // Leave
+        sink_putc(out, '\n');
+        sink_indent(out, frame->depth);
+        if (ast->type[current] == AST_IF) {
+            sink_literal(out, "END IF");
+        } else {
+            sink_literal(out, "WEND");
+        }
+        top--;
+    }
+
+    if (stack != local) {
+        allocator_free(out->allocator, stack);
+    }
+}
+
+// Line Item (what is left to print of a line-numbered statement)
+typedef struct {
+    AstIndex node;
+    int depth;
+    char what;          // 's' a statement, 'g' a GOTO, 't' the test ending a while
+    unsigned target;    // line jumped to by 'g' and 't'
+} LineItem;
+
+// Lines taken by the statements of a block
+static uint32_t block_lines(const Ast *ast, AstIndex range, const uint32_t *size) {
+    const AstRange *block = &ast->ranges[range];
+    uint32_t lines = 0;
+
+    for (uint32_t i = 0; i < block->count; ++i) {
+        lines += size[ast->children[block->start + i]];
+    }
+    return lines;
+}
+
+// Write a line number, returns its length
+static size_t generate_unsigned(Sink *out, unsigned value) {
+    char digits[16];
+    size_t n = sizeof(digits);
+
+    do {
+        digits[--n] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    sink_write(out, digits + n, sizeof(digits) - n);
+    return sizeof(digits) - n;
+}
+
+// Start the next line: its number and the indentation after it (with
+// --compact the number is only written when the statement needs a line
+// of its own, see end_compact_line()). Callers make sure it fits.
+static void generate_line_number(Sink *out, LineNumbers *lines, int depth) {
+    if (lines->scratch == NULL) {
+        generate_unsigned(out, lines->next);
+        sink_putc(out, ' ');
+        sink_indent(out, depth);
+    }
+    lines->next += lines->step;
+}
+
+// Remember a line is jumped to
+static void mark_target(LineNumbers *lines, unsigned target) {
+    if (target > lines->furthest) {
+        lines->furthest = target;
+    }
+    if (lines->targets != NULL && target <= GWBASIC_MAX_LINE) {
+        lines->targets[target / 8] |= (unsigned char)(1u << (target % 8));
+    }
+}
+
+// Write a jump
+static void generate_goto(Sink *out, LineNumbers *lines, unsigned target) {
+    mark_target(lines, target);
+    sink_literal(out, "GOTO ");
+    generate_unsigned(out, target);
+}
+
+// Write the end of an IF that jumps (THEN takes a bare line number, which
+// --compact uses)
+static void generate_then_goto(Sink *out, LineNumbers *lines, unsigned target) {
+    sink_literal(out, " THEN ");
+    if (lines->scratch == NULL) {
+        generate_goto(out, lines, target);
+        return;
+    }
+    mark_target(lines, target);
+    generate_unsigned(out, target);
+}
+
+// With --compact, put the statement numbered line on the line so far
+// after a ':', or start a line with its number when something jumps to
+// it, the line so far ends in a jump or an IF, or the line would get too
+// long. open tells whether the statement takes another after it.
+static void end_compact_line(Sink *out, LineNumbers *lines, unsigned line, int open) {
+    Sink *text = lines->scratch;
+    int jumped = line <= GWBASIC_MAX_LINE && (lines->targets[line / 8] >> (line % 8) & 1);
+
+    if (lines->column > 0 && lines->open && !jumped && lines->column + 1 + text->length <= GWBASIC_MAX_LENGTH) {
+        sink_putc(out, ':');
+        lines->column += 1 + text->length;
+    } else {
+        if (lines->column > 0) {
+            sink_putc(out, '\n');
+        }
+        lines->column = generate_unsigned(out, line) + 1 + text->length;
+        sink_putc(out, ' ');
+    }
+    if (text->error != 0) {
+        out->error = text->error;
+    }
+    sink_append(out, text);
+    lines->open = open;
+}
+
+// Generate a condition, or the condition being false (NOT is bitwise in
+// GW-BASIC: NOT 1 is -2, which is true)
+static void generate_condition(Sink *out, const Ast *ast, AstIndex node, int negate, int flags) {
+    AstIndex left, right;
+    int parens;
+
+    if (!negate) {
+        generate_simple(out, ast, node, flags);
+        return;
+    }
+    if (ast->type[node] != AST_BINARY_OP || precedence(ast->op[node]) != 1) {
+        parens = ast->type[node] == AST_BINARY_OP && precedence(ast->op[node]) < 1;
+        if (parens) sink_putc(out, '(');
+        generate_simple(out, ast, node, flags);
+        if (parens) sink_putc(out, ')');
+        generate_operator(out, "=", 1, flags);
+        sink_putc(out, '0');
+        return;
+    }
+
+    // Comparisons are turned around
+    left = ast->first[node];
+    right = ast->second[node];
+    parens = needs_parens(ast, node, left, 0);
+    if (parens) sink_putc(out, '(');
+    generate_simple(out, ast, left, flags);
+    if (parens) sink_putc(out, ')');
+    if (ast->op[node] == '<') {
+        generate_operator(out, ">=", 2, flags);
+    } else if (ast->op[node] == '>') {
+        generate_operator(out, "<=", 2, flags);
+    } else {
+        generate_operator(out, "<>", 2, flags);
+    }
+    parens = needs_parens(ast, node, right, 1);
+    if (parens) sink_putc(out, '(');
+    generate_simple(out, ast, right, flags);
+    if (parens) sink_putc(out, ')');
+}
+
+// Generate line-numbered GW-BASIC, which has neither block IF nor a WEND
+// it can find quickly. An if becomes a test jumping past its then branch:
+//     10 IF NOT-c THEN GOTO 40 / 20 then... / 30 GOTO 50 / 40 else...
+// and a while tests at the bottom, one jump per iteration:
+//     10 GOTO 30 / 20 body... / 30 IF c THEN GOTO 20
+// Every line is told its number up front from the lines each statement
+// takes (none for a REM dropped by --compact), so a statement whose lines
+// or jumps would go past GWBASIC_MAX_LINE sets lines->overflow before
+// anything of it is written. Scratch space comes from the arena.
+void generate_gwbasic_lines(Sink *out, const Ast *ast, AstIndex node, LineNumbers *lines, Arena *arena) {
+    int compact = lines->scratch != NULL;
+    int flags = GENERATE_NUMBERED | (compact ? GENERATE_COMPACT : 0);
+    Sink *text = compact ? lines->scratch : out;
+    uint32_t *size;
+    LineItem *stack;
+    size_t top = 0, capacity = EXPRESSION_ITEMS;
+    unsigned start = lines->next;
+    unsigned long long last;
+
+    if (node == AST_NONE || lines->overflow) return;
+
+    size = arena_alloc(arena, sizeof(uint32_t) * ast->count);
+    stack = arena_alloc(arena, sizeof(LineItem) * capacity);
+    if (size == NULL || stack == NULL) {
+        out->error = ENOMEM;
+        return;
+    }
+
+    // Blocks are parsed after the head of their statement, so going
+    // backwards the statements inside one are sized before it
+    for (AstIndex i = ast->count; i-- > node;) {
+        AstIndex range = ast->second[i];
+        uint32_t then_lines, else_lines;
+
+        switch ((ASTNodeType)ast->type[i]) {
+            case AST_IF:
+                then_lines = block_lines(ast, range, size);
+                else_lines = block_lines(ast, range + 1, size);
+                size[i] = 1 + then_lines + (then_lines > 0 && else_lines > 0 ? 1 : 0) + else_lines;
+                break;
+            case AST_WHILE:
+                then_lines = block_lines(ast, range, size);
+                size[i] = then_lines > 0 ? then_lines + 2 : 1;
+                break;
+            case AST_REM:
+                size[i] = compact ? 0 : 1;
+                break;
+            default:
+                size[i] = 1;
+                break;
+        }
+    }
+
+    // The last line it takes, or for an IF the line after it, which its
+    // jumps past a branch go to
+    last = start + ((unsigned long long)size[node] - (ast->type[node] == AST_IF ? 0 : 1)) * lines->step;
+    if (size[node] > 0 && last > GWBASIC_MAX_LINE) {
+        lines->overflow = 1;
+        return;
+    }
+
+    stack[top++] = (LineItem){ node, 0, 's', 0 };
+    while (top > 0) {
+        LineItem item = stack[--top];
+        unsigned line = lines->next, step = lines->step;
+        AstIndex range = ast->second[item.node];
+        const AstRange *then_block = NULL, *else_block = NULL;
+        size_t needed = top + 2;
+        uint32_t then_lines, else_lines;
+        int open = 0;
+
+        if (item.what == 's' && size[item.node] == 0) {
+            continue;
+        }
+        if (item.what == 's' && ast->type[item.node] == AST_IF) {
+            then_block = &ast->ranges[range];
+            else_block = &ast->ranges[range + 1];
+            needed += then_block->count + else_block->count;
+        } else if (item.what == 's' && ast->type[item.node] == AST_WHILE) {
+            then_block = &ast->ranges[range];
+            needed += then_block->count;
+        }
+        if (needed > capacity) {
+            LineItem *tmp;
+            while (capacity < needed) {
+                capacity *= 2;
+            }
+            if ((tmp = arena_alloc(arena, sizeof(LineItem) * capacity)) == NULL) {
+                out->error = ENOMEM;
+                return;
+            }
+            memcpy(tmp, stack, sizeof(LineItem) * top);
+            stack = tmp;
+        }
+
+        if (line != start && !compact) {
+            sink_putc(out, '\n');
+        }
+        generate_line_number(out, lines, item.depth);
+
+        if (item.what == 'g') {
+            generate_goto(text, lines, item.target);
+        } else if (item.what == 't') {
+            sink_literal(text, "IF ");
+            generate_condition(text, ast, ast->first[item.node], 0, flags);
+            generate_then_goto(text, lines, item.target);
+        } else {
+            switch ((ASTNodeType)ast->type[item.node]) {
+                case AST_IF:
+                    then_lines = block_lines(ast, range, size);
+                    else_lines = block_lines(ast, range + 1, size);
+                    sink_literal(text, "IF ");
+                    if (then_lines == 0 && else_lines > 0) {
+                        // Only the else branch, which runs when the test fails
+                        generate_condition(text, ast, ast->first[item.node], 0, flags);
+                        generate_then_goto(text, lines, line + size[item.node] * step);
+                        then_block = else_block;
+                        else_block = NULL;
+                    } else {
+                        generate_condition(text, ast, ast->first[item.node], 1, flags);
+                        generate_then_goto(text, lines, line + (1 + then_lines + (else_lines > 0)) * step);
+                        if (else_lines > 0) {
+                            for (uint32_t i = else_block->count; i > 0; --i) {
+                                stack[top++] = (LineItem){ ast->children[else_block->start + i - 1], item.depth + 1, 's', 0 };
+                            }
+                            stack[top++] = (LineItem){ item.node, item.depth, 'g', line + size[item.node] * step };
+                        }
+                    }
+                    for (uint32_t i = then_block->count; i > 0; --i) {
+                        stack[top++] = (LineItem){ ast->children[then_block->start + i - 1], item.depth + 1, 's', 0 };
+                    }
+                    break;
+                case AST_WHILE:
+                    if (size[item.node] == 1) {
+                        sink_literal(text, "IF ");
+                        generate_condition(text, ast, ast->first[item.node], 0, flags);
+                        generate_then_goto(text, lines, line);
+                        break;
+                    }
+                    generate_goto(text, lines, line + (size[item.node] - 1) * step);
+                    mark_target(lines, line + step);  // by the test, known before the body
+                    stack[top++] = (LineItem){ item.node, item.depth, 't', line + step };
+                    for (uint32_t i = then_block->count; i > 0; --i) {
+                        stack[top++] = (LineItem){ ast->children[then_block->start + i - 1], item.depth + 1, 's', 0 };
+                    }
+                    break;
+                default:
+                    generate_simple(text, ast, item.node, flags);
+                    open = 1;
+                    break;
+            }
+        }
+        if (compact) {
+            end_compact_line(out, lines, line, open);
+        }
+    }
 }
 
+// End a line-numbered program with a line for the jumps past its last
+// statement to land on
+void generate_gwbasic_end(Sink *out, LineNumbers *lines) {
+    unsigned line = lines->next;
+
+    if (lines->furthest >= lines->next && lines->next > GWBASIC_MAX_LINE) {
+        lines->overflow = 1;
+        return;
+    }
 
+    if (lines->scratch == NULL) {
+        if (lines->furthest >= lines->next) {
+            generate_line_number(out, lines, 0);
+            sink_literal(out, "END\n");
+        }
+        return;
+    }
+    if (lines->furthest >= lines->next) {
+        generate_line_number(out, lines, 0);
+        sink_literal(lines->scratch, "END");
+        end_compact_line(out, lines, line, 0);
+    }
+    if (lines->column > 0) {
+        sink_putc(out, '\n');
+    }
+}
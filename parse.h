@@ -22,48 +22,126 @@ typedef enum {
     AST_EQUALS
 } ASTNodeType;
 
-// AST Node Structure
-typedef struct ASTNode {
-    ASTNodeType type;
-    union {
-        struct {
-            char *value;
-        } number;
-	struct {
-            char *value;
-	} string;
-        struct {
-            struct ASTNode *left;
-            struct ASTNode *right;
-            char *op;
-        } binary_op;
-        struct {
-            struct ASTNode *condition;
-            struct ASTNode **then_branch;
-            struct ASTNode **else_branch;
-	    int then_count;
-	    int else_count;
-        } if_stmt;
-	struct {
-	    struct ASTNode *identifier;
-	    struct ASTNode *expression;
-	} assign_stmt;
-        struct {
-            struct ASTNode *expression;
-        } print_stmt;
-	struct {
-	    struct ASTNode *condition;
-	    struct ASTNode **body;
-	    int body_count;
-	} while_stmt;
-	struct {
-	    struct ASTNode *string;
-	    struct ASTNode *identifier;
-	} input_stmt;
-    } as;
-} ASTNode;
+// Index of a node in an Ast (AST_NONE for no node)
+typedef uint32_t AstIndex;
+#define AST_NONE UINT32_MAX
 
-void generate_gwbasic_code(ASTNode *node, int depth);
-ASTNode *parse_statement(Token **tokens);
-void free_ast(ASTNode *node);
+// Range of statements in Ast.children
+typedef struct {
+    uint32_t start;
+    uint32_t count;
+} AstRange;
+
+// Syntax Tree Structure (the nodes of one statement in struct-of-arrays
+// form, addressed by 32-bit indices and kept between statements)
+//
+//   AST_NUMBER, AST_STRING,   first is the index of its text
+//   AST_REM
+//   AST_IDENTIFIER            first is its symbol id
+//   AST_BINARY_OP             first and second are the operands, op the
+//                             operator ('=' for ==)
+//   AST_IF                    first is the condition, second the range of
+//                             the then branch, second + 1 the else branch
+//   AST_WHILE                 first is the condition, second the range of
+//                             the body
+//   AST_PRINT                 first is the expression
+//   AST_ASSIGN, AST_EQUALS    first is the identifier, second the expression
+//   AST_INPUT                 first is the prompt, second the identifier
+//
+// Operands come before their operator, so an expression is the contiguous
+// run of nodes from its leftmost leaf up to its root.
+typedef struct Ast {
+    const struct Js2basAllocator *allocator;
+    const SymbolTable *symbols;  // names of the identifiers
+    uint8_t *type;          // ASTNodeType of each node
+    char *op;
+    AstIndex *first;
+    AstIndex *second;
+    uint32_t count;
+    uint32_t capacity;
+    const char **text;      // of leaves, in the source or the arena
+    uint32_t *length;
+    uint32_t texts;
+    uint32_t texts_capacity;
+    AstIndex *children;     // statements of every block, block by block
+    uint32_t children_count;
+    uint32_t children_capacity;
+    AstRange *ranges;
+    uint32_t ranges_count;
+    uint32_t ranges_capacity;
+} Ast;
+
+// Text of a leaf node other than an identifier
+#define ast_leaf_text(ast, node) ((ast)->text[(ast)->first[node]])
+#define ast_leaf_length(ast, node) ((ast)->length[(ast)->first[node]])
+
+// Symbol of an identifier node
+#define ast_symbol(ast, node) (&(ast)->symbols->symbols[(ast)->first[node]])
+
+// Highest line number GW-BASIC takes
+#define GWBASIC_MAX_LINE 65529
+
+// Longest line GW-BASIC takes, with its number
+#define GWBASIC_MAX_LENGTH 255
+
+// Line Numbers Structure (line-numbered GW-BASIC, carried from one
+// statement to the next). With --compact every statement is still given
+// a number, but one that nothing jumps to joins the line before it after
+// a ':' and its number goes unused.
+typedef struct {
+    unsigned next;      // number of the next line
+    unsigned step;
+    unsigned furthest;  // highest line jumped to
+    int overflow;       // a statement needed a number past GWBASIC_MAX_LINE
+                        // and was not written, nor anything after it
+    Sink *scratch;      // --compact: the statement being generated, NULL otherwise
+    unsigned char *targets;  // --compact: lines jumped to, a bit each up to GWBASIC_MAX_LINE
+    size_t column;      // --compact: length of the line so far, 0 before the first
+    int open;           // --compact: the line so far takes another statement
+} LineNumbers;
+
+// Parts of a block being parsed
+#define BLOCK_THEN 0
+#define BLOCK_ELSE 1
+#define BLOCK_BODY 2
+
+// Parser Block Structure (an if or while statement whose block is open)
+typedef struct {
+    AstIndex node;
+    size_t mark;        // its statements are on the stack above this
+    int part;
+} ParserBlock;
+
+// Parser Structure
+typedef struct {
+    Lexer *lex;
+    Arena *arena;       // scratch space, released by arena_reset()
+    Sink *diag;         // error messages
+    int error;          // ENOMEM once an allocation failed
+    Ast ast;            // the last statement parsed
+    AstIndex *stack;    // scratch stack child statements and operands are collected on
+    size_t top;
+    size_t capacity;
+    char *operators;    // scratch stack of pending operators, 0 for '('
+    size_t operators_top;
+    size_t operators_capacity;
+    ParserBlock *blocks;  // open blocks, innermost last
+    size_t blocks_top;
+    size_t blocks_capacity;
+} Parser;
+
+void ast_init(Ast *ast, const struct Js2basAllocator *allocator);
+void ast_reset(Ast *ast);
+void ast_free(Ast *ast);
+AstIndex ast_node(Ast *ast, ASTNodeType type, AstIndex first, AstIndex second);
+AstIndex ast_text(Ast *ast, const char *text, uint32_t length);
+AstIndex ast_ranges(Ast *ast, uint32_t count);
+int ast_children(Ast *ast, AstIndex range, const AstIndex *statements, uint32_t count);
+void generate_gwbasic_code(Sink *out, const Ast *ast, AstIndex node, int depth);
+void generate_gwbasic_lines(Sink *out, const Ast *ast, AstIndex node, LineNumbers *lines, Arena *arena);
+void generate_gwbasic_end(Sink *out, LineNumbers *lines);
+int ast_walk(const Ast *ast, AstIndex node, Arena *arena, void (*visit)(const Ast *ast, AstIndex node, size_t depth, void *user), void *user);
+void parser_init(Parser *p, Lexer *lex, Arena *arena, Sink *diag);
+void parser_free(Parser *p);
+AstIndex parse_statement(Parser *p);
 
@@ -0,0 +1,156 @@
+/*
+ * pool.c - Work-stealing thread pool running a fixed set of tasks.
+ *
+ * Every worker starts with a contiguous range of task indices and runs
+ * them from the front. A worker that runs dry steals the back half of
+ * another worker's range, so large tasks do not leave threads idle.
+ *
+ * Author: Philip R. Simonson
+ * Date: 10/17/2026
+ *
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <pthread.h>
+#include "pool.h"
+
+// Pool Queue Structure (indices [next, end) are still to run)
+typedef struct {
+    pthread_mutex_t lock;
+    size_t next;
+    size_t end;
+} PoolQueue;
+
+// Pool Structure
+typedef struct {
+    PoolQueue *queues;
+    int threads;
+    PoolTask task;
+    void *context;
+} Pool;
+
+// Pool Worker Structure
+typedef struct {
+    Pool *pool;
+    int id;
+} PoolWorker;
+
+// Take the next index from a worker's own queue
+static int pool_take(PoolQueue *queue, size_t *index) {
+    int found = 0;
+
+    pthread_mutex_lock(&queue->lock);
+    if (queue->next < queue->end) {
+        *index = queue->next++;
+        found = 1;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return found;
+}
+
+// Steal the back half of another worker's queue
+static int pool_steal(Pool *pool, int self, size_t *index) {
+    for (int i = 1; i < pool->threads; ++i) {
+        PoolQueue *victim = &pool->queues[(self + i) % pool->threads];
+        size_t start = 0, end = 0;
+
+        pthread_mutex_lock(&victim->lock);
+        if (victim->next < victim->end) {
+            start = victim->next + (victim->end - victim->next) / 2;
+            end = victim->end;
+            victim->end = start;
+        }
+        pthread_mutex_unlock(&victim->lock);
+
+        if (start < end) {
+            PoolQueue *queue = &pool->queues[self];
+            pthread_mutex_lock(&queue->lock);
+            queue->next = start + 1;
+            queue->end = end;
+            pthread_mutex_unlock(&queue->lock);
+            *index = start;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Run tasks until there is nothing left to take or steal
+static void *pool_worker(void *arg) {
+    PoolWorker *worker = arg;
+    Pool *pool = worker->pool;
+    size_t index;
+
+    while (pool_take(&pool->queues[worker->id], &index) || pool_steal(pool, worker->id, &index)) {
+        pool->task(pool->context, index);
+    }
+    return NULL;
+}
+
+// Run task for every index on up to threads threads, returns -1 on error
+int pool_run(int threads, size_t count, PoolTask task, void *context) {
+    Pool pool;
+    PoolWorker *workers;
+    pthread_t *ids;
+    int started = 0;
+
+    if (threads < 1) {
+        threads = 1;
+    }
+    if ((size_t)threads > count) {
+        threads = count > 0 ? (int)count : 1;
+    }
+
+    pool.threads = threads;
+    pool.task = task;
+    pool.context = context;
+    pool.queues = calloc(threads, sizeof(PoolQueue));
+    workers = calloc(threads, sizeof(PoolWorker));
+    ids = calloc(threads, sizeof(pthread_t));
+    if (pool.queues == NULL || workers == NULL || ids == NULL) {
+        free(pool.queues);
+        free(workers);
+        free(ids);
+        return -1;
+    }
+
+    for (int i = 0; i < threads; ++i) {
+        pthread_mutex_init(&pool.queues[i].lock, NULL);
+        pool.queues[i].next = count * i / threads;
+        pool.queues[i].end = count * (i + 1) / threads;
+        workers[i].pool = &pool;
+        workers[i].id = i;
+    }
+
+    // Worker 0 is the calling thread; the ranges of threads that could
+    // not be started get stolen by the others.
+    for (int i = 1; i < threads; ++i) {
+        if (pthread_create(&ids[i], NULL, pool_worker, &workers[i]) != 0) {
+            break;
+        }
+        started = i;
+    }
+    pool_worker(&workers[0]);
+    for (int i = 1; i <= started; ++i) {
+        pthread_join(ids[i], NULL);
+    }
+
+    // Ranges of workers that never started are left over
+    for (int i = started + 1; i < threads; ++i) {
+        size_t index;
+        while (pool_take(&pool.queues[i], &index)) {
+            task(context, index);
+        }
+    }
+
+    for (int i = 0; i < threads; ++i) {
+        pthread_mutex_destroy(&pool.queues[i].lock);
+    }
+    free(pool.queues);
+    free(workers);
+    free(ids);
+    return 0;
+}
+
@@ -0,0 +1,15 @@
+/*
+ * pool.h - Work-stealing thread pool running a fixed set of tasks.
+ *
+ * Author: Philip R. Simonson
+ * Date: 10/17/2026
+ *
+ */
+
+#include <stddef.h>
+
+// Task Function (called once for every index in [0, count))
+typedef void (*PoolTask)(void *context, size_t index);
+
+int pool_run(int threads, size_t count, PoolTask task, void *context);
+
@@ -0,0 +1,292 @@
+/*
+ * scan.c - Character classes and run scanners used by the tokenizer.
+ *
+ * Author: Philip R. Simonson
+ * Date: 10/17/2026
+ *
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "scan.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+#define S (CC_SPACE)
+#define N (CC_SPACE | CC_NEWLINE)
+#define D (CC_DIGIT)
+#define A (CC_ALPHA)
+
+// Character class table (ASCII only, matches the "C" locale)
+const unsigned char char_class[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, S, N, 0, 0, N, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    S, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    D, D, D, D, D, D, D, D, D, D, 0, 0, 0, 0, 0, 0,
+    0, A, A, A, A, A, A, A, A, A, A, A, A, A, A, A,
+    A, A, A, A, A, A, A, A, A, A, A, 0, 0, 0, 0, A,
+    0, A, A, A, A, A, A, A, A, A, A, A, A, A, A, A,
+    A, A, A, A, A, A, A, A, A, A, A, 0, 0, 0, 0, 0,
+};
+
+#undef S
+#undef N
+#undef D
+#undef A
+
+// Scalar Scanners
+
+static const char *space_scalar(const char *p, const char *end, int *lines) {
+    while (p < end && is_space(*p)) {
+        if (char_class[(unsigned char)*p] & CC_NEWLINE) {
+            (*lines)++;
+        }
+        p++;
+    }
+    return p;
+}
+
+static const char *digits_scalar(const char *p, const char *end) {
+    while (p < end && is_digit(*p)) p++;
+    return p;
+}
+
+static const char *ident_scalar(const char *p, const char *end) {
+    while (p < end && is_ident(*p)) p++;
+    return p;
+}
+
+static const char *quote_scalar(const char *p, const char *end) {
+    const char *q = memchr(p, '"', end - p);
+    return q ? q : end;
+}
+
+static const char *line_scalar(const char *p, const char *end) {
+    while (p < end && *p != '\n' && *p != '\r') p++;
+    return p;
+}
+
+#ifdef SCAN_X86
+
+// SSE2 Scanners (16 bytes at a time, the tail is left to the scalar code)
+
+// Bytes inside [lo, lo + count) as a mask
+#define SSE2_RANGE(v, lo, count) \
+    _mm_cmplt_epi8(_mm_add_epi8((v), _mm_set1_epi8((char)(-128 - (lo)))), \
+                   _mm_set1_epi8((char)(-128 + (count))))
+
+__attribute__((target("sse2")))
+static const char *space_sse2(const char *p, const char *end, int *lines) {
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        __m128i nl = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')),
+                                  _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+        __m128i sp = _mm_or_si128(_mm_or_si128(nl, _mm_cmpeq_epi8(v, _mm_set1_epi8(' '))),
+                                  _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+        unsigned space = _mm_movemask_epi8(sp);
+        unsigned newline = _mm_movemask_epi8(nl);
+        if (space != 0xFFFF) {
+            unsigned run = __builtin_ctz(~space);
+            *lines += __builtin_popcount(newline & ((1u << run) - 1));
+            return p + run;
+        }
+        *lines += __builtin_popcount(newline);
+        p += 16;
+    }
+    return space_scalar(p, end, lines);
+}
+
+__attribute__((target("sse2")))
+static const char *digits_sse2(const char *p, const char *end) {
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        unsigned mask = _mm_movemask_epi8(SSE2_RANGE(v, '0', 10));
+        if (mask != 0xFFFF) {
+            return p + __builtin_ctz(~mask);
+        }
+        p += 16;
+    }
+    return digits_scalar(p, end);
+}
+
+__attribute__((target("sse2")))
+static const char *ident_sse2(const char *p, const char *end) {
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        __m128i ok = _mm_or_si128(_mm_or_si128(SSE2_RANGE(lower, 'a', 26), SSE2_RANGE(v, '0', 10)),
+                                  _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+        unsigned mask = _mm_movemask_epi8(ok);
+        if (mask != 0xFFFF) {
+            return p + __builtin_ctz(~mask);
+        }
+        p += 16;
+    }
+    return ident_scalar(p, end);
+}
+
+__attribute__((target("sse2")))
+static const char *quote_sse2(const char *p, const char *end) {
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+    return quote_scalar(p, end);
+}
+
+__attribute__((target("sse2")))
+static const char *line_sse2(const char *p, const char *end) {
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        unsigned mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')),
+                                                       _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+    return line_scalar(p, end);
+}
+
+// AVX2 Scanners (32 bytes at a time)
+
+#define AVX2_RANGE(v, lo, count) \
+    _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(-128 + (count))), \
+                      _mm256_add_epi8((v), _mm256_set1_epi8((char)(-128 - (lo)))))
+
+__attribute__((target("avx2")))
+static const char *space_avx2(const char *p, const char *end, int *lines) {
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        __m256i nl = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')),
+                                     _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')));
+        __m256i sp = _mm256_or_si256(_mm256_or_si256(nl, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '))),
+                                     _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+        unsigned space = _mm256_movemask_epi8(sp);
+        unsigned newline = _mm256_movemask_epi8(nl);
+        if (space != 0xFFFFFFFFu) {
+            unsigned run = __builtin_ctz(~space);
+            *lines += __builtin_popcount(newline & ((1u << run) - 1));
+            return p + run;
+        }
+        *lines += __builtin_popcount(newline);
+        p += 32;
+    }
+    return space_sse2(p, end, lines);
+}
+
+__attribute__((target("avx2")))
+static const char *digits_avx2(const char *p, const char *end) {
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        unsigned mask = _mm256_movemask_epi8(AVX2_RANGE(v, '0', 10));
+        if (mask != 0xFFFFFFFFu) {
+            return p + __builtin_ctz(~mask);
+        }
+        p += 32;
+    }
+    return digits_sse2(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char *ident_avx2(const char *p, const char *end) {
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        __m256i ok = _mm256_or_si256(_mm256_or_si256(AVX2_RANGE(lower, 'a', 26), AVX2_RANGE(v, '0', 10)),
+                                     _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+        unsigned mask = _mm256_movemask_epi8(ok);
+        if (mask != 0xFFFFFFFFu) {
+            return p + __builtin_ctz(~mask);
+        }
+        p += 32;
+    }
+    return ident_sse2(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char *quote_avx2(const char *p, const char *end) {
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+    return quote_sse2(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char *line_avx2(const char *p, const char *end) {
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        unsigned mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')),
+                                                             _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+    return line_sse2(p, end);
+}
+
+#endif
+
+static const ScanKernels kernels_scalar = {
+    "scalar", space_scalar, digits_scalar, ident_scalar, quote_scalar, line_scalar
+};
+
+#ifdef SCAN_X86
+static const ScanKernels kernels_sse2 = {
+    "sse2", space_sse2, digits_sse2, ident_sse2, quote_sse2, line_sse2
+};
+
+static const ScanKernels kernels_avx2 = {
+    "avx2", space_avx2, digits_avx2, ident_avx2, quote_avx2, line_avx2
+};
+#endif
+
+ScanKernels scan = {
+    "scalar", space_scalar, digits_scalar, ident_scalar, quote_scalar, line_scalar
+};
+
+// Pick the widest scanners the CPU supports
+static void scan_select(void) {
+    const ScanKernels *chosen = &kernels_scalar;
+    const char *force;
+
+    force = getenv("JS2BAS_SCAN");
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+    if (force == NULL || strcmp(force, "scalar") != 0) {
+        if (__builtin_cpu_supports("sse2")) {
+            chosen = &kernels_sse2;
+        }
+        if ((force == NULL || strcmp(force, "sse2") != 0) && __builtin_cpu_supports("avx2")) {
+            chosen = &kernels_avx2;
+        }
+    }
+#else
+    (void)force;
+#endif
+    scan = *chosen;
+}
+
+// Pick the scanners once, whichever thread asks first
+void scan_init(void) {
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+    pthread_once(&once, scan_select);
+}
+
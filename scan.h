@@ -0,0 +1,63 @@
+/*
+ * scan.h - Character classes and run scanners used by the tokenizer.
+ *
+ * Author: Philip R. Simonson
+ * Date: 10/17/2026
+ *
+ */
+
+// Character Classes
+#define CC_SPACE   0x01  // ' ', '\t', '\r', '\n'
+#define CC_NEWLINE 0x02  // '\r', '\n' (each one counts as a line)
+#define CC_DIGIT   0x04  // '0'-'9'
+#define CC_ALPHA   0x08  // 'A'-'Z', 'a'-'z', '_'
+
+extern const unsigned char char_class[256];
+
+#define is_space(c) (char_class[(unsigned char)(c)] & CC_SPACE)
+#define is_digit(c) (char_class[(unsigned char)(c)] & CC_DIGIT)
+#define is_ident_start(c) (char_class[(unsigned char)(c)] & CC_ALPHA)
+#define is_ident(c) (char_class[(unsigned char)(c)] & (CC_ALPHA | CC_DIGIT))
+
+// Run Scanners (every one returns the first byte not part of the run)
+typedef struct {
+    const char *name;
+    const char *(*space)(const char *p, const char *end, int *lines);
+    const char *(*digits)(const char *p, const char *end);
+    const char *(*ident)(const char *p, const char *end);
+    const char *(*quote)(const char *p, const char *end);
+    const char *(*line)(const char *p, const char *end);
+} ScanKernels;
+
+// Selected once by scan_init(), JS2BAS_SCAN=scalar|sse2|avx2 overrides
+extern ScanKernels scan;
+
+void scan_init(void);
+
+// Most runs are a few bytes long, those are scanned inline and only
+// longer runs are handed to the selected kernels.
+#define SCAN_INLINE 8
+
+#define SCAN_RUN(name, test) \
+static inline const char *scan_##name##_run(const char *p, const char *end) { \
+    const char *stop = end - p > SCAN_INLINE ? p + SCAN_INLINE : end; \
+    while (p < stop && (test)) p++; \
+    return (p == stop && p < end) ? scan.name(p, end) : p; \
+}
+
+SCAN_RUN(digits, is_digit(*p))
+SCAN_RUN(ident, is_ident(*p))
+SCAN_RUN(quote, *p != '"')
+SCAN_RUN(line, *p != '\n' && *p != '\r')
+
+static inline const char *scan_space_run(const char *p, const char *end, int *lines) {
+    const char *stop = end - p > SCAN_INLINE ? p + SCAN_INLINE : end;
+    while (p < stop && is_space(*p)) {
+        if (char_class[(unsigned char)*p] & CC_NEWLINE) {
+            (*lines)++;
+        }
+        p++;
+    }
+    return (p == stop && p < end) ? scan.space(p, end, lines) : p;
+}
+
@@ -0,0 +1,301 @@
+/*
+ * server.c - Translation server on a Unix domain socket.
+ *
+ * Author: Philip R. Simonson
+ * Date: 10/17/2026
+ *
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "js2bas.h"
+#include "sink.h"
+#include "server.h"
+
+// Bytes read from a connection at once
+#define SERVE_READ 65536
+
+// Responses are written once this much is pending
+#define SERVE_BATCH (4 * SINK_CHUNK)
+
+// Wait after accept() runs out of descriptors or memory, doubled while
+// it keeps failing (milliseconds)
+#define SERVE_BACKOFF_MIN 10
+#define SERVE_BACKOFF_MAX 1000
+
+// Server Structure (shared by every connection, the last user frees it)
+typedef struct {
+    Js2basOptions options;
+    int stats;          // 1 reports each request's statistics, 2 as JSON
+    Sink *report;       // the server's diagnostics
+    pthread_mutex_t lock;   // held while writing to report or counting users
+    unsigned users;     // serve() and the open connections
+} Server;
+
+// Connection Structure (everything a request needs, reused by the next one)
+typedef struct {
+    int fd;
+    char *buffer;       // received bytes, complete requests are consumed
+    size_t length;
+    size_t capacity;
+    Server *server;
+    Js2basContext *ctx;     // translates with the server's options
+    Sink body;          // generated code of the current request
+    Sink diag;          // diagnostics of the current request
+    Sink out;           // responses on their way to the socket
+} Connection;
+
+// Decode a big endian number
+static uint32_t get_u32(const char *data) {
+    const unsigned char *p = (const unsigned char *)data;
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+// Append a big endian number
+static void put_u32(Sink *sink, uint32_t value) {
+    char data[4] = { (char)(value >> 24), (char)(value >> 16), (char)(value >> 8), (char)value };
+    sink_write(sink, data, sizeof(data));
+}
+
+// Collect what the library hands over in a memory sink
+static int write_sink(void *user, const char *data, size_t length) {
+    Sink *sink = user;
+
+    sink_write(sink, data, length);
+    return sink->error;
+}
+
+// Pass warnings and statistics of a request on to the server's diagnostics
+static void serve_report(Connection *c, int status) {
+    Server *server = c->server;
+    Js2basSink diag = { write_sink, &c->diag };
+
+    if (status != SERVE_OK) {
+        sink_reset(&c->diag);   // the client already has the errors
+    }
+    if (server->stats && js2bas_stats(c->ctx) != NULL) {
+        js2bas_stats_write(js2bas_stats(c->ctx), server->stats == 2, &diag);
+    }
+    if (c->diag.length > 0) {
+        pthread_mutex_lock(&server->lock);
+        sink_append(server->report, &c->diag);
+        sink_flush(server->report);
+        pthread_mutex_unlock(&server->lock);
+    }
+}
+
+// Translate one request and queue its response
+static void serve_request(Connection *c, const char *source, size_t length) {
+    Js2basSink body = { write_sink, &c->body }, diag = { write_sink, &c->diag };
+    int status = SERVE_OK;
+    Sink *reply;
+
+    if (js2bas_translate(c->ctx, source, length, &body, &diag) != JS2BAS_OK) {
+        status = SERVE_ERROR;
+    }
+    if (c->body.error != 0 || c->diag.error != 0) {
+        sink_reset(&c->diag);
+        sink_literal(&c->diag, "Error: Out of memory.\n");
+        status = SERVE_ERROR;
+    }
+
+    reply = status == SERVE_OK ? &c->body : &c->diag;
+    put_u32(&c->out, status);
+    put_u32(&c->out, (uint32_t)reply->length);
+    sink_append(&c->out, reply);
+    sink_reset(&c->body);
+    serve_report(c, status);
+    sink_reset(&c->diag);
+    c->body.error = c->diag.error = 0;
+}
+
+// Write a message to the server's diagnostics, connections write there too
+static void server_log(Server *server, const char *format, const char *path, int error) {
+    pthread_mutex_lock(&server->lock);
+    sink_printf(server->report, format, path, strerror(error));
+    sink_flush(server->report);
+    pthread_mutex_unlock(&server->lock);
+}
+
+// Drop a user of the server, freeing it with the last one
+static void server_release(Server *server) {
+    unsigned users;
+
+    pthread_mutex_lock(&server->lock);
+    users = --server->users;
+    pthread_mutex_unlock(&server->lock);
+    if (users == 0) {
+        pthread_mutex_destroy(&server->lock);
+        free(server);
+    }
+}
+
+// Serve one connection until the peer closes it
+static void *serve_connection(void *context) {
+    Connection *c = context;
+
+    for (;;) {
+        size_t offset = 0;
+        ssize_t nbytes;
+
+        if (c->capacity - c->length < SERVE_READ) {
+            size_t capacity = c->capacity ? c->capacity * 2 : 2 * SERVE_READ;
+            char *tmp = realloc(c->buffer, capacity);
+            if (tmp == NULL) {
+                break;
+            }
+            c->buffer = tmp;
+            c->capacity = capacity;
+        }
+        if ((nbytes = read(c->fd, c->buffer + c->length, c->capacity - c->length)) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (nbytes == 0) {
+            break;
+        }
+        c->length += (size_t)nbytes;
+
+        // Every complete request in the buffer, responses go out together
+        while (c->length - offset >= 4) {
+            uint32_t size = get_u32(c->buffer + offset);
+            if (size > SERVE_MAX_REQUEST) {
+                c->length = offset;
+                goto done;
+            }
+            if (c->length - offset - 4 < size) {
+                break;
+            }
+            serve_request(c, c->buffer + offset + 4, size);
+            offset += 4 + (size_t)size;
+            if (c->out.length > SERVE_BATCH && sink_flush(&c->out) < 0) {
+                goto done;
+            }
+        }
+        if (sink_flush(&c->out) < 0) {
+            break;
+        }
+        memmove(c->buffer, c->buffer + offset, c->length - offset);
+        c->length -= offset;
+    }
+
+done:
+    close(c->fd);
+    js2bas_destroy(c->ctx);
+    sink_free(&c->body);
+    sink_free(&c->diag);
+    sink_free(&c->out);
+    free(c->buffer);
+    server_release(c->server);
+    free(c);
+    return NULL;
+}
+
+// Accept connections on the socket at path, one thread per connection.
+// Requests are translated with options, warnings and (with stats) the
+// statistics of each request go to diag. Running out of descriptors or
+// memory only holds off accepting for a while.
+int serve(const char *path, const Js2basOptions *options, int stats, Sink *diag) {
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    Server *server;
+    pthread_attr_t attr;
+    struct stat st;
+    int fd, backoff = 0;
+
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        sink_printf(diag, "Error: Socket path '%s' is too long.\n", path);
+        return 1;
+    }
+    strcpy(address.sun_path, path);
+
+    // A socket left over from an earlier server is replaced
+    if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(path);
+    }
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0
+            || bind(fd, (struct sockaddr *)&address, sizeof(address)) < 0
+            || listen(fd, 128) < 0) {
+        sink_printf(diag, "Error: Cannot listen on '%s': %s.\n", path, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+        return 1;
+    }
+
+    if ((server = calloc(1, sizeof(Server))) == NULL) {
+        sink_literal(diag, "Error: Out of memory.\n");
+        close(fd);
+        return 1;
+    }
+    if (options != NULL) {
+        server->options = *options;
+    }
+    server->options.stats = stats != 0;
+    server->options.names = (Js2basSink){ NULL, NULL };  // no map for a request
+    server->stats = stats;
+    server->report = diag;
+    server->users = 1;
+    pthread_mutex_init(&server->lock, NULL);
+    signal(SIGPIPE, SIG_IGN);  // a client going away only ends its connection
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    for (;;) {
+        Connection *c;
+        pthread_t thread;
+        int client = accept(fd, NULL, NULL);
+
+        if (client < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                // Connections closing give the resources back
+                backoff = backoff ? backoff * 2 : SERVE_BACKOFF_MIN;
+                backoff = backoff < SERVE_BACKOFF_MAX ? backoff : SERVE_BACKOFF_MAX;
+                server_log(server, "Warning: Cannot accept on '%s': %s, waiting.\n", path, errno);
+                usleep(backoff * 1000);
+                continue;
+            }
+            server_log(server, "Error: Cannot accept on '%s': %s.\n", path, errno);
+            break;
+        }
+        backoff = 0;
+        if ((c = calloc(1, sizeof(Connection))) == NULL
+                || (c->ctx = js2bas_create(NULL, &server->options)) == NULL) {
+            close(client);
+            free(c);
+            continue;
+        }
+        c->fd = client;
+        c->server = server;
+        sink_init_memory(&c->body);
+        sink_init_memory(&c->diag);
+        sink_init_fd(&c->out, client);
+        pthread_mutex_lock(&server->lock);
+        server->users++;
+        pthread_mutex_unlock(&server->lock);
+        if (pthread_create(&thread, &attr, serve_connection, c) != 0) {
+            close(client);
+            js2bas_destroy(c->ctx);
+            free(c);
+            server_release(server);
+        }
+    }
+
+    pthread_attr_destroy(&attr);
+    close(fd);
+    server_release(server);
+    return 1;
+}
@@ -0,0 +1,25 @@
+/*
+ * server.h - Translation server on a Unix domain socket.
+ *
+ * Author: Philip R. Simonson
+ * Date: 10/17/2026
+ *
+ * Protocol (all numbers are 32 bit, big endian):
+ *   request:  length, source bytes
+ *   response: status, length, bytes (BASIC when status is 0, otherwise
+ *             the diagnostics)
+ * Requests may be pipelined, responses come back in request order.
+ *
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Largest request the server accepts
+#define SERVE_MAX_REQUEST (256u << 20)
+
+// Response Status
+#define SERVE_OK 0
+#define SERVE_ERROR 1
+
+int serve(const char *path, const struct Js2basOptions *options, int stats, struct Sink *diag);
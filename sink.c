@@ -0,0 +1,271 @@
+/*
+ * sink.c - Buffered output sinks for the code generator.
+ *
+ * Author: Philip R. Simonson
+ * Date: 10/17/2026
+ *
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include "js2bas.h"
+#include "arena.h"
+#include "sink.h"
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+// Indentation is copied out of this string instead of written tab by tab
+static const char tabs[] =
+    "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t"
+    "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t";
+
+// Initialize a sink without a destination
+static void sink_init(Sink *sink, SinkType type) {
+    memset(sink, 0, sizeof(Sink));
+    sink->type = type;
+    sink->fd = -1;
+}
+
+// Initialize a sink collecting output in memory
+void sink_init_memory(Sink *sink) {
+    sink_init(sink, SINK_MEMORY);
+}
+
+// Initialize a sink flushing to a stream
+void sink_init_file(Sink *sink, FILE *fp) {
+    sink_init(sink, SINK_FILE);
+    sink->fp = fp;
+}
+
+// Initialize a sink flushing to a file descriptor
+void sink_init_fd(Sink *sink, int fd) {
+    sink_init(sink, SINK_FD);
+    sink->fd = fd;
+}
+
+// Initialize a sink flushing to a write callback
+void sink_init_callback(Sink *sink, int (*write)(void *user, const char *data, size_t length), void *user) {
+    sink_init(sink, SINK_CALLBACK);
+    sink->write = write;
+    sink->user = user;
+}
+
+// Add an empty chunk to the end of the chain
+static SinkChunk *sink_grow(Sink *sink) {
+    SinkChunk *chunk = sink->spare;
+
+    if (chunk != NULL) {
+        sink->spare = chunk->next;
+    } else if ((chunk = allocator_alloc(sink->allocator, sizeof(SinkChunk))) == NULL) {
+        sink->error = ENOMEM;
+        return NULL;
+    }
+    chunk->next = NULL;
+    chunk->used = 0;
+    if (sink->tail != NULL) {
+        sink->tail->next = chunk;
+    } else {
+        sink->head = chunk;
+    }
+    sink->tail = chunk;
+    return chunk;
+}
+
+// Append bytes to the sink, starting new chunks as they fill up
+// (sink_write() copies into the current chunk inline)
+void sink_write_chunks(Sink *sink, const char *data, size_t length) {
+    SinkChunk *chunk = sink->tail;
+
+    while (length > 0) {
+        if (chunk == NULL || chunk->used == SINK_CHUNK) {
+            if ((chunk = sink_grow(sink)) == NULL) {
+                return;
+            }
+        }
+        size_t n = SINK_CHUNK - chunk->used;
+        if (n > length) {
+            n = length;
+        }
+        memcpy(chunk->data + chunk->used, data, n);
+        chunk->used += n;
+        sink->length += n;
+        data += n;
+        length -= n;
+    }
+}
+
+// Append a string
+void sink_puts(Sink *sink, const char *text) {
+    sink_write(sink, text, strlen(text));
+}
+
+// Append depth tabs
+void sink_indent(Sink *sink, int depth) {
+    while (depth > 0) {
+        int n = depth < (int)sizeof(tabs) - 1 ? depth : (int)sizeof(tabs) - 1;
+        sink_write(sink, tabs, n);
+        depth -= n;
+    }
+}
+
+// Append formatted text (diagnostics, not used on the hot path)
+void sink_printf(Sink *sink, const char *format, ...) {
+    char buffer[512];
+    char *text = buffer;
+    va_list args;
+    int length;
+
+    va_start(args, format);
+    length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (length < 0) {
+        return;
+    }
+    if ((size_t)length >= sizeof(buffer)) {
+        if ((text = allocator_alloc(sink->allocator, length + 1)) == NULL) {
+            sink->error = ENOMEM;
+            return;
+        }
+        va_start(args, format);
+        vsnprintf(text, length + 1, format, args);
+        va_end(args);
+    }
+    sink_write(sink, text, length);
+    if (text != buffer) {
+        allocator_free(sink->allocator, text);
+    }
+}
+
+// Move everything pending in another sink to the end of this one
+void sink_append(Sink *sink, Sink *from) {
+    for (SinkChunk *chunk = from->head; chunk != NULL; chunk = chunk->next) {
+        sink_write(sink, chunk->data, chunk->used);
+    }
+    sink_reset(from);
+}
+
+// Copy pending output into one terminated string, allocated with the
+// sink's allocator (caller frees with allocator_free(sink->allocator, ...))
+char *sink_contents(Sink *sink, size_t *length) {
+    char *text = allocator_alloc(sink->allocator, sink->length + 1);
+    size_t offset = 0;
+
+    if (text == NULL) {
+        return NULL;
+    }
+    for (SinkChunk *chunk = sink->head; chunk != NULL; chunk = chunk->next) {
+        memcpy(text + offset, chunk->data, chunk->used);
+        offset += chunk->used;
+    }
+    text[offset] = '\0';
+    if (length != NULL) {
+        *length = offset;
+    }
+    return text;
+}
+
+// Write all chunks to the file descriptor, one writev() per 64 chunks
+static int flush_fd(Sink *sink) {
+    struct iovec iov[64];
+    SinkChunk *chunk = sink->head;
+    size_t skip = 0;
+
+    while (chunk != NULL) {
+        int count = 0;
+        SinkChunk *next = chunk;
+        size_t offset = skip;
+        while (next != NULL && count < (int)(sizeof(iov) / sizeof(iov[0])) && count < IOV_MAX) {
+            iov[count].iov_base = next->data + offset;
+            iov[count].iov_len = next->used - offset;
+            offset = 0;
+            count++;
+            next = next->next;
+        }
+
+        ssize_t nbytes = writev(sink->fd, iov, count);
+        if (nbytes < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+
+        // Step over what was written, a short write resumes mid chunk
+        while (chunk != NULL && nbytes > 0) {
+            size_t left = chunk->used - skip;
+            if ((size_t)nbytes < left) {
+                skip += nbytes;
+                nbytes = 0;
+            } else {
+                nbytes -= left;
+                skip = 0;
+                chunk = chunk->next;
+            }
+        }
+    }
+    return 0;
+}
+
+// Write pending output to the destination
+int sink_flush(Sink *sink) {
+    int result = 0;
+
+    if (sink->type == SINK_MEMORY) {
+        return sink->error ? -1 : 0;
+    }
+    if (sink->type == SINK_FD) {
+        result = flush_fd(sink);
+    } else if (sink->type == SINK_CALLBACK) {
+        for (SinkChunk *chunk = sink->head; chunk != NULL && result == 0; chunk = chunk->next) {
+            if (sink->write(sink->user, chunk->data, chunk->used) != 0) {
+                errno = EIO;
+                result = -1;
+            }
+        }
+    } else {
+        for (SinkChunk *chunk = sink->head; chunk != NULL && result == 0; chunk = chunk->next) {
+            if (fwrite(chunk->data, 1, chunk->used, sink->fp) != chunk->used) {
+                result = -1;
+            }
+        }
+        if (result == 0 && fflush(sink->fp) != 0) {
+            result = -1;
+        }
+    }
+    if (result < 0 && sink->error == 0) {
+        sink->error = errno ? errno : EIO;
+    }
+    sink_reset(sink);
+    return sink->error ? -1 : 0;
+}
+
+// Drop pending output, chunks are kept for reuse
+void sink_reset(Sink *sink) {
+    if (sink->tail != NULL) {
+        sink->tail->next = sink->spare;
+        sink->spare = sink->head;
+    }
+    sink->head = sink->tail = NULL;
+    sink->length = 0;
+}
+
+// Free all chunks of the sink
+void sink_free(Sink *sink) {
+    sink_reset(sink);
+    while (sink->spare != NULL) {
+        SinkChunk *next = sink->spare->next;
+        allocator_free(sink->allocator, sink->spare);
+        sink->spare = next;
+    }
+}
+
@@ -0,0 +1,88 @@
+/*
+ * sink.h - Buffered output sinks for the code generator.
+ *
+ * Author: Philip R. Simonson
+ * Date: 10/17/2026
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+// Size of a single output chunk
+#define SINK_CHUNK 65536
+
+// Sink Types
+typedef enum {
+    SINK_MEMORY,    // keeps everything until taken or reset
+    SINK_FILE,      // flushes to a FILE stream
+    SINK_FD,        // flushes to a file descriptor with one writev()
+    SINK_CALLBACK   // flushes chunk by chunk to a write callback
+} SinkType;
+
+// Sink Chunk Structure
+typedef struct SinkChunk {
+    struct SinkChunk *next;
+    size_t used;
+    char data[SINK_CHUNK];
+} SinkChunk;
+
+// Sink Structure (output is collected in a chain of chunks)
+typedef struct Sink {
+    SinkType type;
+    FILE *fp;
+    int fd;
+    int (*write)(void *user, const char *data, size_t length);
+    void *user;
+    const struct Js2basAllocator *allocator;  // chunks, NULL for malloc()
+    int error;          // set when a flush failed
+    size_t batch;       // callers flush once more than this is pending
+    size_t length;      // bytes pending in the chain
+    SinkChunk *head;
+    SinkChunk *tail;
+    SinkChunk *spare;   // chunks kept for reuse after a flush
+} Sink;
+
+// Append a string literal without a strlen() call
+#define sink_literal(sink, text) sink_write((sink), (text), sizeof(text) - 1)
+
+void sink_init_memory(Sink *sink);
+void sink_init_file(Sink *sink, FILE *fp);
+void sink_init_fd(Sink *sink, int fd);
+void sink_init_callback(Sink *sink, int (*write)(void *user, const char *data, size_t length), void *user);
+void sink_write_chunks(Sink *sink, const char *data, size_t length);
+void sink_puts(Sink *sink, const char *text);
+void sink_indent(Sink *sink, int depth);
+void sink_printf(Sink *sink, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+void sink_append(Sink *sink, Sink *from);
+char *sink_contents(Sink *sink, size_t *length);
+int sink_flush(Sink *sink);
+void sink_reset(Sink *sink);
+void sink_free(Sink *sink);
+
+// Most writes are a few bytes into a chunk with room left, those are
+// copied inline and only starting a new chunk is a call.
+static inline void sink_write(Sink *sink, const char *data, size_t length) {
+    SinkChunk *chunk = sink->tail;
+
+    if (chunk != NULL && length <= SINK_CHUNK - chunk->used) {
+        memcpy(chunk->data + chunk->used, data, length);
+        chunk->used += length;
+        sink->length += length;
+    } else {
+        sink_write_chunks(sink, data, length);
+    }
+}
+
+// Append a single character
+static inline void sink_putc(Sink *sink, char c) {
+    SinkChunk *chunk = sink->tail;
+
+    if (chunk != NULL && chunk->used < SINK_CHUNK) {
+        chunk->data[chunk->used++] = c;
+        sink->length++;
+    } else {
+        sink_write_chunks(sink, &c, 1);
+    }
+}
@@ -0,0 +1,138 @@
+/*
+ * stats.c - Counters and timers behind --stats and js2bas_stats().
+ *
+ * Author: Philip R. Simonson
+ * Date: 10/17/2026
+ *
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "js2bas.h"
+#include "arena.h"
+#include "sink.h"
+#include "symbols.h"
+#include "token.h"
+#include "parse.h"
+#include "stats.h"
+
+_Static_assert(TOKEN_UNKNOWN + 1 == JS2BAS_TOKEN_TYPES, "JS2BAS_TOKEN_TYPES is out of date");
+_Static_assert(AST_EQUALS + 1 == JS2BAS_NODE_TYPES, "JS2BAS_NODE_TYPES is out of date");
+
+// Names in the order of the enums
+static const char *phase_names[JS2BAS_PHASES] = {
+    "load", "tokenize", "parse", "generate"
+};
+static const char *token_names[JS2BAS_TOKEN_TYPES] = {
+    "EOF", "NUMBER", "STRING", "OPERATOR", "IDENTIFIER", "LPAREN", "RPAREN",
+    "LBRACE", "RBRACE", "SEMICOLON", "EQUALS", "ASSIGN", "REM", "IF", "THEN",
+    "ELSE", "PRINT", "INPUT", "WHILE", "EXIT", "UNKNOWN"
+};
+static const char *node_names[JS2BAS_NODE_TYPES] = {
+    "NUMBER", "STRING", "IDENTIFIER", "BINARY_OP", "IF", "REM", "PRINT",
+    "ASSIGN", "INPUT", "WHILE", "EXIT", "EQUALS"
+};
+
+// Wall clock in seconds
+double stats_wall(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// CPU time of the calling thread in seconds
+double stats_cpu(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Count one node by type and track the deepest one
+static void count_node(const Ast *ast, AstIndex node, size_t depth, void *user) {
+    Js2basStats *stats = user;
+
+    stats->nodes[ast->type[node]]++;
+    if (depth > stats->max_depth) {
+        stats->max_depth = depth;
+    }
+}
+
+// Count the nodes of a statement, returns -1 when out of memory
+int stats_count(Js2basStats *stats, const Ast *ast, AstIndex root, Arena *arena) {
+    return ast_walk(ast, root, arena, count_node, stats);
+}
+
+// Fill in what is only known at the end of a translation
+void stats_finish(Js2basStats *stats) {
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        stats->peak_rss = usage.ru_maxrss;
+    }
+}
+
+// Write statistics as a readable table or as JSON
+void stats_write(const Js2basStats *stats, int json, Sink *out) {
+    double wall = 0, cpu = 0;
+    size_t tokens = 0, nodes = 0;
+
+    for (int i = 0; i < JS2BAS_PHASES; ++i) {
+        wall += stats->wall[i];
+        cpu += stats->cpu[i];
+    }
+    for (int i = 0; i < JS2BAS_TOKEN_TYPES; ++i) {
+        tokens += stats->tokens[i];
+    }
+    for (int i = 0; i < JS2BAS_NODE_TYPES; ++i) {
+        nodes += stats->nodes[i];
+    }
+
+    if (json) {
+        sink_literal(out, "{\n  \"phases\": {");
+        for (int i = 0; i < JS2BAS_PHASES; ++i) {
+            sink_printf(out, "%s\n    \"%s\": { \"wall\": %.6f, \"cpu\": %.6f }",
+                i ? "," : "", phase_names[i], stats->wall[i], stats->cpu[i]);
+        }
+        sink_printf(out, "\n  },\n  \"wall\": %.6f,\n  \"cpu\": %.6f,\n  \"tokens\": {", wall, cpu);
+        for (int i = 0; i < JS2BAS_TOKEN_TYPES; ++i) {
+            sink_printf(out, "%s \"%s\": %zu", i ? "," : "", token_names[i], stats->tokens[i]);
+        }
+        sink_literal(out, " },\n  \"nodes\": {");
+        for (int i = 0; i < JS2BAS_NODE_TYPES; ++i) {
+            sink_printf(out, "%s \"%s\": %zu", i ? "," : "", node_names[i], stats->nodes[i]);
+        }
+        sink_printf(out, " },\n  \"statements\": %zu,\n  \"max_depth\": %zu,\n  \"bytes_out\": %zu,\n"
+            "  \"allocations\": %zu,\n  \"allocated_bytes\": %zu,\n  \"peak_rss_kb\": %ld\n}\n",
+            stats->statements, stats->max_depth, stats->bytes_out,
+            stats->allocations, stats->allocated_bytes, stats->peak_rss);
+        return;
+    }
+
+    sink_literal(out, "Phase         Wall (ms)    CPU (ms)\n");
+    for (int i = 0; i < JS2BAS_PHASES; ++i) {
+        sink_printf(out, "%-10s %12.3f %11.3f\n", phase_names[i], stats->wall[i] * 1e3, stats->cpu[i] * 1e3);
+    }
+    sink_printf(out, "%-10s %12.3f %11.3f\n\n", "total", wall * 1e3, cpu * 1e3);
+
+    sink_printf(out, "Tokens: %zu\n", tokens);
+    for (int i = 0; i < JS2BAS_TOKEN_TYPES; ++i) {
+        if (stats->tokens[i] > 0) {
+            sink_printf(out, "  %-12s %zu\n", token_names[i], stats->tokens[i]);
+        }
+    }
+    sink_printf(out, "Nodes: %zu\n", nodes);
+    for (int i = 0; i < JS2BAS_NODE_TYPES; ++i) {
+        if (stats->nodes[i] > 0) {
+            sink_printf(out, "  %-12s %zu\n", node_names[i], stats->nodes[i]);
+        }
+    }
+    sink_printf(out, "Statements: %zu\nMaximum depth: %zu\nBytes emitted: %zu\n"
+        "Allocations: %zu (%zu bytes)\nPeak RSS: %ld KB\n",
+        stats->statements, stats->max_depth, stats->bytes_out,
+        stats->allocations, stats->allocated_bytes, stats->peak_rss);
+}
@@ -0,0 +1,24 @@
+/*
+ * stats.h - Counters and timers behind --stats and js2bas_stats().
+ *
+ * Author: Philip R. Simonson
+ * Date: 10/17/2026
+ *
+ */
+
+// Statistics are collected when a Js2basStats is handed down, building
+// with -DJS2BAS_NO_STATS leaves every counter and timer out
+#ifdef JS2BAS_NO_STATS
+#define STATS_ENABLED(stats) 0
+#else
+#define STATS_ENABLED(stats) ((stats) != NULL)
+#endif
+
+struct Ast;  // the lexer has no use for parse.h
+struct Arena;
+
+double stats_wall(void);
+double stats_cpu(void);
+int stats_count(struct Js2basStats *stats, const struct Ast *ast, uint32_t root, struct Arena *arena);
+void stats_finish(struct Js2basStats *stats);
+void stats_write(const struct Js2basStats *stats, int json, struct Sink *out);
@@ -0,0 +1,222 @@
+/*
+ * symbols.c - Interned identifiers with dense ids, shared by every pass.
+ *
+ * Author: Philip R. Simonson
+ * Date: 10/17/2026
+ *
+ * The parser interns every identifier it reads, so the syntax tree only
+ * holds ids: comparing two variables is comparing two integers, and the
+ * passes keep what they know about a variable in arrays indexed by id.
+ * For --compact every symbol gets a short name, the most used ones
+ * (counting uses in loops many times over) the shortest.
+ *
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "js2bas.h"
+#include "arena.h"
+#include "symbols.h"
+
+// Initialize an empty symbol table
+void symbols_init(SymbolTable *symbols, const struct Js2basAllocator *allocator) {
+    memset(symbols, 0, sizeof(SymbolTable));
+    symbols->allocator = allocator;
+}
+
+// Forget every symbol, keeping the arrays for the next translation
+void symbols_reset(SymbolTable *symbols) {
+    for (uint32_t i = 0; i < symbols->count; ++i) {
+        allocator_free(symbols->allocator, symbols->symbols[i].name);
+    }
+    symbols->count = 0;
+    if (symbols->table != NULL) {
+        memset(symbols->table, 0, sizeof(uint32_t) * symbols->size);
+    }
+}
+
+// Free the symbol table
+void symbols_free(SymbolTable *symbols) {
+    symbols_reset(symbols);
+    allocator_free(symbols->allocator, symbols->symbols);
+    allocator_free(symbols->allocator, symbols->table);
+    memset(symbols, 0, sizeof(SymbolTable));
+}
+
+// Hash a name
+static size_t name_hash(const char *name, size_t length) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+
+    for (size_t i = 0; i < length; ++i) {
+        hash = (hash ^ (unsigned char)name[i]) * 0x100000001b3ull;
+    }
+    return (size_t)hash;
+}
+
+// Find the slot of a name, or the empty slot it would go into
+static uint32_t *lookup(const SymbolTable *symbols, const char *name, size_t length) {
+    size_t i = name_hash(name, length) & (symbols->size - 1);
+
+    while (symbols->table[i] != 0) {
+        const Symbol *symbol = &symbols->symbols[symbols->table[i] - 1];
+        if (symbol->length == length && memcmp(symbol->name, name, length) == 0) {
+            break;
+        }
+        i = (i + 1) & (symbols->size - 1);
+    }
+    return &symbols->table[i];
+}
+
+// Id of a name, added if new; SYMBOL_NONE when out of memory
+uint32_t symbol_intern(SymbolTable *symbols, const char *name, size_t length) {
+    Symbol *symbol;
+    uint32_t *slot;
+
+    if ((size_t)symbols->count * 2 >= symbols->size) {
+        size_t size = symbols->size ? symbols->size * 2 : 256;
+        uint32_t *table;
+
+        if ((table = allocator_alloc(symbols->allocator, sizeof(uint32_t) * size)) == NULL) {
+            return SYMBOL_NONE;
+        }
+        memset(table, 0, sizeof(uint32_t) * size);
+        allocator_free(symbols->allocator, symbols->table);
+        symbols->table = table;
+        symbols->size = size;
+        for (uint32_t id = 0; id < symbols->count; ++id) {
+            *lookup(symbols, symbols->symbols[id].name, symbols->symbols[id].length) = id + 1;
+        }
+    }
+
+    slot = lookup(symbols, name, length);
+    if (*slot != 0) {
+        return *slot - 1;
+    }
+    if (symbols->count == symbols->capacity) {
+        uint32_t capacity = symbols->capacity ? symbols->capacity * 2 : 64;
+        Symbol *tmp = allocator_resize(symbols->allocator, symbols->symbols, sizeof(Symbol) * capacity);
+        if (tmp == NULL) {
+            return SYMBOL_NONE;
+        }
+        symbols->symbols = tmp;
+        symbols->capacity = capacity;
+    }
+    symbol = &symbols->symbols[symbols->count];
+    memset(symbol, 0, sizeof(Symbol));
+    if ((symbol->name = allocator_alloc(symbols->allocator, length > 0 ? length : 1)) == NULL) {
+        return SYMBOL_NONE;
+    }
+    memcpy(symbol->name, name, length);
+    symbol->length = (uint32_t)length;
+    *slot = symbols->count + 1;
+    return symbols->count++;
+}
+
+// Count a read or write of a symbol inside loops enclosing loops
+void symbol_use(Symbol *symbol, int write, unsigned loops) {
+    uint64_t weight = 1;
+
+    if (write) {
+        symbol->writes++;
+    } else {
+        symbol->reads++;
+    }
+    for (unsigned i = 0; i < loops && i < SYMBOL_LOOP_MAX; ++i) {
+        weight *= SYMBOL_LOOP_WEIGHT;
+    }
+    symbol->weighted += weight;
+}
+
+// Characters after the first of a short name
+static const char alias_chars[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+// Short names GW-BASIC would take for a keyword or a function call
+static const char *const reserved[] = {
+    "AS", "FN", "IF", "ON", "OR", "TO",
+    "ABS", "AND", "ASC", "ATN", "CLS", "COM", "COS", "CVD", "CVI", "CVS",
+    "DEF", "DIM", "END", "EOF", "EQV", "ERL", "ERR", "EXP", "FIX", "FOR",
+    "FRE", "GET", "IMP", "INP", "INT", "KEY", "LEN", "LET", "LOC", "LOF",
+    "LOG", "MOD", "NEW", "NOT", "OCT", "OFF", "OUT", "PEN", "POS", "PUT",
+    "RUN", "SGN", "SIN", "SPC", "SQR", "STR", "TAB", "TAN", "USR", "VAL",
+    "XOR"
+};
+
+// Write the short name with a number: A to Z, then A0 to ZZ, then A00 and
+// so on; returns its length
+size_t symbol_alias_name(uint32_t alias, char *name) {
+    uint64_t count = 26, index = alias;
+    size_t length = 1;
+
+    while (index >= count && length + 1 < SYMBOL_ALIAS_MAX) {
+        index -= count;
+        count *= sizeof(alias_chars) - 1;
+        length++;
+    }
+    for (size_t i = length; i-- > 1;) {
+        name[i] = alias_chars[index % (sizeof(alias_chars) - 1)];
+        index /= sizeof(alias_chars) - 1;
+    }
+    name[0] = (char)('A' + index);
+    name[length] = '\0';
+    return length;
+}
+
+// Whether a short name is taken by GW-BASIC (names starting with FN call
+// a function)
+static int alias_reserved(const char *name, size_t length) {
+    if (length >= 2 && name[0] == 'F' && name[1] == 'N') {
+        return 1;
+    }
+    for (size_t i = 0; i < sizeof(reserved) / sizeof(reserved[0]); ++i) {
+        if (strcmp(reserved[i], name) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Symbol in the order of short names
+typedef struct {
+    uint64_t weighted;
+    uint32_t id;
+} AliasOrder;
+
+// Most weighted uses first, then first seen
+static int by_weight(const void *a, const void *b) {
+    const AliasOrder *x = a, *y = b;
+
+    if (x->weighted != y->weighted) {
+        return x->weighted < y->weighted ? 1 : -1;
+    }
+    return x->id < y->id ? -1 : 1;
+}
+
+// Give every symbol a distinct short name that is not a keyword; returns
+// -1 when out of memory
+int symbols_alias(SymbolTable *symbols) {
+    char name[SYMBOL_ALIAS_MAX];
+    AliasOrder *order;
+    uint32_t alias = 0;
+
+    if (symbols->count == 0) {
+        return 0;
+    }
+    if ((order = allocator_alloc(symbols->allocator, sizeof(AliasOrder) * symbols->count)) == NULL) {
+        return -1;
+    }
+    for (uint32_t id = 0; id < symbols->count; ++id) {
+        order[id] = (AliasOrder){ symbols->symbols[id].weighted, id };
+    }
+    qsort(order, symbols->count, sizeof(AliasOrder), by_weight);
+    for (uint32_t i = 0; i < symbols->count; ++i) {
+        while (alias_reserved(name, symbol_alias_name(alias, name))) {
+            alias++;
+        }
+        symbols->symbols[order[i].id].alias = alias++;
+    }
+    allocator_free(symbols->allocator, order);
+    return 0;
+}
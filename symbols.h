@@ -0,0 +1,61 @@
+/*
+ * symbols.h - Interned identifiers with dense ids, shared by every pass.
+ *
+ * Author: Philip R. Simonson
+ * Date: 10/17/2026
+ *
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Id of no symbol (also returned when out of memory)
+#define SYMBOL_NONE UINT32_MAX
+
+// Longest short name given by symbols_alias(), with room for the '\0'
+#define SYMBOL_ALIAS_MAX 8
+
+// Weight of a use per enclosing loop, and the deepest loop that counts
+#define SYMBOL_LOOP_WEIGHT 8
+#define SYMBOL_LOOP_MAX 10
+
+// Types of Values (as the BASIC interpreter sees them)
+typedef enum {
+    KIND_UNKNOWN,
+    KIND_INTEGER,
+    KIND_LONG,
+    KIND_SINGLE,
+    KIND_DOUBLE,        // only inferred, never folded
+    KIND_STRING
+} ValueKind;
+
+// Symbol Structure (one per distinct identifier; names are copied, the
+// source goes away)
+typedef struct {
+    char *name;
+    uint32_t length;
+    ValueKind kind;     // inferred type, KIND_UNKNOWN without inference
+    unsigned declared;  // line of its first declaration, 0 for none
+    uint32_t reads;
+    uint32_t writes;
+    uint64_t weighted;  // reads and writes, SYMBOL_LOOP_WEIGHT times more per enclosing loop
+    uint32_t alias;     // short name under --compact, see symbol_alias_name()
+} Symbol;
+
+// Symbol Table Structure (one per translation, ids are indices)
+typedef struct SymbolTable {
+    const struct Js2basAllocator *allocator;
+    Symbol *symbols;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t *table;    // id + 1 by name, open addressing, 0 for empty
+    size_t size;
+} SymbolTable;
+
+void symbols_init(SymbolTable *symbols, const struct Js2basAllocator *allocator);
+void symbols_reset(SymbolTable *symbols);
+void symbols_free(SymbolTable *symbols);
+uint32_t symbol_intern(SymbolTable *symbols, const char *name, size_t length);
+void symbol_use(Symbol *symbol, int write, unsigned loops);
+int symbols_alias(SymbolTable *symbols);
+size_t symbol_alias_name(uint32_t alias, char *name);
@@ -0,0 +1,22 @@
+REM  Simple program for getting data.
+REM  Created by Philip R. Simonson.
+DIM value AS STRING
+DIM year AS INTEGER
+DIM company AS STRING
+DIM quit AS STRING
+DIM done AS INTEGER
+done = 1
+WHILE done
+	INPUT "Enter your name" ; value
+	INPUT "Enter your birth date" ; year
+	INPUT "Enter your company" ; company
+	year = 2024 - year
+	PRINT "Hello, " + value + " you work at " + company + " and are " , year , " old."
+	INPUT "Do you want to quit (Y/n)" ; quit
+	IF quit = "" THEN		
+		quit = "y"
+	END IF
+	IF quit = "y" THEN		
+		done = 0
+	END IF
+WEND
@@ -11,159 +11,221 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
+#include "js2bas.h"
+#include "input.h"
+#include "scan.h"
 #include "token.h"
+#include "stats.h"
 
-// Function to Tokenize Source Code
-Token *tokenize(const char *source) {
-    Token *tokens = malloc(sizeof(Token) * 4096);  // Dynamic array of tokens
-    int tokenIndex = 0;
-    int position = 0;
-    int line = 1;
-
-    while (tokenIndex < 4096 && *source) {
-        while (*source == ' ' || *source == '\t' || *source == '\r' || *source == '\n') {
-	    if (*source == '\n' || *source == '\r') {
-		    line++;
-	    }
-            source++;
-            position++;
+// Keyword Structure (a slot of the keyword table)
+typedef struct {
+    const char *text;
+    unsigned char length;
+    unsigned char type;
+} Keyword;
+
+// Keywords by (second character + length) & 15, which is different for
+// each of them; a new keyword needs a free slot or a new hash
+static const Keyword keywords[16] = {
+    [0] = { "else", 4, TOKEN_ELSE },
+    [3] = { "input", 5, TOKEN_INPUT },
+    [4] = { "var", 3, TOKEN_ASSIGN },
+    [7] = { "print", 5, TOKEN_PRINT },
+    [8] = { "if", 2, TOKEN_IF },
+    [12] = { "exit", 4, TOKEN_EXIT },
+    [13] = { "while", 5, TOKEN_WHILE },
+};
+
+// Classify an identifier lexeme as keyword or identifier, with one
+// table slot to compare against (a switch on length and first character
+// mispredicts on a mix of names, see bench/keywords.c)
+static TokenType keyword_type(const char *text, size_t length) {
+    const Keyword *keyword;
+
+    if (length < 2 || length > 5) {
+        return TOKEN_IDENTIFIER;
+    }
+    keyword = &keywords[((unsigned char)text[1] + length) & 15];
+    if (keyword->length == length && text[0] == keyword->text[0]
+            && memcmp(text + 1, keyword->text + 1, length - 1) == 0) {
+        return (TokenType)keyword->type;
+    }
+    return TOKEN_IDENTIFIER;
+}
+
+// Whether more input may still arrive for the lexer window
+static int more_input(const Lexer *lex) {
+    return lex->input != NULL && !lex->input->eof;
+}
+
+// Pull more input into the lexer window (moving it when full)
+static void lexer_fill(Lexer *lex) {
+    Input *in = lex->input;
+    size_t cursor, keep;
+
+    // Keep the text of buffered tokens, they have not been parsed yet
+    cursor = lex->base + (lex->cursor - lex->source);
+    keep = cursor;
+    if (lex->count > 0) {
+        keep = lex->base + (uint32_t)(lex->ring[lex->head].offset - (uint32_t)lex->base);
+    }
+
+    if (STATS_ENABLED(lex->stats)) {
+        // Reading is loading, even though it happens while lexing
+        double start = stats_wall(), start_cpu = stats_cpu();
+        input_fill(in, keep);
+        lex->stats->wall[JS2BAS_PHASE_LOAD] += stats_wall() - start;
+        lex->stats->cpu[JS2BAS_PHASE_LOAD] += stats_cpu() - start_cpu;
+    } else {
+        input_fill(in, keep);
+    }
+    lex->source = in->buffer;
+    lex->base = in->base;
+    lex->cursor = in->buffer + (cursor - in->base);
+    lex->end = in->buffer + in->length;
+}
+
+// Scan a single token starting at the lexer cursor
+static void lex_token(Lexer *lex, Token *token) {
+    for (;;) {
+        const char *source = lex->cursor;
+        const char *end = lex->end;
+        const char *start;
+
+        source = scan_space_run(source, end, &lex->line);
+        lex->cursor = source;
+
+        if (source >= end && more_input(lex)) {
+            lexer_fill(lex);
+            continue;
         }
 
-        if (isdigit(*source)) {
-            const char *start = source;
-            while (isdigit(*source)) source++;
-            tokens[tokenIndex].type = TOKEN_NUMBER;
-            tokens[tokenIndex].lexeme = strndup(start, source - start);
-            tokens[tokenIndex].position = position;
-	    tokens[tokenIndex].line = line;
-            position += source - start;
-            tokenIndex++;
-        } else if (isalpha(*source) || *source == '_') {
-            const char *start = source;
-            while (isalnum(*source) || *source == '_') source++;
-            tokens[tokenIndex].lexeme = strndup(start, source - start);
-            tokens[tokenIndex].position = position;
-	    tokens[tokenIndex].line = line;
-            position += source - start;
-
-            if (strcmp(tokens[tokenIndex].lexeme, "if") == 0) {
-                tokens[tokenIndex].type = TOKEN_IF;
-            } else if (strcmp(tokens[tokenIndex].lexeme, "else") == 0) {
-                tokens[tokenIndex].type = TOKEN_ELSE;
-            } else if (strcmp(tokens[tokenIndex].lexeme, "print") == 0) {
-                tokens[tokenIndex].type = TOKEN_PRINT;
-            } else if (strcmp(tokens[tokenIndex].lexeme, "input") == 0) {
-                tokens[tokenIndex].type = TOKEN_INPUT;
-	    } else if (strcmp(tokens[tokenIndex].lexeme, "while") == 0) {
-                tokens[tokenIndex].type = TOKEN_WHILE;
-	    } else if (strcmp(tokens[tokenIndex].lexeme, "exit") == 0) {
-                tokens[tokenIndex].type = TOKEN_EXIT;
-	    } else if (strcmp(tokens[tokenIndex].lexeme, "var") == 0) {
-                tokens[tokenIndex].type = TOKEN_ASSIGN;
-            } else {
-                tokens[tokenIndex].type = TOKEN_IDENTIFIER;
+        token->line = lex->line;
+
+        if (source >= end || *source == '\0') {
+            token->type = TOKEN_EOF;
+            token->offset = lex->base + (source - lex->source);
+            token->length = 0;
+            return;
+        }
+
+        // A token running into the end of the window is scanned again
+        // once more input has arrived.
+        start = source;
+        if (is_digit(*source)) {
+            source = scan_digits_run(source, end);
+            if (source >= end && more_input(lex)) {
+                lexer_fill(lex);
+                continue;
+            }
+            token->type = TOKEN_NUMBER;
+        } else if (is_ident_start(*source)) {
+            source = scan_ident_run(source, end);
+            if (source >= end && more_input(lex)) {
+                lexer_fill(lex);
+                continue;
+            }
+            token->type = keyword_type(start, source - start);
+        } else if ((*source == '=' || *source == '/') && source + 1 >= end && more_input(lex)) {
+            lexer_fill(lex);
+            continue;
+        } else if (*source == '=' && source + 1 < end && *(source+1) == '=') {
+            token->type = TOKEN_OPERATOR;
+            source += 2;
+        } else if (*source == '/' && source + 1 < end && *(source+1) == '/') {
+            source += 2;
+            start = source;
+            source = scan_line_run(source, end);
+            if (source >= end && more_input(lex)) {
+                lexer_fill(lex);
+                continue;
             }
-            tokenIndex++;
-	} else if (*source == '=' && *(source+1) == '=') {
-            tokens[tokenIndex].type = TOKEN_OPERATOR;
-            tokens[tokenIndex].lexeme = strndup(source, 2);
-            tokens[tokenIndex].position = position;
-	    tokens[tokenIndex].line = line;
-	    position += 2;
-	    tokenIndex++;
-	    source += 2;
-	} else if (*source == '/' && *(source+1) == '/') {
-	    source += 2;
-	    const char *start = source;
-            while (*source && *source != '\n' && *source != '\r') source++;
-	    const int length = source - start;
-            tokens[tokenIndex].type = TOKEN_REM;
-            tokens[tokenIndex].lexeme = strndup(start, length);
-            tokens[tokenIndex].position = position;
-	    tokens[tokenIndex].line = line;
-	    position += length;
-	    tokenIndex++;
-	} else if (*source == '"') {
-            const char *start = ++source;
-            while (*source && *source != '"') source++;
-	    tokens[tokenIndex].type = TOKEN_STRING;
-            tokens[tokenIndex].lexeme = strndup(start, source - start);
-            tokens[tokenIndex].position = position;
-	    tokens[tokenIndex].line = line;
-            position += source - start;
-	    tokenIndex++;
-	    source++;
+            token->type = TOKEN_REM;
+        } else if (*source == '"') {
+            start = ++source;
+            source = scan_quote_run(source, end);
+            if (source >= end && more_input(lex)) {
+                lexer_fill(lex);
+                continue;
+            }
+            token->type = TOKEN_STRING;
         } else {
             switch (*source) {
                 case '+': case '-': case '*': case '/':
-                    tokens[tokenIndex].type = TOKEN_OPERATOR;
-                    tokens[tokenIndex].lexeme = strndup(source, 1);
-                    break;
-                case '>':
-                    tokens[tokenIndex].type = TOKEN_OPERATOR;
-                    tokens[tokenIndex].lexeme = strndup(source, 1);
+                case '>': case '<': case ',':
+                    token->type = TOKEN_OPERATOR;
                     break;
-		case '<':
-                    tokens[tokenIndex].type = TOKEN_OPERATOR;
-                    tokens[tokenIndex].lexeme = strndup(source, 1);
-		    break;
                 case '=':
-                    tokens[tokenIndex].type = TOKEN_EQUALS;
-                    tokens[tokenIndex].lexeme = strndup(source, 1);
-		    break;
+                    token->type = TOKEN_EQUALS;
+                    break;
                 case ';':
-                    tokens[tokenIndex].type = TOKEN_SEMICOLON;
-                    tokens[tokenIndex].lexeme = strndup(source, 1);
+                    token->type = TOKEN_SEMICOLON;
                     break;
                 case '(':
-                    tokens[tokenIndex].type = TOKEN_LPAREN;
-                    tokens[tokenIndex].lexeme = strndup(source, 1);
+                    token->type = TOKEN_LPAREN;
                     break;
                 case ')':
-                    tokens[tokenIndex].type = TOKEN_RPAREN;
-                    tokens[tokenIndex].lexeme = strndup(source, 1);
+                    token->type = TOKEN_RPAREN;
                     break;
                 case '{':
-                    tokens[tokenIndex].type = TOKEN_LBRACE;
-                    tokens[tokenIndex].lexeme = strndup(source, 1);
+                    token->type = TOKEN_LBRACE;
                     break;
                 case '}':
-                    tokens[tokenIndex].type = TOKEN_RBRACE;
-                    tokens[tokenIndex].lexeme = strndup(source, 1);
-                    break;
-                case ',':
-                    tokens[tokenIndex].type = TOKEN_OPERATOR;
-                    tokens[tokenIndex].lexeme = strndup(source, 1);
-                    break;
-                case '\0':
-                    tokens[tokenIndex].type = TOKEN_EOF;
-                    tokens[tokenIndex].lexeme = strndup(source, 1);
+                    token->type = TOKEN_RBRACE;
                     break;
                 default:
-                    tokens[tokenIndex].type = TOKEN_UNKNOWN;
-                    tokens[tokenIndex].lexeme = strndup(source, 1);
+                    token->type = TOKEN_UNKNOWN;
             }
-            tokens[tokenIndex].position = position;
-            tokens[tokenIndex].line = line;
-            position++;
-            tokenIndex++;
             source++;
         }
+
+        token->offset = lex->base + (start - lex->source);
+        if ((size_t)(source - start) > TOKEN_MAX_LENGTH) {
+            token->type = TOKEN_UNKNOWN; // Lexeme too long to describe
+            token->length = TOKEN_MAX_LENGTH;
+        } else {
+            token->length = source - start;
+        }
+
+        if (token->type == TOKEN_STRING && source < end) {
+            source++; // Skip closing '"'
+        }
+        lex->cursor = source;
+        return;
     }
-    tokens[tokenIndex].type = TOKEN_EOF;
-    tokens[tokenIndex].lexeme = NULL;
-    tokens[tokenIndex].position = position;
-    tokens[tokenIndex].line = line;
-    return tokens;
 }
 
-// Free tokens
-void free_tokens(Token *tokens) {
-	for (int i = 0; tokens[i].type != TOKEN_EOF; ++i) {
-		free(tokens[i].lexeme); // Free each lexeme
-	}
-	free(tokens); // Free token array of pointers
+// Initialize lexer over a source buffer
+void lexer_init(Lexer *lex, const char *source, size_t length) {
+    scan_init();
+    memset(lex, 0, sizeof(Lexer));
+    lex->source = source;
+    lex->cursor = source;
+    lex->end = source + length;
+    lex->line = 1;
+}
+
+// Initialize lexer pulling its source from an input
+void lexer_init_input(Lexer *lex, Input *in) {
+    lexer_init(lex, in->buffer, in->length);
+    lex->input = in;
+    lex->base = in->base;
 }
 
+// Look at a token ahead of the current one without consuming it, lexing
+// up to it (peek_token() takes tokens already in the ring inline)
+Token *lexer_peek(Lexer *lex, unsigned ahead) {
+    if (ahead >= LEXER_LOOKAHEAD) {
+        ahead = LEXER_LOOKAHEAD - 1;
+    }
+    while (lex->count <= ahead) {
+        Token *token = &lex->ring[(lex->head + lex->count) & (LEXER_LOOKAHEAD - 1)];
+        lex_token(lex, token);
+        if (STATS_ENABLED(lex->stats)) {
+            lex->stats->tokens[token->type]++;  // timed per statement, see translate_lexer()
+        }
+        lex->count++;
+    }
+    return &lex->ring[(lex->head + ahead) & (LEXER_LOOKAHEAD - 1)];
+}
 
@@ -6,6 +6,9 @@
  *
  */
 
+#include <stddef.h>
+#include <stdint.h>
+
 // Token Types
 typedef enum {
     TOKEN_EOF,
@@ -31,14 +34,62 @@ typedef enum {
     TOKEN_UNKNOWN
 } TokenType;
 
-// Token Structure
+// Longest lexeme a token can describe
+#define TOKEN_MAX_LENGTH ((1u << 24) - 1)
+
+// Token Structure (12 bytes, lexeme lives in the source buffer; offsets
+// wrap around past 4 GB, which is fine since no window is larger, see
+// INPUT_WINDOW_MAX)
 typedef struct {
-    TokenType type;
-    char *lexeme;
-    int position;
-    int line;
+    uint32_t offset;
+    uint32_t length : 24;
+    uint32_t type : 8;
+    uint32_t line;
 } Token;
 
-Token *tokenize(const char *source);
-void free_tokens(Token *tokens);
+// Number of tokens the lexer can look ahead (must be a power of two)
+#define LEXER_LOOKAHEAD 8
+
+// Lexer Structure (tokens are produced on demand into a small ring buffer)
+typedef struct {
+    struct Input *input;  // optional, pulled from when the window runs out
+    struct Js2basStats *stats;  // optional, counts tokens
+    struct SymbolTable *symbols;  // the parser interns identifiers here, needed to parse
+    size_t base;          // input offset of source[0]
+    const char *source;
+    const char *cursor;
+    const char *end;
+    int line;
+    unsigned head;
+    unsigned count;
+    Token ring[LEXER_LOOKAHEAD];
+} Lexer;
+
+void lexer_init(Lexer *lex, const char *source, size_t length);
+void lexer_init_input(Lexer *lex, struct Input *in);
+Token *lexer_peek(Lexer *lex, unsigned ahead);
+
+// Most tokens the parser looks at are already in the ring, those are
+// taken inline and only lexing a new one is a call.
+static inline Token *peek_token(Lexer *lex, unsigned ahead) {
+    if (ahead < lex->count) {
+        return &lex->ring[(lex->head + ahead) & (LEXER_LOOKAHEAD - 1)];
+    }
+    return lexer_peek(lex, ahead);
+}
+
+// Consume the current token (valid until the lexer is advanced again)
+static inline Token *next_token(Lexer *lex) {
+    Token *token = peek_token(lex, 0);
+    if (token->type != TOKEN_EOF) {
+        lex->head = (lex->head + 1) & (LEXER_LOOKAHEAD - 1);
+        lex->count--;
+    }
+    return token;
+}
+
+// Get the lexeme of a token (not terminated, see token->length)
+static inline const char *token_text(const Lexer *lex, const Token *token) {
+    return lex->source + (uint32_t)(token->offset - (uint32_t)lex->base);
+}
 
@@ -0,0 +1,699 @@
+/*
+ * translate.c - Translate one input from JavaScript-like language to BASIC.
+ *
+ * Author: Philip R. Simonson
+ * Date: 10/17/2026
+ *
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "js2bas.h"
+#include "arena.h"
+#include "input.h"
+#include "sink.h"
+#include "symbols.h"
+#include "token.h"
+#include "parse.h"
+#include "pool.h"
+#include "translate.h"
+#include "optimize.h"
+#include "dce.h"
+#include "infer.h"
+#include "stats.h"
+#include "crunch.h"
+
+// Smallest piece of a file handed to a thread in translate_parallel()
+#define PARALLEL_MIN_CHUNK 16384
+
+// FNV-1a parameters for StatementRange.hash
+#define STATEMENT_HASH_SEED 0xcbf29ce484222325ull
+#define STATEMENT_HASH_PRIME 0x100000001b3ull
+
+// Statements with stats of which one is timed (reading a clock can be a
+// system call, which costs more than lexing a token)
+#define STATS_SAMPLE 16
+
+// Spans of the statements timed with stats
+enum {
+    SAMPLE_PARSE,      // parsing, lexing included
+    SAMPLE_COUNT,      // counting for stats, left out of every phase
+    SAMPLE_GENERATE,
+    SAMPLE_RELEX,      // lexing the statement again on its own
+    SAMPLE_RELEXED,    // parsing of the statements lexed again
+    SAMPLE_SPANS
+};
+
+typedef struct {
+    double wall[SAMPLE_SPANS];
+    double cpu[SAMPLE_SPANS];
+} StatsSample;
+
+// Add the time since a mark to a span and move the mark to now
+static void sample_span(StatsSample *sample, int span, double *wall, double *cpu) {
+    double now = stats_wall(), now_cpu = stats_cpu();
+
+    sample->wall[span] += now - *wall;
+    sample->cpu[span] += now_cpu - *cpu;
+    *wall = now;
+    *cpu = now_cpu;
+}
+
+// Share a translation loop's time out to tokenizing, parsing and
+// generating the way its timed statements took theirs
+static void sample_share(double total, const double *span, double *phase) {
+    double parse, timed = span[SAMPLE_PARSE] + span[SAMPLE_COUNT] + span[SAMPLE_GENERATE];
+
+    if (timed <= 0) {
+        phase[JS2BAS_PHASE_PARSE] += total > 0 ? total : 0;
+        return;
+    }
+    total = total > span[SAMPLE_RELEX] ? total - span[SAMPLE_RELEX] : 0;
+    parse = total * span[SAMPLE_PARSE] / timed;
+    phase[JS2BAS_PHASE_GENERATE] += total * span[SAMPLE_GENERATE] / timed;
+    if (span[SAMPLE_RELEXED] > 0) {
+        double lexing = parse * span[SAMPLE_RELEX] / span[SAMPLE_RELEXED];
+        lexing = lexing < parse ? lexing : parse;
+        phase[JS2BAS_PHASE_TOKENIZE] += lexing;
+        parse -= lexing;
+    }
+    phase[JS2BAS_PHASE_PARSE] += parse;
+}
+
+// Lex the text of a timed statement again in one go, so lexing can be
+// timed without reading a clock for every token
+static void relex(const char *text, size_t length) {
+    Lexer lex;
+
+    lexer_init(&lex, text, length);
+    while (next_token(&lex)->type != TOKEN_EOF) {
+    }
+}
+
+// Generate one statement and end its line (--compact ends lines itself)
+static void generate_statement(Sink *out, const Ast *ast, AstIndex node, LineNumbers *lines, Arena *arena) {
+    if (lines->next > 0) {
+        generate_gwbasic_lines(out, ast, node, lines, arena);
+    } else {
+        generate_gwbasic_code(out, ast, node, 0);
+    }
+    if (lines->scratch == NULL && !lines->overflow) {
+        sink_putc(out, '\n');
+    }
+}
+
+// Short name and symbol, for write_aliases()
+typedef struct {
+    uint32_t alias;
+    uint32_t id;
+} AliasEntry;
+
+// Order of short names
+static int by_alias(const void *a, const void *b) {
+    const AliasEntry *x = a, *y = b;
+    return x->alias < y->alias ? -1 : x->alias > y->alias;
+}
+
+// Write the short name of every variable and the name it stands for, one
+// per line, most used first (--compact)
+static int write_aliases(const SymbolTable *symbols, const Js2basSink *names, Arena *arena) {
+    char alias[SYMBOL_ALIAS_MAX];
+    AliasEntry *order;
+    Sink out;
+    int result;
+
+    if (symbols->count == 0) {
+        return TRANSLATE_OK;
+    }
+    if ((order = allocator_alloc(arena->allocator, sizeof(AliasEntry) * symbols->count)) == NULL) {
+        return TRANSLATE_MEMORY;
+    }
+    for (uint32_t id = 0; id < symbols->count; ++id) {
+        order[id] = (AliasEntry){ symbols->symbols[id].alias, id };
+    }
+    qsort(order, symbols->count, sizeof(AliasEntry), by_alias);
+
+    sink_init_callback(&out, names->write, names->user);
+    out.allocator = arena->allocator;
+    for (uint32_t i = 0; i < symbols->count; ++i) {
+        const Symbol *symbol = &symbols->symbols[order[i].id];
+        sink_write(&out, alias, symbol_alias_name(symbol->alias, alias));
+        sink_putc(&out, ' ');
+        sink_write(&out, symbol->name, symbol->length);
+        sink_putc(&out, '\n');
+    }
+    result = sink_flush(&out) < 0 ? (out.error == ENOMEM ? TRANSLATE_MEMORY : TRANSLATE_OUTPUT) : TRANSLATE_OK;
+    sink_free(&out);
+    allocator_free(arena->allocator, order);
+    return result;
+}
+
+// Look at a whole source ahead of translating it: find the variables it
+// reads for -O to remove the others, and infer the type of every variable.
+// Parse errors are left for the translation to report; a source that
+// stops parsing keeps all its variables.
+static int scan_program(Dce *dce, Infer *infer, int optimize, int numbered, const char *source, size_t length,
+        SymbolTable *symbols, Arena *arena) {
+    Lexer lex;
+    Parser parser;
+    Optimizer optimizer;
+    Sink quiet;
+    AstRange live;
+    int complete = 1, result = 0;
+
+    lexer_init(&lex, source, length);
+    lex.symbols = symbols;
+    sink_init_memory(&quiet);
+    quiet.allocator = arena->allocator;
+    parser_init(&parser, &lex, arena, &quiet);
+    optimizer_init(&optimizer, arena);
+    optimizer.numbered = numbered;
+    dce_begin_scan(dce);
+
+    while (peek_token(&lex, 0)->type != TOKEN_EOF) {
+        unsigned line = peek_token(&lex, 0)->line;
+        AstIndex ast = parse_statement(&parser);
+        if (ast == AST_NONE) {
+            complete = 0;
+            result = parser.error != 0 ? -1 : 0;
+            break;
+        }
+        if ((optimize && optimize_statement(&optimizer, &parser.ast) < 0)
+                || infer_statement(infer, &parser.ast, ast, line) < 0
+                || (optimize && dce_statement(dce, &parser.ast, ast, 0, &live) < 0)) {
+            result = -1;
+            break;
+        }
+        arena_reset(arena);
+        sink_reset(&quiet);
+    }
+    arena_reset(arena);
+
+    dce_end_scan(dce, complete && result == 0);
+    if (result == 0 && infer_finish(infer) < 0) {
+        result = -1;
+    }
+    optimizer_free(&optimizer);
+    parser_free(&parser);
+    sink_free(&quiet);
+    return result;
+}
+
+// Translate statement by statement, returns TRANSLATE_OK on success
+static int translate_lexer(Lexer *lex, Input *in, Arena *arena, Sink *out, Sink *diag,
+        const Js2basOptions *options) {
+    Js2basStats *stats = lex->stats;
+    int optimize = options != NULL && options->optimize;
+    int compact = options != NULL && options->compact;
+    int crunching = options != NULL && options->tokenize;
+    Optimizer optimizer;
+    Dce dce;
+    Infer infer;
+    SymbolTable symbols;
+    AstRange live;
+    LineNumbers lines = { .step = 10 };
+    Sink scratch;
+    Sink text;
+    Sink *code = out;
+    Cruncher cruncher;
+    double wall = 0, cpu = 0, mark = 0, mark_cpu = 0, load = 0, load_cpu = 0;
+    StatsSample sample = { { 0 }, { 0 } };
+    double parsed = 0, parsed_cpu = 0;
+    size_t first = 0;
+    int timed = 0;
+    Parser parser;
+    int result = TRANSLATE_OK;
+
+    symbols_init(&symbols, arena->allocator);
+    lex->symbols = &symbols;
+    parser_init(&parser, lex, arena, diag);
+    optimizer_init(&optimizer, arena);
+    if (options != NULL && options->line_start > 0) {
+        lines.next = options->line_start;
+        lines.step = options->line_step > 0 ? options->line_step : 10;
+    }
+    sink_init_memory(&scratch);
+    scratch.allocator = arena->allocator;
+    if (compact) {
+        // Only line-numbered GW-BASIC can be joined with ':', every
+        // statement takes a number so they are as short as they get
+        if (lines.next == 0) {
+            lines.next = lines.step = 1;
+        }
+        lines.scratch = &scratch;
+        if ((lines.targets = allocator_alloc(arena->allocator, GWBASIC_MAX_LINE / 8 + 1)) == NULL) {
+            result = TRANSLATE_MEMORY;
+        } else {
+            memset(lines.targets, 0, GWBASIC_MAX_LINE / 8 + 1);
+        }
+    }
+    cruncher_init(&cruncher, out, arena->allocator);
+    sink_init_callback(&text, crunch_write, &cruncher);
+    text.allocator = arena->allocator;
+    if (crunching) {
+        // The line-numbered text goes through the cruncher on its way out
+        if (lines.next == 0) {
+            lines.next = lines.step = 10;
+        }
+        code = &text;
+    }
+    optimizer.numbered = lines.next > 0;
+    dce_init(&dce, arena->allocator, options != NULL && options->verbose ? diag : NULL);
+    infer_init(&infer, arena->allocator, &symbols, diag);
+    if (result == TRANSLATE_OK && (optimize || lines.next > 0)) {
+        // Looking ahead is parsing too
+        if (STATS_ENABLED(stats)) {
+            mark = stats_wall();
+            mark_cpu = stats_cpu();
+        }
+        if (scan_program(&dce, &infer, optimize, lines.next > 0, lex->source, (size_t)(lex->end - lex->source), &symbols, arena) < 0
+                || (compact && symbols_alias(&symbols) < 0)) {
+            result = TRANSLATE_MEMORY;
+        }
+        if (STATS_ENABLED(stats)) {
+            stats->wall[JS2BAS_PHASE_PARSE] += stats_wall() - mark;
+            stats->cpu[JS2BAS_PHASE_PARSE] += stats_cpu() - mark_cpu;
+        }
+    }
+    if (result == TRANSLATE_MEMORY) {
+        sink_literal(diag, "Error: Out of memory.\n");
+    }
+    if (STATS_ENABLED(stats)) {
+        wall = stats_wall();
+        cpu = stats_cpu();
+        load = stats->wall[JS2BAS_PHASE_LOAD];
+        load_cpu = stats->cpu[JS2BAS_PHASE_LOAD];
+    }
+
+    while (result == TRANSLATE_OK && peek_token(lex, 0)->type != TOKEN_EOF) {
+        unsigned line = peek_token(lex, 0)->line;
+        if (STATS_ENABLED(stats) && (timed = stats->statements % STATS_SAMPLE == 0)) {
+            first = lex->base + (uint32_t)(peek_token(lex, 0)->offset - (uint32_t)lex->base);
+            mark = stats_wall();
+            mark_cpu = stats_cpu();
+        }
+        AstIndex ast = parse_statement(&parser);
+        if (ast == AST_NONE) {
+            sink_literal(diag, "Error in parsing the source code.\n");
+            result = parser.error != 0 ? TRANSLATE_MEMORY : TRANSLATE_PARSE;
+            break;
+        }
+        if (optimize && (optimize_statement(&optimizer, &parser.ast) < 0
+                || dce_statement(&dce, &parser.ast, ast, line, &live) < 0)) {
+            sink_literal(diag, "Error: Out of memory.\n");
+            result = TRANSLATE_MEMORY;
+            break;
+        }
+
+        if (STATS_ENABLED(stats)) {
+            if (timed) {
+                parsed = sample.wall[SAMPLE_PARSE];
+                parsed_cpu = sample.cpu[SAMPLE_PARSE];
+                sample_span(&sample, SAMPLE_PARSE, &mark, &mark_cpu);
+                parsed = sample.wall[SAMPLE_PARSE] - parsed;
+                parsed_cpu = sample.cpu[SAMPLE_PARSE] - parsed_cpu;
+            }
+            stats_count(stats, &parser.ast, ast, arena);
+            stats->statements++;
+            stats->bytes_out -= out->length;
+            if (timed) {
+                sample_span(&sample, SAMPLE_COUNT, &mark, &mark_cpu);
+            }
+        }
+
+        if (optimize) {
+            // What is left of the statement, one line each
+            for (uint32_t i = 0; i < live.count; ++i) {
+                generate_statement(code, &parser.ast, parser.ast.children[live.start + i], &lines, arena);
+            }
+        } else {
+            generate_statement(code, &parser.ast, ast, &lines, arena);
+        }
+        if (lines.overflow) {
+            sink_printf(diag, "Error: Line numbers go past %d at the statement on line %u, use a lower start or step.\n",
+                GWBASIC_MAX_LINE, line);
+            result = TRANSLATE_OUTPUT;
+        }
+        if (crunching && sink_flush(&text) < 0) {
+            break;  // reported with the end of the program
+        }
+        arena_reset(arena);  // Drop the whole statement at once
+        if (in != NULL) {
+            input_release(in);  // Nothing points into old windows now
+        }
+        if (STATS_ENABLED(stats)) {
+            stats->bytes_out += out->length;
+        }
+        if (out->length > out->batch) {
+            sink_flush(out);
+        }
+        if (STATS_ENABLED(stats) && timed) {
+            sample_span(&sample, SAMPLE_GENERATE, &mark, &mark_cpu);
+            // The next statement starts where this one ends, if it is still in the window
+            size_t end = lex->base + (uint32_t)(peek_token(lex, 0)->offset - (uint32_t)lex->base);
+            if (first >= lex->base) {
+                relex(lex->source + (first - lex->base), end - first);
+                sample_span(&sample, SAMPLE_RELEX, &mark, &mark_cpu);
+                sample.wall[SAMPLE_RELEXED] += parsed;
+                sample.cpu[SAMPLE_RELEXED] += parsed_cpu;
+            }
+        }
+    }
+    arena_reset(arena);
+    if (result == TRANSLATE_OK) {
+        dce_finish(&dce);
+        if (lines.next > 0) {
+            generate_gwbasic_end(code, &lines);
+        }
+        if (lines.overflow) {
+            sink_printf(diag, "Error: Line numbers go past %d at the end of the program, use a lower start or step.\n",
+                GWBASIC_MAX_LINE);
+            result = TRANSLATE_OUTPUT;
+            if (lines.column > 0) {
+                sink_putc(code, '\n');
+            }
+        } else if (compact && options->names.write != NULL
+                && (result = write_aliases(&symbols, &options->names, arena)) != TRANSLATE_OK) {
+            sink_literal(diag, "Error: Cannot write the short names.\n");
+        }
+    } else if (lines.column > 0) {
+        sink_putc(code, '\n');  // --compact ends a line when the next one starts
+    }
+    if (crunching && (sink_flush(&text) < 0 || cruncher_finish(&cruncher) < 0) && result == TRANSLATE_OK) {
+        if (cruncher.error == EFBIG) {
+            sink_literal(diag, "Error: The tokenized program does not fit in GW-BASIC's 64 KB.\n");
+            result = TRANSLATE_OUTPUT;
+        } else if (cruncher.error == EINVAL) {
+            sink_literal(diag, "Error: Cannot tokenize a line without a number.\n");
+            result = TRANSLATE_OUTPUT;
+        } else {
+            sink_literal(diag, "Error: Out of memory.\n");
+            result = TRANSLATE_MEMORY;
+        }
+    }
+
+    if (result == TRANSLATE_OK && in != NULL && in->error != 0) {
+        result = in->error == ENOMEM ? TRANSLATE_MEMORY : TRANSLATE_INPUT;
+    }
+    if (STATS_ENABLED(stats)) {
+        // The rest of the loop, less reading windows in, goes by the sample
+        sample_share(stats_wall() - wall - (stats->wall[JS2BAS_PHASE_LOAD] - load), sample.wall, stats->wall);
+        sample_share(stats_cpu() - cpu - (stats->cpu[JS2BAS_PHASE_LOAD] - load_cpu), sample.cpu, stats->cpu);
+        mark = stats_wall();
+        mark_cpu = stats_cpu();
+    }
+    if (sink_flush(out) < 0) {
+        if (out->error == ENOMEM) {
+            sink_literal(diag, "Error: Out of memory.\n");
+            result = TRANSLATE_MEMORY;
+        } else {
+            sink_literal(diag, "Error: Cannot write output.\n");
+            result = TRANSLATE_OUTPUT;
+        }
+    }
+
+    if (STATS_ENABLED(stats)) {
+        stats->wall[JS2BAS_PHASE_GENERATE] += stats_wall() - mark;
+        stats->cpu[JS2BAS_PHASE_GENERATE] += stats_cpu() - mark_cpu;
+    }
+
+    infer_free(&infer);
+    dce_free(&dce);
+    optimizer_free(&optimizer);
+    parser_free(&parser);
+    allocator_free(arena->allocator, lines.targets);
+    sink_free(&scratch);
+    sink_free(&text);
+    cruncher_free(&cruncher);
+    symbols_free(&symbols);
+    lex->symbols = NULL;
+    return result;
+}
+
+// Translate an input, pulling more of it as the parser needs it
+int translate(Input *in, Arena *arena, Sink *out, Sink *diag, const Js2basOptions *options,
+        Js2basStats *stats) {
+    Lexer lex;
+
+    // -O, --lines, --compact and --tokenize look at the whole program before translating any of it
+    if (options != NULL && (options->optimize || options->line_start > 0 || options->compact
+            || options->tokenize)) {
+        double wall = 0, cpu = 0;
+        int failed;
+
+        if (STATS_ENABLED(stats)) {
+            wall = stats_wall();
+            cpu = stats_cpu();
+        }
+        failed = input_read_all(in) < 0;
+        if (STATS_ENABLED(stats)) {
+            stats->wall[JS2BAS_PHASE_LOAD] += stats_wall() - wall;
+            stats->cpu[JS2BAS_PHASE_LOAD] += stats_cpu() - cpu;
+        }
+        if (failed) {
+            return in->error == ENOMEM ? TRANSLATE_MEMORY : TRANSLATE_INPUT;
+        }
+    }
+    lexer_init_input(&lex, in);
+    lex.stats = stats;
+    return translate_lexer(&lex, in, arena, out, diag, options);
+}
+
+// Translate a source buffer
+int translate_buffer(const char *source, size_t length, Arena *arena, Sink *out, Sink *diag,
+        const Js2basOptions *options, Js2basStats *stats) {
+    Lexer lex;
+
+    lexer_init(&lex, source, length);
+    lex.stats = stats;
+    return translate_lexer(&lex, NULL, arena, out, diag, options);
+}
+
+// Find where top-level statements start. A brace balanced scan splits
+// after a ';' or a closing '}' (not followed by 'else' or ';') outside of
+// any block, which is exactly where parse_statement() starts over.
+size_t split_statements(const char *source, size_t length, StatementRange **ranges) {
+    StatementRange *list = NULL;
+    size_t count = 0, capacity = 0;
+    int depth = 0, split = 1;
+    size_t boundary = 0;
+    unsigned line = 1;
+    const unsigned char *text;
+    uint64_t hash;
+    Lexer lex;
+
+    lexer_init(&lex, source, length);
+    for (;;) {
+        Token *token = peek_token(&lex, 0);
+
+        if (split && token->type != TOKEN_EOF) {
+            if (count == capacity) {
+                capacity = capacity ? capacity * 2 : 256;
+                StatementRange *tmp = realloc(list, sizeof(StatementRange) * capacity);
+                if (tmp == NULL) {
+                    free(list);
+                    *ranges = NULL;
+                    return 0;
+                }
+                list = tmp;
+            }
+            list[count].offset = boundary;
+            list[count].line = line;
+            if (count > 0) {
+                list[count - 1].length = boundary - list[count - 1].offset;
+            }
+            list[count].hash = STATEMENT_HASH_SEED;
+            count++;
+        }
+        if (token->type == TOKEN_EOF) {
+            break;
+        }
+
+        // Hash what the parser sees, so layout and line changes do not count
+        hash = list[count - 1].hash;
+        text = (const unsigned char *)token_text(&lex, token);
+        hash = (hash ^ token->type) * STATEMENT_HASH_PRIME;
+        for (uint32_t i = 0; i < token->length; ++i) {
+            hash = (hash ^ text[i]) * STATEMENT_HASH_PRIME;
+        }
+        list[count - 1].hash = (hash ^ 0xff) * STATEMENT_HASH_PRIME;
+
+        split = 0;
+        if (token->type == TOKEN_LBRACE) {
+            depth++;
+        } else if (token->type == TOKEN_RBRACE) {
+            depth--;
+            if (depth == 0) {
+                TokenType next = peek_token(&lex, 1)->type;
+                split = next != TOKEN_ELSE && next != TOKEN_SEMICOLON;
+            }
+        } else if (token->type == TOKEN_SEMICOLON) {
+            split = depth == 0;
+        }
+        // Cut after the terminator, since a token's text may not start
+        // where its source does (comments drop their leading slashes)
+        if (split) {
+            boundary = token->offset + token->length;
+            line = token->line;
+        }
+        next_token(&lex);
+    }
+
+    if (count > 0) {
+        list[count - 1].length = length - list[count - 1].offset;
+    }
+    *ranges = list;
+    return count;
+}
+
+// Parallel Job Structure (one piece of the file per task)
+typedef struct {
+    const char *source;
+    StatementRange *pieces;
+    Sink *outs;
+    Sink *diags;
+    int *results;
+} ParallelJob;
+
+// Translate the statements of one range of a source buffer, returns 0 on success
+int translate_range(const char *source, const StatementRange *range, Sink *out, Sink *diag) {
+    Lexer lex;
+    Arena arena;
+    Parser parser;
+    SymbolTable symbols;
+    int result = 0;
+
+    lexer_init(&lex, source + range->offset, range->length);
+    lex.line = range->line;
+    arena_init(&arena);
+    symbols_init(&symbols, arena.allocator);
+    lex.symbols = &symbols;
+    parser_init(&parser, &lex, &arena, diag);
+
+    while (peek_token(&lex, 0)->type != TOKEN_EOF) {
+        AstIndex ast = parse_statement(&parser);
+        if (ast == AST_NONE) {
+            result = 1;
+            break;
+        }
+        generate_gwbasic_code(out, &parser.ast, ast, 0);
+        arena_reset(&arena);
+        sink_putc(out, '\n');
+    }
+
+    parser_free(&parser);
+    symbols_free(&symbols);
+    arena_free(&arena);
+    return result;
+}
+
+// Translate one piece of the file into its own buffer
+static void translate_piece(void *context, size_t index) {
+    ParallelJob *job = context;
+
+    job->results[index] = translate_range(job->source, &job->pieces[index],
+        &job->outs[index], &job->diags[index]);
+}
+
+// Translate sequentially with an arena of its own
+static int translate_fallback(Input *in, Sink *out, Sink *diag) {
+    Arena arena;
+    int result;
+
+    arena_init(&arena);
+    result = translate(in, &arena, out, diag, NULL, NULL);
+    arena_free(&arena);
+    return result;
+}
+
+// Translate the top-level statements of one input on several threads.
+// The output is identical to translate(), which is also what reports
+// errors: a file that fails to parse is translated again sequentially.
+int translate_parallel(Input *in, Sink *out, Sink *diag, int threads) {
+    StatementRange *ranges = NULL, *pieces = NULL;
+    size_t count, npieces = 0, target;
+    ParallelJob job = {0};
+    int failed = 0;
+
+    if (input_read_all(in) < 0) {
+        return in->error == ENOMEM ? TRANSLATE_MEMORY : TRANSLATE_INPUT;
+    }
+    count = split_statements(in->buffer, in->length, &ranges);
+    if (threads <= 1 || count <= 1) {
+        free(ranges);
+        return translate_fallback(in, out, diag);
+    }
+
+    // Group statements into pieces of roughly equal size, a few per thread
+    target = in->length / ((size_t)threads * 4);
+    if (target < PARALLEL_MIN_CHUNK) {
+        target = PARALLEL_MIN_CHUNK;
+    }
+    if ((pieces = malloc(sizeof(StatementRange) * count)) == NULL) {
+        free(ranges);
+        return translate_fallback(in, out, diag);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (npieces > 0 && pieces[npieces - 1].length < target) {
+            pieces[npieces - 1].length += ranges[i].length;
+        } else {
+            pieces[npieces++] = ranges[i];
+        }
+    }
+    free(ranges);
+
+    job.source = in->buffer;
+    job.pieces = pieces;
+    job.outs = calloc(npieces, sizeof(Sink));
+    job.diags = calloc(npieces, sizeof(Sink));
+    job.results = calloc(npieces, sizeof(int));
+    if (job.outs == NULL || job.diags == NULL || job.results == NULL) {
+        failed = 1;
+    } else {
+        for (size_t i = 0; i < npieces; ++i) {
+            sink_init_memory(&job.outs[i]);
+            sink_init_memory(&job.diags[i]);
+        }
+        if (pool_run(threads, npieces, translate_piece, &job) < 0) {
+            failed = 1;
+        }
+    }
+
+    for (size_t i = 0; i < npieces && !failed; ++i) {
+        if (job.results[i] != 0 || job.outs[i].error != 0) {
+            failed = 1;
+        }
+    }
+
+    // Concatenate in source order
+    for (size_t i = 0; i < npieces && job.outs != NULL; ++i) {
+        if (!failed) {
+            sink_append(out, &job.outs[i]);
+            if (out->length > out->batch) {
+                sink_flush(out);
+            }
+        }
+        sink_free(&job.outs[i]);
+        if (job.diags != NULL) {
+            sink_free(&job.diags[i]);
+        }
+    }
+    free(job.outs);
+    free(job.diags);
+    free(job.results);
+    free(pieces);
+
+    if (failed) {
+        return translate_fallback(in, out, diag);
+    }
+    if (sink_flush(out) < 0) {
+        sink_literal(diag, "Error: Cannot write output.\n");
+        return TRANSLATE_OUTPUT;
+    }
+    return TRANSLATE_OK;
+}
+
@@ -0,0 +1,34 @@
+/*
+ * translate.h - Translate one input from JavaScript-like language to BASIC.
+ *
+ * Author: Philip R. Simonson
+ * Date: 10/17/2026
+ *
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Statement Range Structure (top-level statements the parser can start at)
+typedef struct {
+    size_t offset;      // first byte of the first token
+    size_t length;      // up to the next range
+    unsigned line;      // line of the first token
+    uint64_t hash;      // hash of the token types and lexemes
+} StatementRange;
+
+// Results of translate() and friends (same values as JS2BAS_OK and errors)
+#define TRANSLATE_OK 0
+#define TRANSLATE_PARSE 1
+#define TRANSLATE_MEMORY 2
+#define TRANSLATE_OUTPUT 3
+#define TRANSLATE_INPUT 4
+
+int translate(struct Input *in, struct Arena *arena, struct Sink *out, struct Sink *diag,
+    const struct Js2basOptions *options, struct Js2basStats *stats);
+int translate_buffer(const char *source, size_t length, struct Arena *arena, struct Sink *out, struct Sink *diag,
+    const struct Js2basOptions *options, struct Js2basStats *stats);
+int translate_parallel(struct Input *in, struct Sink *out, struct Sink *diag, int threads);
+size_t split_statements(const char *source, size_t length, StatementRange **ranges);
+int translate_range(const char *source, const StatementRange *range, struct Sink *out, struct Sink *diag);
+
@@ -0,0 +1,1579 @@
+/*
+ * vm.c - Bytecode compiler and virtual machine for the BASIC js2bas writes.
+ *
+ * Author: Philip R. Simonson
+ * Date: 10/17/2026
+ *
+ * --run compiles the translated program and runs it in the process, so
+ * its output can be checked without QB64. The compiler takes the subset
+ * the generators write, in both forms: block IF/ELSE/END IF and
+ * WHILE/WEND, and numbered lines with IF ... THEN GOTO, GOTO and
+ * statements joined by ':'. Every variable gets its slot and every
+ * expression its type while compiling, so the machine only moves numbers
+ * and strings between slots and two stacks sized beforehand, and checks
+ * INTEGER and LONG results for Overflow the way QBasic does. INPUT takes
+ * the lines of a script and echoes them as a terminal would. Instructions
+ * are dispatched through a table of label addresses where the compiler
+ * has them (GCC and Clang), a switch elsewhere, and counted one by one.
+ *
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <float.h>
+#include "js2bas.h"
+#include "arena.h"
+#include "sink.h"
+#include "symbols.h"
+#include "vm.h"
+
+#if defined(__GNUC__)
+#define VM_COMPUTED_GOTO
+#endif
+
+// Tokens of a line
+#define TOKEN_END 0         // of the line
+#define TOKEN_NUMBER 1
+#define TOKEN_STRING 2
+#define TOKEN_NAME 3
+#define TOKEN_KEYWORD 4
+#define TOKEN_SYMBOL 5      // an operator or punctuation
+
+// Keywords
+enum {
+    KEY_PRINT, KEY_INPUT, KEY_DIM, KEY_AS, KEY_IF, KEY_THEN, KEY_ELSE, KEY_END,
+    KEY_WHILE, KEY_WEND, KEY_GOTO, KEY_REM, KEY_LET, KEY_AND, KEY_OR, KEY_NOT,
+    KEY_MOD, KEY_INTEGER, KEY_LONG, KEY_SINGLE, KEY_DOUBLE, KEY_STRING, KEYWORDS
+};
+
+static const char *keywords[KEYWORDS] = {
+    "PRINT", "INPUT", "DIM", "AS", "IF", "THEN", "ELSE", "END",
+    "WHILE", "WEND", "GOTO", "REM", "LET", "AND", "OR", "NOT",
+    "MOD", "INTEGER", "LONG", "SINGLE", "DOUBLE", "STRING"
+};
+
+static const char *op_names[VM_OPS] = {
+    "NUMBER", "STRING", "LOAD", "STORE", "LOAD_STRING", "STORE_STRING",
+    "ADD", "SUBTRACT", "MULTIPLY", "DIVIDE", "INTEGER_DIVIDE", "MODULO",
+    "NEGATE", "CINT", "CLNG", "CSNG", "EQUAL", "NOT_EQUAL", "LESS", "GREATER",
+    "LESS_EQUAL", "GREATER_EQUAL", "COMPARE_STRING", "AND", "OR", "NOT",
+    "CONCAT", "JUMP", "JUMP_FALSE", "JUMP_TRUE", "PRINT_NUMBER", "PRINT_STRING",
+    "PRINT_ZONE", "PRINT_NEWLINE", "INPUT", "END"
+};
+
+// Compiler Structure (the line being compiled and its current token)
+typedef struct {
+    Vm *vm;
+    const char *cursor;
+    const char *end;        // of the line
+    unsigned line;
+    uint32_t skip;          // jump to the next line to patch, 0 for none
+    int type;               // TOKEN_*
+    const char *text;
+    size_t length;
+    int keyword;            // KEY_* of a TOKEN_KEYWORD
+    char op;                // of a TOKEN_SYMBOL: the character, or 'l' for
+                            // <=, 'g' for >=, 'n' for <>
+    double value;           // of a TOKEN_NUMBER
+    ValueKind kind;         // of a TOKEN_NUMBER or TOKEN_NAME suffix
+    size_t numbers_now;     // on the stacks in the expression so far
+    size_t strings_now;
+} Compiler;
+
+// Initialize a machine without a program
+void vm_init(Vm *vm, const struct Js2basAllocator *allocator, Sink *diag) {
+    memset(vm, 0, sizeof(Vm));
+    vm->allocator = allocator;
+    vm->diag = diag;
+    symbols_init(&vm->names, allocator);
+}
+
+// Free the buffers of strings
+static void free_strings(Vm *vm, VmString *strings, size_t count) {
+    for (size_t i = 0; strings != NULL && i < count; ++i) {
+        allocator_free(vm->allocator, strings[i].data);
+    }
+    allocator_free(vm->allocator, strings);
+}
+
+// Free the program and what its last run left
+void vm_free(Vm *vm) {
+    allocator_free(vm->allocator, vm->code);
+    allocator_free(vm->allocator, vm->numbers);
+    free_strings(vm, vm->strings, vm->strings_count);
+    allocator_free(vm->allocator, vm->lines);
+    allocator_free(vm->allocator, vm->labels);
+    allocator_free(vm->allocator, vm->jumps);
+    allocator_free(vm->allocator, vm->blocks);
+    symbols_free(&vm->names);
+    allocator_free(vm->allocator, vm->slots);
+    allocator_free(vm->allocator, vm->name);
+    allocator_free(vm->allocator, vm->operators);
+    allocator_free(vm->allocator, vm->types);
+    allocator_free(vm->allocator, vm->variables);
+    free_strings(vm, vm->string_variables, vm->string_slots);
+    allocator_free(vm->allocator, vm->stack);
+    free_strings(vm, vm->string_stack, vm->string_depth);
+    memset(vm, 0, sizeof(Vm));
+}
+
+// Make room for needed elements of size bytes, -1 when out of memory
+static int grow(Vm *vm, void *array, size_t *capacity, size_t needed, size_t size) {
+    size_t count = *capacity ? *capacity : 64;
+    void *tmp;
+
+    if (needed <= *capacity) {
+        return 0;
+    }
+    while (count < needed) {
+        count *= 2;
+    }
+    if ((tmp = allocator_resize(vm->allocator, *(void **)array, count * size)) == NULL) {
+        vm->error = ENOMEM;
+        return -1;
+    }
+    *(void **)array = tmp;
+    *capacity = count;
+    return 0;
+}
+
+// Set a string to a copy of data, -1 when out of memory
+static int string_set(Vm *vm, VmString *string, const char *data, size_t length) {
+    if (length > string->capacity) {
+        size_t capacity = string->capacity ? string->capacity : 16;
+        char *tmp;
+        while (capacity < length) {
+            capacity *= 2;
+        }
+        if ((tmp = allocator_resize(vm->allocator, string->data, capacity)) == NULL) {
+            vm->error = ENOMEM;
+            return -1;
+        }
+        string->data = tmp;
+        string->capacity = capacity;
+    }
+    if (length > 0) {
+        memmove(string->data, data, length);
+    }
+    string->length = length;
+    return 0;
+}
+
+// Append data to a string, -1 when out of memory
+static int string_append(Vm *vm, VmString *string, const char *data, size_t length) {
+    size_t start = string->length;
+
+    if (start + length > string->capacity) {
+        size_t capacity = string->capacity ? string->capacity * 2 : 16;
+        char *tmp;
+        while (capacity < start + length) {
+            capacity *= 2;
+        }
+        if ((tmp = allocator_resize(vm->allocator, string->data, capacity)) == NULL) {
+            vm->error = ENOMEM;
+            return -1;
+        }
+        string->data = tmp;
+        string->capacity = capacity;
+    }
+    if (length > 0) {
+        memcpy(string->data + start, data, length);
+    }
+    string->length = start + length;
+    return 0;
+}
+
+// Report an error of the line being compiled, returns -1
+static int compile_error(Compiler *c, const char *message) {
+    sink_printf(c->vm->diag, "Error in line %u of the BASIC program: %s.\n", c->line, message);
+    return -1;
+}
+
+// Type of a name suffix, KIND_UNKNOWN for none
+static ValueKind suffix_kind(char suffix) {
+    switch (suffix) {
+        case '%': return KIND_INTEGER;
+        case '&': return KIND_LONG;
+        case '!': return KIND_SINGLE;
+        case '#': return KIND_DOUBLE;
+        case '$': return KIND_STRING;
+        default: return KIND_UNKNOWN;
+    }
+}
+
+// Read a numeric constant and its type as QBasic gives it: a suffix, or
+// INTEGER or LONG for whole numbers that fit, DOUBLE for more than seven
+// digits or a D exponent, SINGLE for the rest; returns its length
+static size_t scan_number(const char *text, const char *end, double *value, ValueKind *kind) {
+    char digits[64];
+    size_t n = 0, significant = 0;
+    const char *p = text;
+    int point = 0, exponent = 0;
+
+    while (p < end && (isdigit((unsigned char)*p) || (*p == '.' && !point))) {
+        if (*p == '.') {
+            point = 1;
+        } else if (significant > 0 || *p != '0') {
+            significant++;
+        }
+        if (n + 1 < sizeof(digits)) {
+            digits[n++] = *p;
+        }
+        p++;
+    }
+    if (p < end && (toupper((unsigned char)*p) == 'E' || toupper((unsigned char)*p) == 'D')) {
+        const char *q = p + 1;
+        if (q < end && (*q == '+' || *q == '-')) {
+            q++;
+        }
+        if (q < end && isdigit((unsigned char)*q)) {
+            exponent = toupper((unsigned char)*p);
+            if (n + 1 < sizeof(digits)) {
+                digits[n++] = 'E';
+            }
+            for (p++; p < q || (p < end && isdigit((unsigned char)*p)); ++p) {
+                if (n + 1 < sizeof(digits)) {
+                    digits[n++] = *p;
+                }
+            }
+        }
+    }
+    digits[n] = '\0';
+    *value = strtod(digits, NULL);
+
+    *kind = p < end ? suffix_kind(*p) : KIND_UNKNOWN;
+    if (*kind != KIND_UNKNOWN && *kind != KIND_STRING) {
+        p++;
+    } else if (exponent == 'D' || significant > 7) {
+        *kind = KIND_DOUBLE;
+    } else if (point || exponent) {
+        *kind = KIND_SINGLE;
+    } else if (*value <= 32767) {
+        *kind = KIND_INTEGER;
+    } else if (*value <= 2147483647) {
+        *kind = KIND_LONG;
+    } else {
+        *kind = KIND_SINGLE;
+    }
+    if (*kind == KIND_SINGLE) {
+        *value = (float)*value;
+    }
+    return (size_t)(p - text);
+}
+
+// Move on to the next token of the line
+static void next_token(Compiler *c) {
+    const char *p = c->cursor;
+
+    while (p < c->end && (*p == ' ' || *p == '\t')) {
+        p++;
+    }
+    c->text = p;
+    c->length = 0;
+    if (p >= c->end) {
+        c->type = TOKEN_END;
+        c->cursor = p;
+        return;
+    }
+
+    if (isdigit((unsigned char)*p) || (*p == '.' && p + 1 < c->end && isdigit((unsigned char)p[1]))) {
+        c->type = TOKEN_NUMBER;
+        c->length = scan_number(p, c->end, &c->value, &c->kind);
+    } else if (*p == '"') {
+        // A string runs to its closing quote, or to the end of the line
+        const char *quote = memchr(p + 1, '"', (size_t)(c->end - p - 1));
+        c->type = TOKEN_STRING;
+        c->text = p + 1;
+        c->length = (size_t)((quote != NULL ? quote : c->end) - c->text);
+        c->cursor = quote != NULL ? quote + 1 : c->end;
+        return;
+    } else if (isalpha((unsigned char)*p)) {
+        const char *q = p;
+        while (q < c->end && (isalnum((unsigned char)*q) || *q == '.' || *q == '_')) {
+            q++;
+        }
+        c->type = TOKEN_NAME;
+        c->kind = q < c->end ? suffix_kind(*q) : KIND_UNKNOWN;
+        c->length = (size_t)(q - p) + (c->kind != KIND_UNKNOWN);
+        for (int k = 0; k < KEYWORDS && c->kind == KIND_UNKNOWN; ++k) {
+            if (strlen(keywords[k]) == c->length && strncasecmp(keywords[k], p, c->length) == 0) {
+                c->type = TOKEN_KEYWORD;
+                c->keyword = k;
+                break;
+            }
+        }
+    } else if (*p == '?' || *p == '\'') {
+        c->type = TOKEN_KEYWORD;
+        c->keyword = *p == '?' ? KEY_PRINT : KEY_REM;
+        c->length = 1;
+    } else {
+        c->type = TOKEN_SYMBOL;
+        c->op = *p;
+        c->length = 1;
+        if (p + 1 < c->end && *p == '<' && (p[1] == '=' || p[1] == '>')) {
+            c->op = p[1] == '=' ? 'l' : 'n';
+            c->length = 2;
+        } else if (p + 1 < c->end && *p == '>' && p[1] == '=') {
+            c->op = 'g';
+            c->length = 2;
+        }
+    }
+    c->cursor = p + c->length;
+}
+
+// Whether the token is a symbol
+static int is_symbol(const Compiler *c, char op) {
+    return c->type == TOKEN_SYMBOL && c->op == op;
+}
+
+// Whether the token is a keyword
+static int is_keyword(const Compiler *c, int keyword) {
+    return c->type == TOKEN_KEYWORD && c->keyword == keyword;
+}
+
+// Append bytes to the code
+static void emit(Vm *vm, const void *data, size_t length) {
+    if (grow(vm, &vm->code, &vm->code_capacity, vm->code_length + length, 1) == 0) {
+        memcpy(vm->code + vm->code_length, data, length);
+        vm->code_length += length;
+    }
+}
+
+// Append an instruction
+static void emit_op(Vm *vm, VmOp op) {
+    unsigned char byte = (unsigned char)op;
+    emit(vm, &byte, 1);
+}
+
+// Append a byte operand
+static void emit_u8(Vm *vm, unsigned value) {
+    unsigned char byte = (unsigned char)value;
+    emit(vm, &byte, 1);
+}
+
+// Append a 32-bit operand, returns its offset
+static uint32_t emit_u32(Vm *vm, uint32_t value) {
+    uint32_t offset = (uint32_t)vm->code_length;
+    emit(vm, &value, sizeof(value));
+    return offset;
+}
+
+// Set a 32-bit operand written before
+static void patch(Vm *vm, uint32_t offset, uint32_t value) {
+    if (vm->error == 0) {
+        memcpy(vm->code + offset, &value, sizeof(value));
+    }
+}
+
+// Read a 32-bit operand
+static uint32_t read_u32(const unsigned char *code) {
+    uint32_t value;
+    memcpy(&value, code, sizeof(value));
+    return value;
+}
+
+// Append a jump to a line number, patched once all lines are known
+static void emit_goto(Compiler *c, VmOp op, unsigned number) {
+    Vm *vm = c->vm;
+
+    emit_op(vm, op);
+    if (grow(vm, &vm->jumps, &vm->jumps_capacity, vm->jumps_count + 1, sizeof(VmLabel)) == 0) {
+        vm->jumps[vm->jumps_count++] = (VmLabel){ number, (uint32_t)vm->code_length, c->line };
+    }
+    emit_u32(vm, 0);
+}
+
+// Push a value of a type while compiling an expression
+static void push_type(Compiler *c, ValueKind kind) {
+    Vm *vm = c->vm;
+    size_t count = c->numbers_now + c->strings_now;
+
+    if (grow(vm, &vm->types, &vm->types_capacity, count + 1, 1) < 0) {
+        return;
+    }
+    vm->types[count] = (unsigned char)kind;
+    if (kind == KIND_STRING) {
+        if (++c->strings_now > vm->string_depth) {
+            vm->string_depth = c->strings_now;
+        }
+    } else if (++c->numbers_now > vm->number_depth) {
+        vm->number_depth = c->numbers_now;
+    }
+}
+
+// Pop the type of a value while compiling an expression
+static ValueKind pop_type(Compiler *c) {
+    ValueKind kind = (ValueKind)c->vm->types[c->numbers_now + c->strings_now - 1];
+
+    if (kind == KIND_STRING) {
+        c->strings_now--;
+    } else {
+        c->numbers_now--;
+    }
+    return kind;
+}
+
+// Index of a new number constant
+static uint32_t add_number(Compiler *c, double value) {
+    Vm *vm = c->vm;
+
+    if (grow(vm, &vm->numbers, &vm->numbers_capacity, vm->numbers_count + 1, sizeof(double)) < 0) {
+        return 0;
+    }
+    vm->numbers[vm->numbers_count] = value;
+    return (uint32_t)vm->numbers_count++;
+}
+
+// Index of a new string constant, text followed by more
+static uint32_t add_string(Compiler *c, const char *text, size_t length, const char *more, size_t more_length) {
+    Vm *vm = c->vm;
+    VmString *string;
+
+    if (grow(vm, &vm->strings, &vm->strings_capacity, vm->strings_count + 1, sizeof(VmString)) < 0) {
+        return 0;
+    }
+    string = &vm->strings[vm->strings_count];
+    memset(string, 0, sizeof(VmString));
+    if (string_set(vm, string, text, length) < 0 || string_append(vm, string, more, more_length) < 0) {
+        allocator_free(vm->allocator, string->data);
+        return 0;
+    }
+    return (uint32_t)vm->strings_count++;
+}
+
+// Id of a name (in capitals, without its suffix) and its slots
+static int find_name(Compiler *c, const char *text, size_t length, uint32_t *id) {
+    Vm *vm = c->vm;
+
+    if (grow(vm, &vm->name, &vm->name_capacity, length, 1) < 0) {
+        return -1;
+    }
+    for (size_t i = 0; i < length; ++i) {
+        vm->name[i] = (char)toupper((unsigned char)text[i]);
+    }
+    if ((*id = symbol_intern(&vm->names, vm->name, length)) == SYMBOL_NONE) {
+        vm->error = ENOMEM;
+        return -1;
+    }
+    if (*id >= vm->slots_capacity) {
+        size_t old = vm->slots_capacity;
+        if (grow(vm, &vm->slots, &vm->slots_capacity, *id + 1, sizeof(VmName)) < 0) {
+            return -1;
+        }
+        memset(vm->slots + old, 0xff, sizeof(VmName) * (vm->slots_capacity - old));
+    }
+    return 0;
+}
+
+// Slot of the variable named by the token, given one the first time; a
+// name without a suffix has the type it was DIMmed with, or SINGLE
+static int variable(Compiler *c, uint32_t *slot, ValueKind *kind) {
+    Vm *vm = c->vm;
+    ValueKind suffix = c->kind;
+    Symbol *symbol;
+    uint32_t id, *slots;
+
+    if (find_name(c, c->text, c->length - (suffix != KIND_UNKNOWN), &id) < 0) {
+        return -1;
+    }
+    symbol = &vm->names.symbols[id];
+    if (suffix == KIND_UNKNOWN) {
+        *kind = symbol->kind != KIND_UNKNOWN ? symbol->kind : KIND_SINGLE;
+    } else if (symbol->kind != KIND_UNKNOWN && symbol->kind != suffix) {
+        return compile_error(c, "Duplicate definition");
+    } else {
+        *kind = suffix;
+    }
+    slots = vm->slots[id].slots;
+    if (slots[*kind] == UINT32_MAX) {
+        slots[*kind] = *kind == KIND_STRING ? vm->string_slots++ : vm->number_slots++;
+    }
+    *slot = slots[*kind];
+    return 0;
+}
+
+// Binding strength of an operator ('_' is unary minus, '~' NOT, 'M' MOD,
+// 'A' AND, 'O' OR), higher binds tighter
+static int precedence(char op) {
+    switch (op) {
+        case 'O': return 1;
+        case 'A': return 2;
+        case '~': return 3;
+        case '+': case '-': return 5;
+        case 'M': return 6;
+        case '\\': return 7;
+        case '*': case '/': return 8;
+        case '_': return 9;
+        default: return 4;  // comparisons
+    }
+}
+
+// Binary operator of the token, 0 if it is none
+static char binary_operator(const Compiler *c) {
+    if (c->type == TOKEN_SYMBOL && strchr("+-*/\\=<>lgn", c->op) != NULL && c->op != '\0') {
+        return c->op;
+    }
+    if (is_keyword(c, KEY_AND)) return 'A';
+    if (is_keyword(c, KEY_OR)) return 'O';
+    if (is_keyword(c, KEY_MOD)) return 'M';
+    return 0;
+}
+
+// Round an arithmetic result to its type
+static void emit_fit(Vm *vm, ValueKind kind) {
+    if (kind == KIND_INTEGER) {
+        emit_op(vm, VM_CINT);
+    } else if (kind == KIND_LONG) {
+        emit_op(vm, VM_CLNG);
+    } else if (kind == KIND_SINGLE) {
+        emit_op(vm, VM_CSNG);
+    }
+}
+
+// Compile the operator on top of the stack, -1 on a type mismatch
+static int reduce(Compiler *c, char op) {
+    static const struct { char op; VmOp instruction; } comparisons[] = {
+        { '=', VM_EQUAL }, { 'n', VM_NOT_EQUAL }, { '<', VM_LESS },
+        { '>', VM_GREATER }, { 'l', VM_LESS_EQUAL }, { 'g', VM_GREATER_EQUAL }
+    };
+    Vm *vm = c->vm;
+    ValueKind left, right, result;
+
+    if (op == '_' || op == '~') {
+        if ((right = pop_type(c)) == KIND_STRING) {
+            return compile_error(c, "Type mismatch");
+        }
+        if (op == '_') {
+            emit_op(vm, VM_NEGATE);
+            result = right;
+            if (right != KIND_SINGLE) {
+                emit_fit(vm, right);  // -(-32768) does not fit
+            }
+        } else {
+            emit_op(vm, VM_NOT);
+            result = right == KIND_INTEGER ? KIND_INTEGER : KIND_LONG;
+        }
+        push_type(c, result);
+        return 0;
+    }
+
+    right = pop_type(c);
+    left = pop_type(c);
+    if (precedence(op) == 4) {
+        size_t k;
+        for (k = 0; comparisons[k].op != op; ++k) {
+        }
+        if ((left == KIND_STRING) != (right == KIND_STRING)) {
+            return compile_error(c, "Type mismatch");
+        }
+        if (left == KIND_STRING) {
+            emit_op(vm, VM_COMPARE_STRING);
+            emit_u8(vm, comparisons[k].instruction);
+        } else {
+            emit_op(vm, comparisons[k].instruction);
+        }
+        push_type(c, KIND_INTEGER);
+        return 0;
+    }
+    if (op == '+' && left == KIND_STRING && right == KIND_STRING) {
+        emit_op(vm, VM_CONCAT);
+        push_type(c, KIND_STRING);
+        return 0;
+    }
+    if (left == KIND_STRING || right == KIND_STRING) {
+        return compile_error(c, "Type mismatch");
+    }
+
+    // Arithmetic is done in the wider type of its operands, '/' at least
+    // in SINGLE, '\', MOD, AND and OR in INTEGER or LONG
+    result = left > right ? left : right;
+    switch (op) {
+        case '+': emit_op(vm, VM_ADD); break;
+        case '-': emit_op(vm, VM_SUBTRACT); break;
+        case '*': emit_op(vm, VM_MULTIPLY); break;
+        case '/':
+            emit_op(vm, VM_DIVIDE);
+            result = result == KIND_DOUBLE ? KIND_DOUBLE : KIND_SINGLE;
+            break;
+        default:
+            emit_op(vm, op == '\\' ? VM_INTEGER_DIVIDE : op == 'M' ? VM_MODULO : op == 'A' ? VM_AND : VM_OR);
+            result = result == KIND_INTEGER ? KIND_INTEGER : KIND_LONG;
+            break;
+    }
+    if (op != 'A' && op != 'O') {
+        emit_fit(vm, result);
+    }
+    push_type(c, result);
+    return 0;
+}
+
+// Compile an expression, operators on an explicit stack; its type goes
+// to kind
+static int compile_expression(Compiler *c, ValueKind *kind) {
+    Vm *vm = c->vm;
+    size_t top = 0, parens = 0;
+    int operand = 1;
+
+    c->numbers_now = c->strings_now = 0;
+    for (;;) {
+        uint32_t slot;
+        char op;
+
+        if (operand) {
+            op = is_symbol(c, '(') ? 0 : is_symbol(c, '-') ? '_' : is_keyword(c, KEY_NOT) ? '~' : 1;
+            if (op != 1) {
+                // Prefix operators and '(' wait for their operand
+                if (grow(vm, &vm->operators, &vm->operators_capacity, top + 1, 1) < 0) {
+                    return -1;
+                }
+                vm->operators[top++] = op;
+                parens += op == 0;
+            } else if (c->type == TOKEN_NUMBER) {
+                emit_op(vm, VM_NUMBER);
+                emit_u32(vm, add_number(c, c->value));
+                push_type(c, c->kind);
+                operand = 0;
+            } else if (c->type == TOKEN_STRING) {
+                emit_op(vm, VM_STRING);
+                emit_u32(vm, add_string(c, c->text, c->length, "", 0));
+                push_type(c, KIND_STRING);
+                operand = 0;
+            } else if (c->type == TOKEN_NAME) {
+                if (variable(c, &slot, kind) < 0) {
+                    return -1;
+                }
+                emit_op(vm, *kind == KIND_STRING ? VM_LOAD_STRING : VM_LOAD);
+                emit_u32(vm, slot);
+                push_type(c, *kind);
+                operand = 0;
+            } else if (!is_symbol(c, '+')) {
+                return compile_error(c, "Expected an expression");
+            }
+            next_token(c);
+            continue;
+        }
+
+        if ((op = binary_operator(c)) != 0) {
+            while (top > 0 && vm->operators[top - 1] != 0 && precedence(vm->operators[top - 1]) >= precedence(op)) {
+                if (reduce(c, vm->operators[--top]) < 0) {
+                    return -1;
+                }
+            }
+            if (grow(vm, &vm->operators, &vm->operators_capacity, top + 1, 1) < 0) {
+                return -1;
+            }
+            vm->operators[top++] = op;
+            operand = 1;
+            next_token(c);
+        } else if (is_symbol(c, ')') && parens > 0) {
+            while (vm->operators[top - 1] != 0) {
+                if (reduce(c, vm->operators[--top]) < 0) {
+                    return -1;
+                }
+            }
+            top--;
+            parens--;
+            next_token(c);
+        } else {
+            break;
+        }
+    }
+    if (parens > 0) {
+        return compile_error(c, "Expected ')'");
+    }
+    while (top > 0) {
+        if (reduce(c, vm->operators[--top]) < 0) {
+            return -1;
+        }
+    }
+    if (vm->error != 0) {
+        return -1;
+    }
+    *kind = pop_type(c);
+    return 0;
+}
+
+// Compile an expression of a number, for IF and WHILE
+static int compile_condition(Compiler *c) {
+    ValueKind kind;
+
+    if (compile_expression(c, &kind) < 0) {
+        return -1;
+    }
+    return kind == KIND_STRING ? compile_error(c, "Type mismatch") : 0;
+}
+
+// Convert the value on the stack for a variable of another type
+static int compile_convert(Compiler *c, ValueKind from, ValueKind to) {
+    if ((from == KIND_STRING) != (to == KIND_STRING)) {
+        return compile_error(c, "Type mismatch");
+    }
+    if (to < from || (to == KIND_SINGLE && from == KIND_LONG)) {
+        emit_fit(c->vm, to);
+    }
+    return 0;
+}
+
+// Line number of the token, -1 if it is none
+static long line_number(Compiler *c) {
+    if (c->type != TOKEN_NUMBER || c->value != (double)(long)c->value || c->value < 0 || c->value > 65529) {
+        compile_error(c, "Expected a line number");
+        return -1;
+    }
+    return (long)c->value;
+}
+
+// Compile PRINT: items separated by ';' or ',' (the next zone), a new
+// line unless one of them ends it
+static int compile_print(Compiler *c) {
+    Vm *vm = c->vm;
+    int newline = 1;
+
+    next_token(c);
+    while (c->type != TOKEN_END && !is_symbol(c, ':') && !is_keyword(c, KEY_ELSE)) {
+        ValueKind kind;
+
+        if (is_symbol(c, ';') || is_symbol(c, ',')) {
+            if (c->op == ',') {
+                emit_op(vm, VM_PRINT_ZONE);
+            }
+            newline = 0;
+            next_token(c);
+            continue;
+        }
+        if (compile_expression(c, &kind) < 0) {
+            return -1;
+        }
+        if (kind == KIND_STRING) {
+            emit_op(vm, VM_PRINT_STRING);
+        } else {
+            emit_op(vm, VM_PRINT_NUMBER);
+            emit_u8(vm, kind);
+        }
+        newline = 1;
+    }
+    if (newline) {
+        emit_op(vm, VM_PRINT_NEWLINE);
+    }
+    return 0;
+}
+
+// Compile INPUT ["prompt" ; | ,] variable ('?' after the prompt for ';')
+static int compile_input(Compiler *c) {
+    const char *prompt = "";
+    size_t length = 0;
+    int question = 1;
+    ValueKind kind;
+    uint32_t slot;
+
+    next_token(c);
+    if (c->type == TOKEN_STRING) {
+        prompt = c->text;
+        length = c->length;
+        next_token(c);
+        if (!is_symbol(c, ';') && !is_symbol(c, ',')) {
+            return compile_error(c, "Expected ';' or ','");
+        }
+        question = c->op == ';';
+        next_token(c);
+    }
+    if (c->type != TOKEN_NAME) {
+        return compile_error(c, "Expected a variable");
+    }
+    if (variable(c, &slot, &kind) < 0) {
+        return -1;
+    }
+    emit_op(c->vm, VM_INPUT);
+    emit_u32(c->vm, slot);
+    emit_u32(c->vm, add_string(c, prompt, length, "? ", question ? 2 : 0));
+    emit_u8(c->vm, kind);
+    next_token(c);
+    return 0;
+}
+
+// Compile DIM name [AS type], which only gives the variable its type
+static int compile_dim(Compiler *c) {
+    Vm *vm = c->vm;
+    const char *text;
+    size_t length;
+    ValueKind suffix, kind;
+    uint32_t id;
+
+    next_token(c);
+    if (c->type != TOKEN_NAME) {
+        return compile_error(c, "Expected a variable");
+    }
+    text = c->text;
+    suffix = c->kind;
+    length = c->length - (suffix != KIND_UNKNOWN);
+    kind = suffix != KIND_UNKNOWN ? suffix : KIND_SINGLE;
+    next_token(c);
+    if (is_keyword(c, KEY_AS)) {
+        next_token(c);
+        if (suffix != KIND_UNKNOWN || c->type != TOKEN_KEYWORD || c->keyword < KEY_INTEGER) {
+            return compile_error(c, "Expected a type after AS");
+        }
+        kind = (ValueKind)(KIND_INTEGER + c->keyword - KEY_INTEGER);
+        next_token(c);
+    }
+
+    // QBasic takes no DIM of a variable already used or DIMmed
+    if (find_name(c, text, length, &id) < 0) {
+        return -1;
+    }
+    for (int k = 0; k <= KIND_STRING; ++k) {
+        if (vm->slots[id].slots[k] != UINT32_MAX && (suffix == KIND_UNKNOWN || k == (int)suffix)) {
+            return compile_error(c, "Duplicate definition");
+        }
+    }
+    if (vm->names.symbols[id].kind != KIND_UNKNOWN) {
+        return compile_error(c, "Duplicate definition");
+    }
+    if (suffix == KIND_UNKNOWN) {
+        vm->names.symbols[id].kind = kind;
+    }
+    vm->slots[id].slots[kind] = kind == KIND_STRING ? vm->string_slots++ : vm->number_slots++;
+    return 0;
+}
+
+// Open a block
+static int push_block(Compiler *c, int what, uint32_t start, uint32_t jump) {
+    Vm *vm = c->vm;
+
+    if (grow(vm, &vm->blocks, &vm->blocks_capacity, vm->blocks_count + 1, sizeof(VmBlock)) < 0) {
+        return -1;
+    }
+    vm->blocks[vm->blocks_count++] = (VmBlock){ what, start, jump, c->line };
+    return 0;
+}
+
+// Compile IF: a block IF when THEN ends the line, else a jump to a line
+// number after THEN or THEN GOTO, and after ELSE
+static int compile_if(Compiler *c) {
+    Vm *vm = c->vm;
+    long number;
+
+    next_token(c);
+    if (compile_condition(c) < 0) {
+        return -1;
+    }
+    if (!is_keyword(c, KEY_THEN)) {
+        return compile_error(c, "Expected THEN");
+    }
+    next_token(c);
+    if (c->type == TOKEN_END) {
+        emit_op(vm, VM_JUMP_FALSE);
+        return push_block(c, 'i', 0, emit_u32(vm, 0));
+    }
+    if (is_keyword(c, KEY_GOTO)) {
+        next_token(c);
+    }
+    if ((number = line_number(c)) < 0) {
+        return -1;
+    }
+    emit_goto(c, VM_JUMP_TRUE, (unsigned)number);
+    next_token(c);
+    if (is_keyword(c, KEY_ELSE)) {
+        next_token(c);
+        if ((number = line_number(c)) < 0) {
+            return -1;
+        }
+        emit_goto(c, VM_JUMP, (unsigned)number);
+        next_token(c);
+    } else if (is_symbol(c, ':')) {
+        // The rest of the line only runs when the condition holds
+        emit_op(vm, VM_JUMP);
+        c->skip = emit_u32(vm, 0);
+    }
+    return 0;
+}
+
+// Compile a statement, the token after it is left for the caller
+static int compile_statement(Compiler *c) {
+    Vm *vm = c->vm;
+    VmBlock *block = vm->blocks_count > 0 ? &vm->blocks[vm->blocks_count - 1] : NULL;
+    ValueKind kind, value;
+    uint32_t slot;
+    long number;
+
+    if (c->type == TOKEN_END || is_symbol(c, ':')) {
+        return 0;
+    }
+    if (c->type == TOKEN_KEYWORD) {
+        switch (c->keyword) {
+            case KEY_REM:
+                c->cursor = c->end;
+                next_token(c);
+                return 0;
+            case KEY_PRINT:
+                return compile_print(c);
+            case KEY_INPUT:
+                return compile_input(c);
+            case KEY_DIM:
+                return compile_dim(c);
+            case KEY_IF:
+                return compile_if(c);
+            case KEY_ELSE:
+                if (block == NULL || block->what != 'i') {
+                    return compile_error(c, "ELSE without IF");
+                }
+                emit_op(vm, VM_JUMP);
+                slot = emit_u32(vm, 0);
+                patch(vm, block->jump, (uint32_t)vm->code_length);
+                block->what = 'e';
+                block->jump = slot;
+                next_token(c);
+                return 0;
+            case KEY_END:
+                next_token(c);
+                if (!is_keyword(c, KEY_IF)) {
+                    emit_op(vm, VM_END);
+                    return 0;
+                }
+                if (block == NULL || block->what == 'w') {
+                    return compile_error(c, "END IF without block IF");
+                }
+                patch(vm, block->jump, (uint32_t)vm->code_length);
+                vm->blocks_count--;
+                next_token(c);
+                return 0;
+            case KEY_WHILE:
+                slot = (uint32_t)vm->code_length;
+                next_token(c);
+                if (compile_condition(c) < 0) {
+                    return -1;
+                }
+                emit_op(vm, VM_JUMP_FALSE);
+                return push_block(c, 'w', slot, emit_u32(vm, 0));
+            case KEY_WEND:
+                if (block == NULL || block->what != 'w') {
+                    return compile_error(c, "WEND without WHILE");
+                }
+                emit_op(vm, VM_JUMP);
+                emit_u32(vm, block->start);
+                patch(vm, block->jump, (uint32_t)vm->code_length);
+                vm->blocks_count--;
+                next_token(c);
+                return 0;
+            case KEY_GOTO:
+                next_token(c);
+                if ((number = line_number(c)) < 0) {
+                    return -1;
+                }
+                emit_goto(c, VM_JUMP, (unsigned)number);
+                next_token(c);
+                return 0;
+            case KEY_LET:
+                next_token(c);
+                break;
+            default:
+                return compile_error(c, "Expected a statement");
+        }
+    }
+
+    // Assignment
+    if (c->type != TOKEN_NAME) {
+        return compile_error(c, "Expected a statement");
+    }
+    if (variable(c, &slot, &kind) < 0) {
+        return -1;
+    }
+    next_token(c);
+    if (!is_symbol(c, '=')) {
+        return compile_error(c, "Expected '='");
+    }
+    next_token(c);
+    if (compile_expression(c, &value) < 0 || compile_convert(c, value, kind) < 0) {
+        return -1;
+    }
+    emit_op(vm, kind == KIND_STRING ? VM_STORE_STRING : VM_STORE);
+    emit_u32(vm, slot);
+    return 0;
+}
+
+// Compile a line: an optional line number, then statements joined by ':'
+static int compile_line(Compiler *c) {
+    Vm *vm = c->vm;
+
+    if (grow(vm, &vm->lines, &vm->lines_capacity, vm->lines_count + 1, sizeof(VmLine)) < 0) {
+        return -1;
+    }
+    vm->lines[vm->lines_count++] = (VmLine){ (uint32_t)vm->code_length, c->line };
+    c->skip = 0;
+    next_token(c);
+    if (c->type == TOKEN_NUMBER) {
+        long number = line_number(c);
+        if (number < 0 || grow(vm, &vm->labels, &vm->labels_capacity, vm->labels_count + 1, sizeof(VmLabel)) < 0) {
+            return -1;
+        }
+        vm->labels[vm->labels_count++] = (VmLabel){ (unsigned)number, (uint32_t)vm->code_length, c->line };
+        next_token(c);
+    }
+    for (;;) {
+        if (compile_statement(c) < 0) {
+            return -1;
+        }
+        if (is_symbol(c, ':')) {
+            next_token(c);
+            continue;
+        }
+        if (c->type != TOKEN_END) {
+            return compile_error(c, "Expected the end of the statement");
+        }
+        break;
+    }
+    if (c->skip != 0) {
+        patch(vm, c->skip, (uint32_t)vm->code_length);
+    }
+    return 0;
+}
+
+// Order labels by line number
+static int by_number(const void *a, const void *b) {
+    const VmLabel *x = a, *y = b;
+    return x->number < y->number ? -1 : x->number > y->number;
+}
+
+// Point every GOTO at the code of its line
+static int resolve_jumps(Vm *vm) {
+    if (vm->labels_count > 1) {
+        qsort(vm->labels, vm->labels_count, sizeof(VmLabel), by_number);
+    }
+    for (size_t i = 1; i < vm->labels_count; ++i) {
+        if (vm->labels[i].number == vm->labels[i - 1].number) {
+            sink_printf(vm->diag, "Error in line %u of the BASIC program: Duplicate label.\n", vm->labels[i].line);
+            return -1;
+        }
+    }
+    for (size_t i = 0; i < vm->jumps_count; ++i) {
+        VmLabel key = { vm->jumps[i].number, 0, 0 };
+        VmLabel *label = vm->labels_count > 0
+            ? bsearch(&key, vm->labels, vm->labels_count, sizeof(VmLabel), by_number) : NULL;
+        if (label == NULL) {
+            sink_printf(vm->diag, "Error in line %u of the BASIC program: Label not defined.\n", vm->jumps[i].line);
+            return -1;
+        }
+        patch(vm, vm->jumps[i].offset, label->offset);
+    }
+    return 0;
+}
+
+// Compile a BASIC program into the machine, -1 on an error (reported to
+// the diagnostics)
+int vm_compile(Vm *vm, const char *source, size_t length) {
+    const char *end = source + length, *line = source;
+    Compiler c = { vm };
+    int result = 0;
+
+    while (line < end && result == 0) {
+        const char *newline = memchr(line, '\n', (size_t)(end - line));
+        c.cursor = line;
+        c.end = newline != NULL ? newline : end;
+        if (c.end > line && c.end[-1] == '\r') {
+            c.end--;
+        }
+        c.line++;
+        result = compile_line(&c);
+        line = newline != NULL ? newline + 1 : end;
+    }
+    if (result == 0 && vm->blocks_count > 0) {
+        VmBlock *block = &vm->blocks[vm->blocks_count - 1];
+        c.line = block->line;
+        result = compile_error(&c, block->what == 'w' ? "WHILE without WEND" : "Block IF without END IF");
+    }
+    if (result == 0) {
+        emit_op(vm, VM_END);
+        result = resolve_jumps(vm);
+    }
+    if (vm->error != 0) {
+        sink_literal(vm->diag, "Error: Out of memory.\n");
+        result = -1;
+    }
+    return result;
+}
+
+// Round to a whole number, halves to the even one (as CINT and CLNG do)
+static double round_even(double value) {
+    double whole, fraction;
+
+    if (!(value > -4503599627370496.0 && value < 4503599627370496.0)) {
+        return value;  // whole already, or not a number
+    }
+    whole = (double)(int64_t)value;
+    fraction = value - whole;
+    if (fraction > 0.5 || (fraction == 0.5 && ((int64_t)whole & 1))) {
+        whole += 1;
+    } else if (fraction < -0.5 || (fraction == -0.5 && ((int64_t)whole & 1))) {
+        whole -= 1;
+    }
+    return whole;
+}
+
+// Round a value to a type, -1 when it does not fit
+static int fit(double *value, ValueKind kind) {
+    double x = *value;
+
+    if (kind == KIND_INTEGER || kind == KIND_LONG) {
+        double limit = kind == KIND_INTEGER ? 32767.0 : 2147483647.0;
+        x = round_even(x);
+        if (!(x >= -limit - 1 && x <= limit)) {
+            return -1;
+        }
+    } else if (kind == KIND_SINGLE) {
+        if (!(x >= -FLT_MAX && x <= FLT_MAX)) {
+            return -1;
+        }
+        x = (float)x;
+    }
+    *value = x == 0 ? 0 : x;  // no -0
+    return 0;
+}
+
+// Write a number as PRINT does: a space or '-' before it, a space after,
+// no 0 before the point, up to 7 digits of a SINGLE and 16 of a DOUBLE
+static size_t format_number(char *text, double value, ValueKind kind) {
+    char digits[48], *p = digits;
+    size_t n = 0;
+
+    if (kind == KIND_INTEGER || kind == KIND_LONG) {
+        snprintf(digits, sizeof(digits), "%.0f", value);
+    } else {
+        snprintf(digits, sizeof(digits), kind == KIND_SINGLE ? "%.7G" : "%.16G", value);
+    }
+    text[n++] = *p == '-' ? '-' : ' ';
+    if (*p == '-') {
+        p++;
+    }
+    if (p[0] == '0' && p[1] == '.') {
+        p++;
+    }
+    for (; *p != '\0'; ++p) {
+        text[n++] = kind == KIND_DOUBLE && *p == 'E' ? 'D' : *p;
+    }
+    text[n++] = ' ';
+    return n;
+}
+
+// Write program output, keeping track of the column for PRINT zones
+static void output(Sink *out, const char *data, size_t length, size_t *column) {
+    size_t i = length;
+
+    if (length == 0) {
+        return;
+    }
+    sink_write(out, data, length);
+    while (i > 0 && data[i - 1] != '\n') {
+        i--;
+    }
+    *column = i > 0 ? length - i : *column + length;
+}
+
+// Take a number typed in for INPUT, -1 to ask again
+static int input_number(const char *text, size_t length, ValueKind kind, double *value) {
+    char digits[64];
+    size_t i = 0, n = 0, mantissa = 0;
+
+    while (i < length && text[i] == ' ') {
+        i++;
+    }
+    while (length > i && text[length - 1] == ' ') {
+        length--;
+    }
+    if (i < length && (text[i] == '+' || text[i] == '-')) {
+        digits[n++] = text[i++];
+    }
+    for (; i < length && n + 1 < sizeof(digits); ++i) {
+        char ch = (char)toupper((unsigned char)text[i]);
+        if (isdigit((unsigned char)ch)) {
+            mantissa++;
+        } else if (ch == 'D' || ch == 'E') {
+            if (mantissa == 0) {
+                return -1;
+            }
+            ch = 'E';
+        } else if (ch != '.' && !((ch == '+' || ch == '-') && n > 0 && digits[n - 1] == 'E')) {
+            return -1;
+        }
+        digits[n++] = ch;
+    }
+    if (i < length) {
+        return -1;
+    }
+    digits[n] = '\0';
+    if (n > 0 && strtod(digits, NULL) == 0 && mantissa == 0) {
+        return -1;
+    }
+    *value = n > 0 ? strtod(digits, NULL) : 0;
+    return fit(value, kind);
+}
+
+// Take a string typed in for INPUT, -1 to ask again (a ',' starts
+// another value unless it is quoted)
+static int input_string(Vm *vm, const char *text, size_t length, VmString *string) {
+    size_t i = 0;
+    const char *quote;
+
+    while (i < length && text[i] == ' ') {
+        i++;
+    }
+    while (length > i && text[length - 1] == ' ') {
+        length--;
+    }
+    if (i < length && text[i] == '"' && (quote = memchr(text + i + 1, '"', length - i - 1)) != NULL) {
+        if (quote != text + length - 1) {
+            return -1;
+        }
+        return string_set(vm, string, text + i + 1, (size_t)(quote - text) - i - 1) < 0 ? -2 : 0;
+    }
+    if (memchr(text + i, ',', length - i) != NULL) {
+        return -1;
+    }
+    return string_set(vm, string, text + i, length - i) < 0 ? -2 : 0;
+}
+
+// Compare two strings for a relation
+static int compare_strings(const VmString *a, const VmString *b, unsigned relation) {
+    size_t common = a->length < b->length ? a->length : b->length;
+    int order = common > 0 ? memcmp(a->data, b->data, common) : 0;
+
+    if (order == 0) {
+        order = a->length < b->length ? -1 : a->length > b->length;
+    }
+    switch (relation) {
+        case VM_EQUAL: return order == 0;
+        case VM_NOT_EQUAL: return order != 0;
+        case VM_LESS: return order < 0;
+        case VM_GREATER: return order > 0;
+        case VM_LESS_EQUAL: return order <= 0;
+        default: return order >= 0;
+    }
+}
+
+// Line of the text the code at an offset was compiled from
+static unsigned line_of(const Vm *vm, uint32_t offset) {
+    size_t low = 0, high = vm->lines_count;
+
+    while (high - low > 1) {
+        size_t middle = (low + high) / 2;
+        if (vm->lines[middle].offset <= offset) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    return vm->lines_count > 0 ? vm->lines[low].line : 0;
+}
+
+// Run the compiled program, INPUT taking the lines of input; returns -1
+// on a run time error (reported to the diagnostics)
+int vm_run(Vm *vm, const char *input, size_t length, Sink *out) {
+    const unsigned char *code = vm->code, *pc = code, *start = code;
+    const char *script = input, *script_end = input + length;
+    uint64_t *counts = vm->counts, executed = 0;
+    const char *failure = NULL;
+    char text[64];
+    size_t column = 0;
+    double *sp, *variables;
+    VmString *ss, *strings;
+    int32_t a, b;
+
+    // Variables start at 0 and "", the stacks are as deep as the
+    // compiler found them to get
+    free_strings(vm, vm->string_variables, vm->string_slots);
+    free_strings(vm, vm->string_stack, vm->string_depth);
+    allocator_free(vm->allocator, vm->variables);
+    allocator_free(vm->allocator, vm->stack);
+    vm->variables = allocator_alloc(vm->allocator, sizeof(double) * (vm->number_slots + 1));
+    vm->stack = allocator_alloc(vm->allocator, sizeof(double) * (vm->number_depth + 1));
+    vm->string_variables = allocator_alloc(vm->allocator, sizeof(VmString) * (vm->string_slots + 1));
+    vm->string_stack = allocator_alloc(vm->allocator, sizeof(VmString) * (vm->string_depth + 1));
+    if (vm->variables == NULL || vm->stack == NULL || vm->string_variables == NULL || vm->string_stack == NULL) {
+        sink_literal(vm->diag, "Error: Out of memory.\n");
+        return -1;
+    }
+    memset(vm->variables, 0, sizeof(double) * (vm->number_slots + 1));
+    memset(vm->string_variables, 0, sizeof(VmString) * (vm->string_slots + 1));
+    memset(vm->string_stack, 0, sizeof(VmString) * (vm->string_depth + 1));
+    memset(vm->counts, 0, sizeof(vm->counts));
+    variables = vm->variables;
+    strings = vm->string_variables;
+    sp = vm->stack;
+    ss = vm->string_stack;
+
+#define FETCH() (start = pc, executed++, counts[*pc]++, *pc++)
+#define FAIL(message) do { failure = (message); goto fail; } while (0)
+#define JUMP_TO(target) do { \
+        if (vm->limit != 0 && executed >= vm->limit) FAIL("Stopped after the instruction limit"); \
+        pc = code + (target); \
+    } while (0)
+#define INTEGER_OPERANDS() do { \
+        sp--; \
+        if (fit(&sp[-1], KIND_LONG) < 0 || fit(&sp[0], KIND_LONG) < 0) FAIL("Overflow"); \
+        a = (int32_t)sp[-1]; \
+        b = (int32_t)sp[0]; \
+    } while (0)
+#define COMPARE(relation) do { sp--; sp[-1] = sp[-1] relation sp[0] ? -1 : 0; } while (0)
+
+#ifdef VM_COMPUTED_GOTO
+#define CASE(op) label_##op
+#define NEXT() goto *dispatch[FETCH()]
+    static void *const dispatch[VM_OPS] = {
+        &&label_VM_NUMBER, &&label_VM_STRING, &&label_VM_LOAD, &&label_VM_STORE,
+        &&label_VM_LOAD_STRING, &&label_VM_STORE_STRING, &&label_VM_ADD, &&label_VM_SUBTRACT,
+        &&label_VM_MULTIPLY, &&label_VM_DIVIDE, &&label_VM_INTEGER_DIVIDE, &&label_VM_MODULO,
+        &&label_VM_NEGATE, &&label_VM_CINT, &&label_VM_CLNG, &&label_VM_CSNG,
+        &&label_VM_EQUAL, &&label_VM_NOT_EQUAL, &&label_VM_LESS, &&label_VM_GREATER,
+        &&label_VM_LESS_EQUAL, &&label_VM_GREATER_EQUAL, &&label_VM_COMPARE_STRING, &&label_VM_AND,
+        &&label_VM_OR, &&label_VM_NOT, &&label_VM_CONCAT, &&label_VM_JUMP,
+        &&label_VM_JUMP_FALSE, &&label_VM_JUMP_TRUE, &&label_VM_PRINT_NUMBER, &&label_VM_PRINT_STRING,
+        &&label_VM_PRINT_ZONE, &&label_VM_PRINT_NEWLINE, &&label_VM_INPUT, &&label_VM_END
+    };
+    NEXT();
+    {
+#else
+#define CASE(op) case op
+#define NEXT() goto next
+next:
+    switch (FETCH()) {
+#endif
+    CASE(VM_NUMBER):
+        *sp++ = vm->numbers[read_u32(pc)];
+        pc += 4;
+        NEXT();
+    CASE(VM_STRING):
+        if (string_set(vm, ss, vm->strings[read_u32(pc)].data, vm->strings[read_u32(pc)].length) < 0) {
+            FAIL("Out of memory");
+        }
+        ss++;
+        pc += 4;
+        NEXT();
+    CASE(VM_LOAD):
+        *sp++ = variables[read_u32(pc)];
+        pc += 4;
+        NEXT();
+    CASE(VM_STORE):
+        variables[read_u32(pc)] = *--sp;
+        pc += 4;
+        NEXT();
+    CASE(VM_LOAD_STRING):
+        if (string_set(vm, ss, strings[read_u32(pc)].data, strings[read_u32(pc)].length) < 0) {
+            FAIL("Out of memory");
+        }
+        ss++;
+        pc += 4;
+        NEXT();
+    CASE(VM_STORE_STRING): {
+        // The stack entry takes the old buffer of the variable
+        VmString swap = strings[read_u32(pc)];
+        strings[read_u32(pc)] = *--ss;
+        *ss = swap;
+        pc += 4;
+        NEXT();
+    }
+    CASE(VM_ADD):
+        sp--;
+        sp[-1] += sp[0];
+        NEXT();
+    CASE(VM_SUBTRACT):
+        sp--;
+        sp[-1] -= sp[0];
+        NEXT();
+    CASE(VM_MULTIPLY):
+        sp--;
+        sp[-1] *= sp[0];
+        NEXT();
+    CASE(VM_DIVIDE):
+        sp--;
+        if (sp[0] == 0) {
+            FAIL("Division by zero");
+        }
+        sp[-1] /= sp[0];
+        NEXT();
+    CASE(VM_INTEGER_DIVIDE):
+        INTEGER_OPERANDS();
+        if (b == 0) {
+            FAIL("Division by zero");
+        }
+        sp[-1] = (double)((int64_t)a / b);
+        NEXT();
+    CASE(VM_MODULO):
+        INTEGER_OPERANDS();
+        if (b == 0) {
+            FAIL("Division by zero");
+        }
+        sp[-1] = (double)((int64_t)a % b);
+        NEXT();
+    CASE(VM_NEGATE):
+        sp[-1] = -sp[-1];
+        NEXT();
+    CASE(VM_CINT):
+        if (fit(&sp[-1], KIND_INTEGER) < 0) {
+            FAIL("Overflow");
+        }
+        NEXT();
+    CASE(VM_CLNG):
+        if (fit(&sp[-1], KIND_LONG) < 0) {
+            FAIL("Overflow");
+        }
+        NEXT();
+    CASE(VM_CSNG):
+        if (fit(&sp[-1], KIND_SINGLE) < 0) {
+            FAIL("Overflow");
+        }
+        NEXT();
+    CASE(VM_EQUAL):
+        COMPARE(==);
+        NEXT();
+    CASE(VM_NOT_EQUAL):
+        COMPARE(!=);
+        NEXT();
+    CASE(VM_LESS):
+        COMPARE(<);
+        NEXT();
+    CASE(VM_GREATER):
+        COMPARE(>);
+        NEXT();
+    CASE(VM_LESS_EQUAL):
+        COMPARE(<=);
+        NEXT();
+    CASE(VM_GREATER_EQUAL):
+        COMPARE(>=);
+        NEXT();
+    CASE(VM_COMPARE_STRING):
+        ss -= 2;
+        *sp++ = compare_strings(&ss[0], &ss[1], *pc++) ? -1 : 0;
+        NEXT();
+    CASE(VM_AND):
+        INTEGER_OPERANDS();
+        sp[-1] = (double)(a & b);
+        NEXT();
+    CASE(VM_OR):
+        INTEGER_OPERANDS();
+        sp[-1] = (double)(a | b);
+        NEXT();
+    CASE(VM_NOT):
+        if (fit(&sp[-1], KIND_LONG) < 0) {
+            FAIL("Overflow");
+        }
+        sp[-1] = (double)~(int32_t)sp[-1];
+        NEXT();
+    CASE(VM_CONCAT):
+        ss--;
+        if (ss[-1].length + ss[0].length > VM_STRING_MAX) {
+            FAIL("String too long");
+        }
+        if (string_append(vm, &ss[-1], ss[0].data, ss[0].length) < 0) {
+            FAIL("Out of memory");
+        }
+        NEXT();
+    CASE(VM_JUMP):
+        JUMP_TO(read_u32(pc));
+        NEXT();
+    CASE(VM_JUMP_FALSE):
+        if (*--sp == 0) {
+            JUMP_TO(read_u32(pc));
+        } else {
+            pc += 4;
+        }
+        NEXT();
+    CASE(VM_JUMP_TRUE):
+        if (*--sp != 0) {
+            JUMP_TO(read_u32(pc));
+        } else {
+            pc += 4;
+        }
+        NEXT();
+    CASE(VM_PRINT_NUMBER):
+        output(out, text, format_number(text, *--sp, (ValueKind)*pc++), &column);
+        NEXT();
+    CASE(VM_PRINT_STRING):
+        ss--;
+        output(out, ss->data, ss->length, &column);
+        NEXT();
+    CASE(VM_PRINT_ZONE):
+        output(out, "              ", VM_ZONE - column % VM_ZONE, &column);
+        NEXT();
+    CASE(VM_PRINT_NEWLINE):
+        output(out, "\n", 1, &column);
+        if (out->length > out->batch && sink_flush(out) < 0) {
+            FAIL("Cannot write output");
+        }
+        NEXT();
+    CASE(VM_INPUT): {
+        // Ask until a line of the script makes sense, echoing each one
+        uint32_t slot = read_u32(pc);
+        const VmString *prompt = &vm->strings[read_u32(pc + 4)];
+        ValueKind kind = (ValueKind)pc[8];
+        int taken;
+
+        do {
+            const char *line = script, *newline;
+            size_t size;
+
+            output(out, prompt->data, prompt->length, &column);
+            if (script >= script_end) {
+                FAIL("Input past the end of the input");
+            }
+            newline = memchr(script, '\n', (size_t)(script_end - script));
+            script = newline != NULL ? newline + 1 : script_end;
+            size = (size_t)((newline != NULL ? newline : script_end) - line);
+            if (size > 0 && line[size - 1] == '\r') {
+                size--;
+            }
+            output(out, line, size, &column);
+            output(out, "\n", 1, &column);
+            if (kind == KIND_STRING) {
+                taken = input_string(vm, line, size, &strings[slot]);
+            } else {
+                taken = input_number(line, size, kind, &variables[slot]);
+            }
+            if (taken == -2) {
+                FAIL("Out of memory");
+            } else if (taken < 0) {
+                output(out, "Redo from start\n", 16, &column);
+            }
+        } while (taken < 0);
+        if (sink_flush(out) < 0) {
+            FAIL("Cannot write output");
+        }
+        pc += 9;
+        NEXT();
+    }
+    CASE(VM_END):
+        goto done;
+    }
+
+fail:
+    sink_printf(vm->diag, "Error in line %u of the BASIC program: %s.\n",
+        line_of(vm, (uint32_t)(start - code)), failure);
+done:
+    vm->executed = executed;
+    if (sink_flush(out) < 0 && failure == NULL) {
+        sink_literal(vm->diag, "Error: Cannot write output.\n");
+        return -1;
+    }
+    return failure != NULL ? -1 : 0;
+
+#undef FETCH
+#undef FAIL
+#undef JUMP_TO
+#undef INTEGER_OPERANDS
+#undef COMPARE
+#undef CASE
+#undef NEXT
+}
+
+// Write the instructions the last run took, in total and by instruction
+void vm_write_counts(const Vm *vm, Sink *out) {
+    sink_printf(out, "Instructions: %llu\n", (unsigned long long)vm->executed);
+    for (int op = 0; op < VM_OPS; ++op) {
+        if (vm->counts[op] > 0) {
+            sink_printf(out, "  %-16s %llu\n", op_names[op], (unsigned long long)vm->counts[op]);
+        }
+    }
+}
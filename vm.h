@@ -0,0 +1,145 @@
+/*
+ * vm.h - Bytecode compiler and virtual machine for the BASIC js2bas writes.
+ *
+ * Author: Philip R. Simonson
+ * Date: 10/17/2026
+ *
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Instructions (the operands that follow them in the code are listed)
+typedef enum {
+    VM_NUMBER,          // constant u32: push a number constant
+    VM_STRING,          // constant u32: push a string constant
+    VM_LOAD,            // slot u32: push a numeric variable
+    VM_STORE,           // slot u32: pop into a numeric variable
+    VM_LOAD_STRING,     // slot u32
+    VM_STORE_STRING,    // slot u32
+    VM_ADD,
+    VM_SUBTRACT,
+    VM_MULTIPLY,
+    VM_DIVIDE,
+    VM_INTEGER_DIVIDE,  // '\'
+    VM_MODULO,
+    VM_NEGATE,
+    VM_CINT,            // round to INTEGER, Overflow outside its range
+    VM_CLNG,            // round to LONG
+    VM_CSNG,            // round to SINGLE
+    VM_EQUAL,           // comparisons push -1 for true, 0 for false
+    VM_NOT_EQUAL,
+    VM_LESS,
+    VM_GREATER,
+    VM_LESS_EQUAL,
+    VM_GREATER_EQUAL,
+    VM_COMPARE_STRING,  // relation u8 (one of the comparisons above)
+    VM_AND,
+    VM_OR,
+    VM_NOT,
+    VM_CONCAT,
+    VM_JUMP,            // offset u32
+    VM_JUMP_FALSE,      // offset u32: pop, jump when 0
+    VM_JUMP_TRUE,       // offset u32: pop, jump unless 0
+    VM_PRINT_NUMBER,    // kind u8
+    VM_PRINT_STRING,
+    VM_PRINT_ZONE,      // ',' between PRINT items: on to the next zone
+    VM_PRINT_NEWLINE,
+    VM_INPUT,           // slot u32, prompt u32, kind u8
+    VM_END,
+    VM_OPS
+} VmOp;
+
+// Width of a PRINT zone
+#define VM_ZONE 14
+
+// Longest string, as in QBasic
+#define VM_STRING_MAX 32767
+
+// String Structure (constants, variables and the stack entries each own
+// their buffer, which is reused as the value changes)
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+} VmString;
+
+// Line Structure (where the code of a line of the program starts)
+typedef struct {
+    uint32_t offset;
+    unsigned line;      // in the text, from 1
+} VmLine;
+
+// Label Structure (code offset of a line number, or a jump to one)
+typedef struct {
+    unsigned number;
+    uint32_t offset;
+    unsigned line;      // of the jump, for the error
+} VmLabel;
+
+// Block Structure (an IF or WHILE whose end is not compiled yet)
+typedef struct {
+    int what;           // 'i' IF, 'e' its ELSE, 'w' WHILE
+    uint32_t start;     // of the WHILE test
+    uint32_t jump;      // operand to patch with the end (the next part of an IF)
+    unsigned line;
+} VmBlock;
+
+// Name Structure (variable slots by type, found at compile time)
+typedef struct {
+    uint32_t slots[6];  // by ValueKind, UINT32_MAX for none yet
+} VmName;
+
+// Virtual Machine Structure (a compiled program and the state of its run)
+typedef struct {
+    const struct Js2basAllocator *allocator;
+    struct Sink *diag;              // errors
+    int error;                      // ENOMEM once an allocation failed
+    unsigned char *code;
+    size_t code_length;
+    size_t code_capacity;
+    double *numbers;                // constants
+    size_t numbers_count;
+    size_t numbers_capacity;
+    VmString *strings;
+    size_t strings_count;
+    size_t strings_capacity;
+    VmLine *lines;                  // for the line of a run time error
+    size_t lines_count;
+    size_t lines_capacity;
+    VmLabel *labels;                // line numbers, by offset
+    size_t labels_count;
+    size_t labels_capacity;
+    VmLabel *jumps;                 // GOTOs to patch once all labels are known
+    size_t jumps_count;
+    size_t jumps_capacity;
+    VmBlock *blocks;                // open blocks, innermost last
+    size_t blocks_count;
+    size_t blocks_capacity;
+    SymbolTable names;              // variable names in capitals
+    VmName *slots;                  // by symbol id
+    size_t slots_capacity;
+    char *name;                     // scratch for a name in capitals
+    size_t name_capacity;
+    char *operators;                // scratch stacks of an expression: pending
+    size_t operators_capacity;      // operators, 0 for '(', and the types
+    unsigned char *types;           // of its operands
+    size_t types_capacity;
+    uint32_t number_slots;
+    uint32_t string_slots;
+    size_t number_depth;            // deepest the stacks get, known
+    size_t string_depth;            // before the program runs
+    double *variables;              // of the run, and its stacks
+    VmString *string_variables;
+    double *stack;
+    VmString *string_stack;
+    uint64_t limit;                 // instructions to stop after, 0 for no limit
+    uint64_t executed;              // by the last run
+    uint64_t counts[VM_OPS];        // by instruction
+} Vm;
+
+void vm_init(Vm *vm, const struct Js2basAllocator *allocator, struct Sink *diag);
+int vm_compile(Vm *vm, const char *source, size_t length);
+int vm_run(Vm *vm, const char *input, size_t length, struct Sink *out);
+void vm_write_counts(const Vm *vm, struct Sink *out);
+void vm_free(Vm *vm);
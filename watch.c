@@ -0,0 +1,303 @@
+/*
+ * watch.c - Watch an input file and keep its BASIC translation up to date.
+ *
+ * Author: Philip R. Simonson
+ * Date: 10/17/2026
+ *
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+#include "js2bas.h"
+#include "arena.h"
+#include "input.h"
+#include "sink.h"
+#include "translate.h"
+#include "watch.h"
+
+// Find the slot of a statement by hash and source length (empty slot when
+// not cached), so two statements have to collide in both to share code
+static WatchEntry *watch_slot(WatchEntry *table, size_t size, uint64_t hash, size_t source) {
+    size_t index = (size_t)hash & (size - 1);
+
+    while (table[index].text != NULL
+            && (table[index].hash != hash || table[index].source != source)) {
+        index = (index + 1) & (size - 1);
+    }
+    return &table[index];
+}
+
+// Rebuild the table with only the statements of the last good rebuild,
+// large enough for another 'extra' entries
+static int watch_rehash(Watch *watch, size_t extra, int evict) {
+    size_t size = 64;
+    WatchEntry *table;
+
+    while (size < (watch->count + extra) * 2) {
+        size *= 2;
+    }
+    if ((table = calloc(size, sizeof(WatchEntry))) == NULL) {
+        return -1;
+    }
+    for (size_t i = 0; i < watch->size; ++i) {
+        WatchEntry *entry = &watch->table[i];
+        if (entry->text == NULL) {
+            continue;
+        }
+        if (evict && entry->stamp != watch->stamp) {
+            free(entry->text);
+            watch->count--;
+            continue;
+        }
+        *watch_slot(table, size, entry->hash, entry->source) = *entry;
+    }
+    free(watch->table);
+    watch->table = table;
+    watch->size = size;
+    return 0;
+}
+
+// Write all of data at offset
+static int write_at(int fd, const char *data, size_t length, size_t offset) {
+    while (length > 0) {
+        ssize_t written = pwrite(fd, data, length, (off_t)offset);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += written;
+        length -= (size_t)written;
+        offset += (size_t)written;
+    }
+    return 0;
+}
+
+// Bring the output file from the old output to the new one, writing only
+// the bytes that differ (the tail after the first change when it moved)
+static int watch_patch(Watch *watch, const char *output, size_t length, size_t *patched) {
+    size_t start = 0, end = length;
+
+    if (watch->written) {
+        size_t common = watch->length < length ? watch->length : length;
+        while (start < common && watch->output[start] == output[start]) {
+            start++;
+        }
+        if (watch->length == length) {
+            while (end > start && watch->output[end - 1] == output[end - 1]) {
+                end--;
+            }
+        }
+    }
+
+    *patched = end - start;
+    if (write_at(watch->fd, output + start, end - start, start) < 0) {
+        return -1;
+    }
+    if ((!watch->written || watch->length != length) && ftruncate(watch->fd, (off_t)length) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// Milliseconds since some fixed point
+static double watch_clock(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e3 + now.tv_nsec / 1e6;
+}
+
+// Initialize the watch and open the output file
+int watch_init(Watch *watch, const char *filename, const char *outname, Sink *diag) {
+    memset(watch, 0, sizeof(Watch));
+    watch->filename = filename;
+    watch->outname = outname;
+    watch->diag = diag;
+    if ((watch->fd = open(outname, O_RDWR | O_CREAT, 0644)) < 0) {
+        sink_printf(diag, "Error: Cannot create file '%s': %s.\n", outname, strerror(errno));
+        return -1;
+    }
+    if (watch_rehash(watch, 0, 0) < 0) {
+        sink_literal(diag, "Error: Out of memory.\n");
+        close(watch->fd);
+        watch->fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+// Translate the input again, parsing and generating only statements whose
+// tokens were not seen in the last rebuild, then patch the output file
+static int watch_translate(Watch *watch) {
+    StatementRange *ranges = NULL;
+    size_t count, fresh = 0, patched = 0, length = 0;
+    double start = watch_clock();
+    char *output = NULL;
+    Sink piece, next;
+    Input in;
+    int result = 0;
+
+    if (input_open(&in, watch->filename, watch->diag) < 0) {
+        return 1;
+    }
+    if (input_read_all(&in) < 0) {
+        input_close(&in);
+        return 1;
+    }
+    count = split_statements(in.buffer, in.length, &ranges);
+    if (count == 0 && ranges == NULL && in.length > 0) {
+        sink_literal(watch->diag, "Error: Out of memory.\n");
+        input_close(&in);
+        return 1;
+    }
+    if (watch->count + count > watch->size / 2 && watch_rehash(watch, count, 0) < 0) {
+        sink_literal(watch->diag, "Error: Out of memory.\n");
+        free(ranges);
+        input_close(&in);
+        return 1;
+    }
+
+    watch->stamp++;
+    sink_init_memory(&piece);   // no allocator, the texts taken are freed with free()
+    sink_init_memory(&next);
+    for (size_t i = 0; i < count && result == 0; ++i) {
+        WatchEntry *entry = watch_slot(watch->table, watch->size, ranges[i].hash, ranges[i].length);
+
+        if (entry->text == NULL) {
+            if (translate_range(in.buffer, &ranges[i], &piece, watch->diag) != 0) {
+                sink_literal(watch->diag, "Error in parsing the source code.\n");
+                result = 1;
+                break;
+            }
+            if ((entry->text = sink_contents(&piece, &entry->length)) == NULL) {
+                sink_literal(watch->diag, "Error: Out of memory.\n");
+                result = 1;
+                break;
+            }
+            entry->hash = ranges[i].hash;
+            entry->source = ranges[i].length;
+            watch->count++;
+            sink_reset(&piece);
+            fresh++;
+        }
+        entry->stamp = watch->stamp;
+        sink_write(&next, entry->text, entry->length);
+    }
+    free(ranges);
+    input_close(&in);
+
+    // Keep the last good output on disk while the input does not parse
+    if (result == 0) {
+        if ((output = sink_contents(&next, &length)) == NULL) {
+            sink_literal(watch->diag, "Error: Out of memory.\n");
+            result = 1;
+        } else if (watch_patch(watch, output, length, &patched) < 0) {
+            sink_printf(watch->diag, "Error: Cannot write file '%s': %s.\n", watch->outname, strerror(errno));
+            free(output);
+            watch->written = 0;
+            result = 1;
+        } else {
+            free(watch->output);
+            watch->output = output;
+            watch->length = length;
+            watch->written = 1;
+            watch_rehash(watch, 0, 1);
+            sink_printf(watch->diag, "Translated '%s': %zu of %zu statements, %zu bytes written (%.2f ms).\n",
+                watch->filename, fresh, count, patched, watch_clock() - start);
+        }
+    }
+
+    sink_free(&piece);
+    sink_free(&next);
+    return result;
+}
+
+// Rebuild the output and report, returns 0 on success
+int watch_update(Watch *watch) {
+    int result = watch_translate(watch);
+
+    sink_flush(watch->diag);
+    return result;
+}
+
+// Translate once, then again every time the input is written. The
+// directory is watched so that editors replacing the file are noticed.
+int watch_run(Watch *watch) {
+#ifdef __linux__
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    const char *slash = strrchr(watch->filename, '/');
+    const char *name = slash ? slash + 1 : watch->filename;
+    char *directory;
+    int fd;
+
+    if ((fd = inotify_init1(IN_CLOEXEC)) < 0) {
+        sink_printf(watch->diag, "Error: Cannot watch '%s': %s.\n", watch->filename, strerror(errno));
+        sink_flush(watch->diag);
+        return 1;
+    }
+    directory = slash ? strndup(watch->filename, (size_t)(slash - watch->filename) + 1) : strdup(".");
+    if (directory == NULL || inotify_add_watch(fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        sink_printf(watch->diag, "Error: Cannot watch '%s': %s.\n", watch->filename, strerror(errno));
+        sink_flush(watch->diag);
+        free(directory);
+        close(fd);
+        return 1;
+    }
+    free(directory);
+
+    watch_update(watch);
+    for (;;) {
+        ssize_t length = read(fd, buffer, sizeof(buffer));
+        int changed = 0;
+
+        if (length < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            sink_printf(watch->diag, "Error: Cannot watch '%s': %s.\n", watch->filename, strerror(errno));
+            sink_flush(watch->diag);
+            break;
+        }
+        for (char *p = buffer; p < buffer + length; ) {
+            struct inotify_event *event = (struct inotify_event *)p;
+            if (event->len > 0 && strcmp(event->name, name) == 0) {
+                changed = 1;
+            }
+            p += sizeof(struct inotify_event) + event->len;
+        }
+        if (changed) {
+            watch_update(watch);
+        }
+    }
+    close(fd);
+    return 1;
+#else
+    sink_literal(watch->diag, "Error: Watch mode needs inotify (Linux).\n");
+    sink_flush(watch->diag);
+    return 1;
+#endif
+}
+
+// Free the watch and close the output file
+void watch_free(Watch *watch) {
+    for (size_t i = 0; i < watch->size; ++i) {
+        free(watch->table[i].text);
+    }
+    free(watch->table);
+    free(watch->output);
+    if (watch->fd >= 0) {
+        close(watch->fd);
+    }
+}
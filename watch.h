@@ -0,0 +1,40 @@
+/*
+ * watch.h - Watch an input file and keep its BASIC translation up to date.
+ *
+ * Author: Philip R. Simonson
+ * Date: 10/17/2026
+ *
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Watch Entry Structure (generated code of one statement, keyed by its
+// hash and source length)
+typedef struct {
+    uint64_t hash;
+    size_t source;      // bytes of the statement's source
+    char *text;         // NULL for an empty slot
+    size_t length;
+    unsigned stamp;     // last rebuild that used this statement
+} WatchEntry;
+
+// Watch Structure
+typedef struct {
+    const char *filename;
+    const char *outname;
+    int fd;             // output file, patched in place
+    struct Sink *diag;
+    WatchEntry *table;  // open addressing, size is a power of two
+    size_t size;
+    size_t count;
+    char *output;       // what the output file holds now
+    size_t length;
+    int written;        // output is known to be on disk
+    unsigned stamp;
+} Watch;
+
+int watch_init(Watch *watch, const char *filename, const char *outname, struct Sink *diag);
+int watch_update(Watch *watch);
+int watch_run(Watch *watch);
+void watch_free(Watch *watch);